@@ -0,0 +1,468 @@
+/*
+ * batch.h
+ *
+ *  Created on: Oct 18, 2026
+ *
+ *  Batch mode: simulates a whole list of programs, each on its own machine,
+ *  spread over a pool of worker threads, and writes one result file.
+ *
+ *  The jobs are dealt out to the workers in contiguous ranges, one work
+ *  queue per worker. A worker takes jobs from the front of its own queue;
+ *  once that runs dry it steals the back half of the next queue that still
+ *  has work, so a few long programs cannot leave cores idle. Jobs
+ *  never get added after the start, so a worker that finds every queue
+ *  empty is done.
+ *
+ *  Each worker formats its reports into memory; the result file is written
+ *  in input order once every worker has finished. For each program it has
+ *  one block:
+ *    program <file>
+ *    clocks <n>                      (pipeline runs)
+ *    usage <IF> <ID> <EX> <MEM> <WB> (percent of clocks)
+ *    cpi <base> <depth> <fetch> <branch> <hazard> <execute> <memory>
+ *                                    (cycles per retired instruction by
+ *                                    part of the CPI stack)
+ *    ooo <ROB occupancy average> <max> (with -o)
+ *    slots <stage> <slot 0> ... (percent of clocks, one line per stage,
+ *                                    with -w)
+ *    cache <level> <reads> <writes> <hits> <misses> <evictions> <writebacks>
+ *                                    (one line per level, with -c)
+ *    retired <n>                     (functional runs)
+ *    regs <$0> ... <$31>
+ *    pc <n>
+ *    mem <address> <value>           (one line per non-zero word)
+ *    end
+ *  or, for a program that could not be assembled or loaded:
+ *    program <file>
+ *    error <message>
+ *    end
+ *
+ *  Directories given as input are searched, not recursively, for .asm and
+ *  .obj files, taken in name order. Every program is assembled or loaded
+ *  before the workers start. The assembler stops the process on an error,
+ *  so each goes through it in a child process first and only the ones it
+ *  accepts are assembled again here; the rest get their error block and
+ *  the batch goes on. A program that fails while it runs, by branching out
+ *  of itself say, still stops the whole batch, like it stops a single run.
+ *
+ *  REFERENCES: see projmain.c header comment.
+ */
+
+#ifndef BATCH_H_
+#define BATCH_H_
+
+#include "pipeline.h"
+#include "functional.h"
+#include "superscalar.h"
+#include "ooo.h"
+
+/******************************************************************************
+ * Constants/Definitions
+ */
+#define MAX_WORKERS 256
+
+/******************************************************************************
+ * Global Vars and Structs
+ */
+
+//one program to simulate
+typedef struct batch_job_tag {
+	char *file;
+	program prog; //assembled before the workers start
+	char *error; //why 'file' did not assemble or load, NULL if it did
+	char *report; //filled in by the worker that ran it
+	size_t reportLength;
+} batch_job;
+
+//jobs [head, tail) still to run, the owner takes from 'head'
+typedef struct work_queue_tag {
+	pthread_mutex_t lock;
+	int32_t head;
+	int32_t tail;
+} work_queue;
+
+//what every worker shares; everything but the queues is read only
+typedef struct batch_tag {
+	batch_job *jobs;
+	int32_t jobCount;
+	int32_t jobCapacity;
+	work_queue queues[MAX_WORKERS];
+	int workers;
+	//run options, the same for every program
+	bool functional;
+	bool translate; //functional runs through the JIT, see jit.h
+	bool forwarding;
+	bool eventDriven;
+	const predictor *branchPredictor;
+	const cache_config *cacheConfig; //NULL runs without caches
+	int issueWidth; //superscalar mode when not 0
+	const ooo_config *oooConfig; //NULL runs in order
+} batch;
+
+typedef struct worker_tag {
+	batch *b;
+	int id;
+	pthread_t thread;
+} worker;
+
+/******************************************************************************
+ * Function Prototypes
+ */
+int32_t takeJob(batch*, int);
+void* runWorker(void*);
+void runJob(batch*, batch_job*);
+void prepareJob(batch_job*);
+void loadJobProgram(program*, char*);
+void writeReport(FILE*, char*, machine*, bool);
+void addBatchInput(batch*, char*);
+void addBatchJob(batch*, char*);
+int compareJobs(const void*, const void*);
+void runBatch(batch*, char*);
+
+/******************************************************************************
+ * Functions
+ */
+
+/**
+ * Next job for worker 'id': from its own queue, otherwise stolen from
+ * another worker. Returns -1 when no work is left anywhere.
+ */
+int32_t takeJob(batch *b, int id) {
+	work_queue *own = &b->queues[id];
+	int32_t job = -1;
+	int i;
+
+	pthread_mutex_lock(&own->lock);
+	if (own->head < own->tail)
+		job = own->head++;
+	pthread_mutex_unlock(&own->lock);
+	if (job >= 0)
+		return job;
+
+	for (i = 1; i < b->workers && job < 0; i++) {
+		work_queue *victim = &b->queues[(id + i) % b->workers];
+		int32_t head, tail;
+
+		pthread_mutex_lock(&victim->lock);
+		head = victim->head;
+		tail = victim->tail;
+		if (head < tail) //take the back half, or the only job left
+			victim->tail = head + (tail - head) / 2;
+		pthread_mutex_unlock(&victim->lock);
+		if (head >= tail)
+			continue;
+
+		job = head + (tail - head) / 2;
+		pthread_mutex_lock(&own->lock);
+		own->head = job + 1;
+		own->tail = tail;
+		pthread_mutex_unlock(&own->lock);
+	}
+	return job;
+}
+
+/**
+ * Thread body: run jobs until there are none left.
+ */
+void* runWorker(void *arg) {
+	worker *w = arg;
+	int32_t job;
+	while ((job = takeJob(w->b, w->id)) >= 0)
+		runJob(w->b, &w->b->jobs[job]);
+	return NULL;
+}
+
+/**
+ * Simulate the program of one job on a fresh machine, keeping the report
+ * in memory.
+ */
+void runJob(batch *b, batch_job *job) {
+	machine *m = malloc(sizeof(machine));
+	FILE *report = open_memstream(&job->report, &job->reportLength);
+	if (m == NULL || report == NULL) {
+		printf("\n>>>ERROR!\n******Out of host memory for * %s *,"
+				"\n\tFrom: batch.h @ line %d\n", job->file, __LINE__);
+		exit(1);
+	}
+	if (job->error != NULL) {
+		fprintf(report, "program %s\nerror %s\nend\n", job->file, job->error);
+		fclose(report);
+		free(m);
+		return;
+	}
+
+	initMachine(m, &job->prog);
+	m->forwarding = b->forwarding;
+	m->eventDriven = b->eventDriven;
+	m->branchPredictor = b->branchPredictor;
+	m->issueWidth = b->issueWidth;
+	m->jitThreshold = b->translate ? JIT_THRESHOLD : 0;
+	if (b->cacheConfig != NULL)
+		enableCaches(m, b->cacheConfig);
+	if (b->oooConfig != NULL)
+		enableOutOfOrder(m, b->oooConfig);
+	if (b->functional)
+		runFunctional(m);
+	else if (m->core != NULL)
+		runOutOfOrder(m);
+	else if (m->issueWidth > 0)
+		runSuperscalar(m);
+	else
+		runPipeline(m);
+
+	writeReport(report, job->file, m, b->functional);
+	fclose(report);
+	freeMachine(m);
+	free(m);
+}
+
+/**
+ * Assemble or load the program of 'job', or set 'job->error' when that
+ * fails. The assembler and loader stop the process on an error, so they
+ * run in a child process first, its output kept for the message.
+ */
+void prepareJob(batch_job *job) {
+	char *output = NULL, *line, *message = NULL;
+	size_t outputLength = 0;
+	int fds[2], status;
+	pid_t child;
+
+	fflush(stdout); //or the child writes it out again
+	if (pipe(fds) < 0 || (child = fork()) < 0) {
+		printf("\n>>>ERROR!\n******Could not start the assembler for * %s *,"
+				"\n\tFrom: batch.h @ line %d\n", job->file, __LINE__);
+		exit(1);
+	}
+	if (child == 0) {
+		close(fds[0]);
+		dup2(fds[1], STDOUT_FILENO);
+		loadJobProgram(&job->prog, job->file);
+		fflush(stdout);
+		_exit(0);
+	}
+	close(fds[1]);
+	FILE *in = fdopen(fds[0], "r");
+	FILE *text = open_memstream(&output, &outputLength);
+	if (in == NULL || text == NULL) {
+		printf("\n>>>ERROR!\n******Out of host memory for * %s *,"
+				"\n\tFrom: batch.h @ line %d\n", job->file, __LINE__);
+		exit(1);
+	}
+	while ((status = fgetc(in)) != EOF)
+		fputc(status, text);
+	fclose(in);
+	fclose(text);
+	waitpid(child, &status, 0);
+
+	if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+		loadJobProgram(&job->prog, job->file);
+		free(output);
+		return;
+	}
+	//the line of the error report saying what went wrong, else the last
+	for (line = strtok(output, "\n"); line != NULL; line = strtok(NULL, "\n"))
+		if (message == NULL || strncmp(message, "******", 6) != 0)
+			message = line;
+	if (message == NULL)
+		message = "stopped";
+	message += strspn(message, "*");
+	job->error = strndup(message, strcspn(message, ","));
+	free(output);
+}
+
+/**
+ * Assemble 'file' into 'prog', or load it if it is an object file.
+ */
+void loadJobProgram(program *prog, char *file) {
+	if (isObjectFile(file))
+		loadObjectFile(prog, file);
+	else
+		parseASMFile(prog, file, NULL);
+}
+
+/**
+ * Write the result block for one finished machine, see the header comment.
+ */
+void writeReport(FILE *out, char *file, machine *m, bool functional) {
+	uint32_t d, t, i;
+
+	fprintf(out, "program %s\n", file);
+	if (functional) {
+		fprintf(out, "retired %lld\n", (long long) m->retiredInstructions);
+	} else {
+		fprintf(out, "clocks %d\n", m->clocks);
+		fprintf(out, "usage %.2f %.2f %.2f %.2f %.2f\n",
+				100.0 * m->usageIF / m->clocks, 100.0 * m->usageID / m->clocks,
+				100.0 * m->usageEX / m->clocks, 100.0 * m->usageMEM / m->clocks,
+				100.0 * m->usageWB / m->clocks);
+		int64_t retired = m->retiredInstructions > 0 ?
+				m->retiredInstructions : 1;
+		fprintf(out, "cpi");
+		for (i = 0; i < CPI_PARTS; i++)
+			fprintf(out, " %.3f", 1.0 * m->cpiStack[i] / retired);
+		fprintf(out, "\n");
+	}
+	if (!functional && m->core != NULL)
+		fprintf(out, "ooo %.2f %d\n", 1.0 * m->core->occupancy / m->clocks,
+				m->core->occupancyMax);
+	else if (!functional && m->issueWidth > 0) {
+		const char *stages[STAGES] = { "IF", "ID", "EX", "MEM", "WB" };
+		int n;
+		for (i = 0; i < STAGES; i++) {
+			fprintf(out, "slots %s", stages[i]);
+			for (n = 0; n < m->issueWidth; n++)
+				fprintf(out, " %.2f", 100.0 * m->slotUsage[i][n] / m->clocks);
+			fprintf(out, "\n");
+		}
+	}
+	if (m->cachesEnabled) {
+		cache *levels[] = { &m->l1i, &m->l1d, &m->l2 };
+		for (i = 0; i < CACHE_LEVELS; i++)
+			fprintf(out, "cache %s %lld %lld %lld %lld %lld %lld\n",
+					levels[i]->config.name, (long long) levels[i]->reads,
+					(long long) levels[i]->writes, (long long) levels[i]->hits,
+					(long long) levels[i]->misses,
+					(long long) levels[i]->evictions,
+					(long long) levels[i]->writebacks);
+	}
+	fprintf(out, "regs");
+	for (i = 0; i < 32; i++)
+		fprintf(out, " %d", m->regs[i]);
+	fprintf(out, "\npc %d\n", m->pc);
+	for (d = 0; d < DIRECTORY_ENTRIES; d++) {
+		if (m->memory.pageDirectory[d] == NULL)
+			continue;
+		for (t = 0; t < TABLE_ENTRIES; t++) {
+			mem_page *page = m->memory.pageDirectory[d]->pages[t];
+			if (page == NULL)
+				continue;
+			uint32_t base = (d << TABLE_BITS | t) << PAGE_BITS;
+			for (i = 0; i < PAGE_WORDS; i++)
+				if (page->words[i] != 0)
+					fprintf(out, "mem 0x%08x %d\n", base + i, page->words[i]);
+		}
+	}
+	fprintf(out, "end\n");
+}
+
+/**
+ * Queue a program, or every .asm and .obj file of a directory.
+ */
+void addBatchInput(batch *b, char *path) {
+	struct stat st;
+	if (stat(path, &st) < 0) {
+		printf("Input file '%s' could not be opened.\n", path);
+		exit(1);
+	}
+	if (!S_ISDIR(st.st_mode)) {
+		addBatchJob(b, strdup(path));
+		return;
+	}
+
+	DIR *dir = opendir(path);
+	struct dirent *entry;
+	int32_t first = b->jobCount;
+	if (dir == NULL) {
+		printf("Input directory '%s' could not be opened.\n", path);
+		exit(1);
+	}
+	while ((entry = readdir(dir)) != NULL) {
+		size_t length = strlen(entry->d_name);
+		if (length < 5 || (strcmp(entry->d_name + length - 4, ".asm") != 0
+				&& strcmp(entry->d_name + length - 4, ".obj") != 0))
+			continue;
+		char *file = malloc(strlen(path) + length + 2);
+		if (file == NULL) {
+			printf("\n>>>ERROR!\n******Out of host memory for the job list,"
+					"\n\tFrom: batch.h @ line %d\n", __LINE__);
+			exit(1);
+		}
+		sprintf(file, "%s/%s", path, entry->d_name);
+		addBatchJob(b, file);
+	}
+	closedir(dir);
+	qsort(b->jobs + first, b->jobCount - first, sizeof(batch_job),
+			compareJobs);
+}
+
+/**
+ * Append one job, growing the job list as needed.
+ */
+void addBatchJob(batch *b, char *file) {
+	b->jobs = growArray(b->jobs, &b->jobCapacity, b->jobCount + 1,
+			sizeof(batch_job));
+	batch_job *job = &b->jobs[b->jobCount++];
+	memset(&job->prog, 0, sizeof(job->prog));
+	job->file = file;
+	job->error = NULL;
+	job->report = NULL;
+	job->reportLength = 0;
+}
+
+int compareJobs(const void *a, const void *b) {
+	return strcmp(((batch_job*) a)->file, ((batch_job*) b)->file);
+}
+
+/**
+ * Run every queued job on 'b->workers' threads and write the reports, in
+ * the order the programs were given, to 'resultFile'.
+ */
+void runBatch(batch *b, char *resultFile) {
+	worker workers[MAX_WORKERS];
+	int32_t i, failed = 0;
+	int w;
+
+	FILE *out = fopen(resultFile, "w");
+	if (out == NULL) {
+		printf("Output file '%s' could not be opened.\n", resultFile);
+		exit(1);
+	}
+	for (i = 0; i < b->jobCount; i++) {
+		prepareJob(&b->jobs[i]);
+		if (b->jobs[i].error != NULL)
+			failed++;
+	}
+	if (b->workers > b->jobCount)
+		b->workers = b->jobCount > 0 ? b->jobCount : 1;
+
+	//deal the jobs out in equal contiguous ranges
+	for (w = 0; w < b->workers; w++) {
+		pthread_mutex_init(&b->queues[w].lock, NULL);
+		b->queues[w].head = (int64_t) b->jobCount * w / b->workers;
+		b->queues[w].tail = (int64_t) b->jobCount * (w + 1) / b->workers;
+	}
+	for (w = 0; w < b->workers; w++) {
+		workers[w].b = b;
+		workers[w].id = w;
+		if (pthread_create(&workers[w].thread, NULL, runWorker, &workers[w])
+				!= 0) {
+			printf("\n>>>ERROR!\n******Could not start worker thread %d,"
+					"\n\tFrom: batch.h @ line %d\n", w, __LINE__);
+			exit(1);
+		}
+	}
+	for (w = 0; w < b->workers; w++) {
+		pthread_join(workers[w].thread, NULL);
+		pthread_mutex_destroy(&b->queues[w].lock);
+	}
+
+	for (i = 0; i < b->jobCount; i++) {
+		fwrite(b->jobs[i].report, 1, b->jobs[i].reportLength, out);
+		free(b->jobs[i].report);
+		free(b->jobs[i].file);
+		free(b->jobs[i].error);
+		freeProgram(&b->jobs[i].prog);
+	}
+	fclose(out);
+	printf("Simulated %d programs on %d threads, results in '%s'.\n",
+			b->jobCount - failed, b->workers, resultFile);
+	if (failed > 0)
+		printf("%d more could not be assembled or loaded, see their error"
+				" lines.\n", failed);
+	free(b->jobs);
+	b->jobs = NULL;
+	b->jobCount = 0;
+	b->jobCapacity = 0;
+}
+
+#endif /* BATCH_H_ */
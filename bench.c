@@ -0,0 +1,357 @@
+/*
+ * bench.c
+ *
+ *  Created on: Oct 18, 2026
+ *
+ *  Throughput harness for the simulator itself. Every benchmark kernel in
+ *  bench/ is assembled once and run through each engine; for each pair it
+ *  reports the host wall time of the fastest of a few runs, the simulated
+ *  clocks, the instructions retired and the simulated MIPS (million
+ *  instructions retired per host second). The registers every engine ends
+ *  with must match the functional run's, so a fast but wrong change does
+ *  not pass either.
+ *
+ *  With a baseline (bench/baseline.txt by default) each line is also
+ *  compared to the stored one: simulated MIPS more than the tolerance
+ *  below it, or different clocks or instructions retired, are flagged and
+ *  make the exit status 1. -u writes the results as the new baseline.
+ *  Wall times only compare on the same host and compiler flags, so the
+ *  stored baseline is a starting point to overwrite on the machine doing
+ *  the measuring.
+ *
+ *  REFERENCES: see projmain.c header comment.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
+
+#include "pipeline.h"
+#include "instruction.h"
+#include "fileparser.h"
+#include "functional.h"
+#include "superscalar.h"
+#include "ooo.h"
+
+/******************************************************************************
+ * Constants/Definitions
+ */
+#define BENCH_RUNS 5 //the fastest of these is reported
+#define BENCH_SECONDS 0.25 //short kernels run again until they took this long
+#define BENCH_TOLERANCE 10 //percent of simulated MIPS lost before flagging
+#define BASELINE_FILE "bench/baseline.txt"
+#define MAX_BASELINE 256
+
+/******************************************************************************
+ * Global Vars and Structs
+ */
+
+/*
+ * One way of running a program, the same settings as the projmain.c options.
+ */
+typedef struct bench_mode_tag {
+	const char *name;
+	bool functional; //-f
+	bool translate; //-J
+	bool eventDriven; //not -t
+	int issueWidth; //-w
+	const char *ooo; //-o
+	const char *caches; //-c
+} bench_mode;
+
+const bench_mode benchModes[] = {
+		{ "functional", true, false, true, 0, NULL, NULL },
+		{ "jit", true, true, true, 0, NULL, NULL },
+		{ "pipeline", false, false, true, 0, NULL, NULL },
+		{ "tick", false, false, false, 0, NULL, NULL },
+		{ "wide2", false, false, true, 2, NULL, NULL },
+		{ "ooo", false, false, true, 0, "on", NULL },
+		{ "caches", false, false, true, 0, NULL, "on" }
+};
+#define BENCH_MODES ((int) (sizeof(benchModes) / sizeof(benchModes[0])))
+
+const char *benchKernels[] = { "bench/matmul.asm", "bench/memcpy.asm",
+		"bench/sort.asm", "bench/list.asm", "bench/fib.asm",
+		"bench/checksum.asm", "bench/call.asm" };
+#define BENCH_KERNELS ((int) (sizeof(benchKernels) / sizeof(benchKernels[0])))
+
+typedef struct bench_result_tag {
+	char kernel[64];
+	char mode[16];
+	int32_t clocks;
+	int64_t retired;
+	double seconds; //host wall time, not stored in the baseline
+	double mips;
+} bench_result;
+
+/******************************************************************************
+ * Function Prototypes
+ */
+bench_result runBenchmark(const program*, const char*, const bench_mode*,
+		int, int32_t*);
+int loadBaseline(const char*, bench_result*);
+const bench_result* findBaseline(const bench_result*, int, const char*,
+		const char*);
+const char* kernelName(const char*);
+
+/******************************************************************************
+ * Run from command line like so:
+ *
+ * > gcc -O2 bench.c -o bench -pthread
+ * > bench [-r runs] [-m mode] [-l tolerance] [-b baseline] [-u]
+ *         [kernel.asm...]
+ *
+ * -m runs only the named mode, -l sets the flagged loss in percent, -u
+ * writes the baseline instead of comparing to it. With no kernels given it
+ * runs the suite in bench/; run it from the top of the tree.
+ */
+int main(int argc, char *argv[]) {
+	int runs = BENCH_RUNS;
+	double tolerance = BENCH_TOLERANCE;
+	const char *baselineFile = BASELINE_FILE;
+	const char *onlyMode = NULL;
+	bool update = false;
+	static bench_result baseline[MAX_BASELINE];
+	int baselineCount = 0;
+	int failures = 0;
+	FILE *out = NULL;
+	int opt, k, b;
+
+	while ((opt = getopt(argc, argv, "r:m:l:b:u")) != -1) {
+		switch (opt) {
+		case 'r':
+			runs = atoi(optarg);
+			break;
+		case 'm':
+			onlyMode = optarg;
+			break;
+		case 'l':
+			tolerance = atof(optarg);
+			break;
+		case 'b':
+			baselineFile = optarg;
+			break;
+		case 'u':
+			update = true;
+			break;
+		default:
+			printf("usage: %s [-r runs] [-m mode] [-l tolerance]"
+					" [-b baseline] [-u] [kernel.asm...]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (runs < 1)
+		runs = 1;
+
+	if (update) {
+		out = fopen(baselineFile, "w");
+		if (out == NULL) {
+			printf("Baseline file '%s' could not be created.\n", baselineFile);
+			return 1;
+		}
+		fprintf(out, "#kernel mode clocks retired mips\n");
+	} else {
+		baselineCount = loadBaseline(baselineFile, baseline);
+	}
+
+	int kernelCount = optind < argc ? argc - optind : BENCH_KERNELS;
+	printf("%-10s %-10s %10s %10s %10s %9s %9s\n", "kernel", "mode",
+			"host ms", "clocks", "retired", "MIPS", "baseline");
+	for (k = 0; k < kernelCount; k++) {
+		char *file = optind < argc ? argv[optind + k] :
+				(char*) benchKernels[k];
+		int32_t reference[32];
+		program prog = { 0 };
+
+		if (isObjectFile(file))
+			loadObjectFile(&prog, file);
+		else
+			parseASMFile(&prog, file, NULL);
+
+		//the functional run always goes first, for the reference registers
+		runBenchmark(&prog, file, &benchModes[0], 1, reference);
+		for (b = 0; b < BENCH_MODES; b++) {
+			if (onlyMode != NULL && strcmp(onlyMode, benchModes[b].name) != 0)
+				continue;
+			bench_result r = runBenchmark(&prog, file, &benchModes[b], runs,
+					reference);
+			const bench_result *base = findBaseline(baseline, baselineCount,
+					r.kernel, r.mode);
+
+			printf("%-10s %-10s %10.3f %10d %10lld %9.2f", r.kernel, r.mode,
+					r.seconds * 1000, r.clocks,
+					(long long) r.retired, r.mips);
+			if (base == NULL) {
+				printf(" %9s\n", "-");
+			} else {
+				printf(" %9.2f", base->mips);
+				if (r.clocks != base->clocks || r.retired != base->retired) {
+					printf("  CHANGED clocks %d retired %lld",
+							base->clocks, (long long) base->retired);
+					failures++;
+				}
+				if (r.mips < base->mips * (1 - tolerance / 100)) {
+					printf("  REGRESSION %.1f%%",
+							100 * (r.mips - base->mips) / base->mips);
+					failures++;
+				}
+				printf("\n");
+			}
+			if (out != NULL)
+				fprintf(out, "%s %s %d %lld %.2f\n", r.kernel, r.mode,
+						r.clocks, (long long) r.retired, r.mips);
+		}
+		freeProgram(&prog);
+	}
+
+	if (out != NULL) {
+		fclose(out);
+		printf("Baseline written to '%s'.\n", baselineFile);
+	} else if (baselineCount == 0) {
+		printf("No baseline in '%s' to compare with.\n", baselineFile);
+	} else if (failures > 0) {
+		printf("%d result(s) off the baseline in '%s'.\n", failures,
+				baselineFile);
+		return 1;
+	}
+	return 0;
+}
+
+/**
+ * Run 'prog' in 'mode' on a fresh machine at least 'runs' times, and until
+ * BENCH_SECONDS have passed, and keep the fastest run. The registers must
+ * come out as in 'reference', which the plain functional mode fills in
+ * instead.
+ */
+bench_result runBenchmark(const program *prog, const char *file,
+		const bench_mode *mode, int runs, int32_t *reference) {
+	bench_result r = { { 0 } };
+	double best = -1, total = 0;
+	cache_config cacheConfig[CACHE_LEVELS];
+	ooo_config oooConfig;
+	struct timespec start, end;
+	machine *m = malloc(sizeof(machine));
+	int run;
+
+	if (m == NULL) {
+		printf("\n>>>ERROR!\n******Out of host memory for * %s *,"
+				"\n\tFrom: bench.c @ line %d\n", file, __LINE__);
+		exit(1);
+	}
+	if (mode->caches != NULL)
+		parseCacheConfig(mode->caches, cacheConfig);
+	if (mode->ooo != NULL)
+		parseOooConfig(mode->ooo, &oooConfig);
+
+	for (run = 0; run < runs || (total < BENCH_SECONDS && runs > 1); run++) {
+		initMachine(m, prog);
+		m->eventDriven = mode->eventDriven;
+		m->issueWidth = mode->issueWidth;
+		m->jitThreshold = mode->translate ? JIT_THRESHOLD : 0;
+		if (mode->caches != NULL)
+			enableCaches(m, cacheConfig);
+		if (mode->ooo != NULL)
+			enableOutOfOrder(m, &oooConfig);
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		if (mode->functional)
+			runFunctional(m);
+		else if (m->core != NULL)
+			runOutOfOrder(m);
+		else if (m->issueWidth > 0)
+			runSuperscalar(m);
+		else
+			runPipeline(m);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+
+		double seconds = (end.tv_sec - start.tv_sec)
+				+ (end.tv_nsec - start.tv_nsec) / 1e9;
+		total += seconds;
+		if (best < 0 || seconds < best)
+			best = seconds;
+		r.clocks = m->clocks;
+		r.retired = m->retiredInstructions;
+
+		if (mode == &benchModes[0]) {
+			memcpy(reference, m->regs, sizeof(m->regs));
+		} else if (memcmp(reference, m->regs, sizeof(m->regs)) != 0) {
+			printf("\n>>>ERROR!\n******Registers differ from the functional"
+					" run: * %s %s *\n\tFrom: bench.c @ line %d\n", file,
+					mode->name, __LINE__);
+			exit(1);
+		}
+		freeMachine(m);
+	}
+	free(m);
+
+	snprintf(r.kernel, sizeof(r.kernel), "%s", kernelName(file));
+	snprintf(r.mode, sizeof(r.mode), "%s", mode->name);
+	r.seconds = best;
+	r.mips = r.retired / (best > 0 ? best : 1e-9) / 1e6;
+	return r;
+}
+
+/**
+ * Read the stored results, one "kernel mode clocks retired mips" line each;
+ * lines starting with '#' are comments. Returns how many were read, 0 when
+ * there is no baseline.
+ */
+int loadBaseline(const char *baselineFile, bench_result *baseline) {
+	char line[256];
+	int count = 0;
+	long long retired;
+	FILE *in = fopen(baselineFile, "r");
+
+	if (in == NULL)
+		return 0;
+	while (count < MAX_BASELINE && fgets(line, sizeof(line), in) != NULL) {
+		bench_result *r = &baseline[count];
+		if (line[0] == '#')
+			continue;
+		if (sscanf(line, "%63s %15s %d %lld %lf", r->kernel, r->mode,
+				&r->clocks, &retired, &r->mips) == 5) {
+			r->retired = retired;
+			count++;
+		}
+	}
+	fclose(in);
+	return count;
+}
+
+/**
+ * The stored result for 'kernel' in 'mode', NULL if there is none.
+ */
+const bench_result* findBaseline(const bench_result *baseline, int count,
+		const char *kernel, const char *mode) {
+	int i;
+	for (i = 0; i < count; i++)
+		if (strcmp(baseline[i].kernel, kernel) == 0
+				&& strcmp(baseline[i].mode, mode) == 0)
+			return &baseline[i];
+	return NULL;
+}
+
+/**
+ * The kernel's name in reports: its file name without directory or
+ * extension.
+ */
+const char* kernelName(const char *file) {
+	static char name[64];
+	const char *slash = strrchr(file, '/');
+	char *dot;
+
+	snprintf(name, sizeof(name), "%s", slash != NULL ? slash + 1 : file);
+	dot = strrchr(name, '.');
+	if (dot != NULL && dot != name)
+		*dot = '\0';
+	return name;
+}
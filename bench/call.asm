@@ -0,0 +1,33 @@
+#Benchmark kernel: calls into subroutines placed after the halt
+#For n from 1 to 200, square(n) is added to $v0 through a call to sumsq,
+#which itself calls square. $v0 ends up with the sum of the squares
+#and $v1 with the number of calls made.
+addi $s0, $zero, 201
+addi $s1, $zero, 1      #n
+add $v0, $zero, $zero
+add $v1, $zero, $zero
+next:
+beq $s1, $s0, done
+add $a0, $s1, $zero
+jal sumsq
+addi $s1, $s1, 1
+j next
+done:
+halt
+sumsq:
+add $s2, $ra, $zero     #no stack: keep the return address in $s2
+jal square
+add $v0, $v0, $a1
+addi $v1, $v1, 1
+jr $s2
+square:
+add $a1, $zero, $zero
+add $t0, $a0, $zero
+sqstep:
+beq $t0, $zero, sqdone
+add $a1, $a1, $a0
+addi $t0, $t0, -1
+bne $t0, $zero, sqstep
+sqdone:
+addi $v1, $v1, 1
+jr $ra
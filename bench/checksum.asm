@@ -0,0 +1,40 @@
+#Benchmark kernel: Fletcher style checksum of a 4096 word buffer, 6 times
+#The buffer at word 8192 is filled from x = x * 69069 + 1. Each pass adds
+#every word to sum1 and every sum1 to sum2, both wrapping at 32 bits;
+#afterwards $v0 holds sum2 and $v1 sum1.
+addi $s1, $zero, 8192   #buffer
+addi $s2, $zero, 12288  #end of buffer
+addi $t0, $zero, 23023
+addi $t1, $zero, 3
+mul $s3, $t0, $t1       #69069
+addi $t0, $zero, 1      #x
+add $t2, $s1, $zero
+fill:
+beq $t2, $s2, filled
+mul $t0, $t0, $s3
+addi $t0, $t0, 1
+sw $t0, 0($t2)
+addi $t2, $t2, 1
+beq $zero, $zero, fill
+filled:
+addi $s0, $zero, 6      #passes left
+add $v0, $zero, $zero
+add $v1, $zero, $zero
+pass:
+beq $s0, $zero, done
+add $t2, $s1, $zero
+word:
+beq $t2, $s2, passdone
+lw $t3, 0($t2)
+lw $t4, 4($t2)
+add $v1, $v1, $t3
+add $v0, $v0, $v1
+add $v1, $v1, $t4
+add $v0, $v0, $v1
+addi $t2, $t2, 2
+beq $zero, $zero, word
+passdone:
+addi $s0, $s0, -1
+beq $zero, $zero, pass
+done:
+halt
@@ -0,0 +1,23 @@
+#Benchmark kernel: iterative Fibonacci, recomputed for every n up to 250
+#$v0 ends up with the sum of fib(1) to fib(250), wrapped to 32 bits.
+addi $s0, $zero, 251
+addi $t0, $zero, 1      #n
+add $v0, $zero, $zero
+next:
+beq $t0, $s0, done
+add $t1, $zero, $zero   #fib(k - 1)
+addi $t2, $zero, 1      #fib(k)
+addi $t3, $zero, 1      #k
+step:
+beq $t3, $t0, stepped
+add $t4, $t1, $t2
+add $t1, $t2, $zero
+add $t2, $t4, $zero
+addi $t3, $t3, 1
+beq $zero, $zero, step
+stepped:
+add $v0, $v0, $t2
+addi $t0, $t0, 1
+beq $zero, $zero, next
+done:
+halt
@@ -0,0 +1,41 @@
+#Benchmark kernel: pointer chasing through a 1024 node linked list
+#Node k sits at word 4096 + 2k as { next, value }. The list visits the
+#nodes in the order (i * 389) mod 1024, so consecutive nodes are far
+#apart, and node i of the walk holds the value i. The list is walked 32
+#times and the values summed into $v0: 32 * 523776 = 16760832.
+addi $s0, $zero, 1024   #nodes
+addi $s1, $zero, 4096   #node 0, the head
+addi $s2, $zero, 1023   #mod 1024 mask
+addi $s3, $zero, 389    #odd stride, so every node is visited once
+add $t0, $zero, $zero   #i
+add $t1, $zero, $zero   #i * stride
+link:
+and $t3, $t1, $s2
+add $t3, $t3, $t3
+add $t3, $t3, $s1       #&node of i
+sw $t0, 4($t3)
+addi $t0, $t0, 1
+beq $t0, $s0, linked    #the last node keeps a null next
+add $t1, $t1, $s3
+and $t4, $t1, $s2
+add $t4, $t4, $t4
+add $t4, $t4, $s1       #&node of i + 1
+sw $t4, 0($t3)
+beq $zero, $zero, link
+linked:
+addi $s4, $zero, 32     #walks left
+add $v0, $zero, $zero
+walk:
+beq $s4, $zero, done
+add $t5, $s1, $zero
+next:
+beq $t5, $zero, walked
+lw $t6, 4($t5)
+add $v0, $v0, $t6
+lw $t5, 0($t5)
+beq $zero, $zero, next
+walked:
+addi $s4, $s4, -1
+beq $zero, $zero, walk
+done:
+halt
@@ -0,0 +1,65 @@
+#Benchmark kernel: 24x24 integer matrix multiply, C = A * B
+#A at word 1000, B at 2000 and C at 3000, row major. A[k] = k + 1 and
+#B[k] = 2k + 2; the sum of every element of C ends up in $v0.
+addi $s0, $zero, 24     #N
+addi $s1, $zero, 1000   #A
+addi $s2, $zero, 2000   #B
+addi $s3, $zero, 3000   #C
+add $t0, $zero, $zero   #k
+mul $t1, $s0, $s0       #N * N
+add $t2, $s1, $zero     #&A[k]
+add $t3, $s2, $zero     #&B[k]
+fill:
+beq $t0, $t1, filled
+addi $t0, $t0, 1
+sw $t0, 0($t2)
+add $t4, $t0, $t0
+sw $t4, 0($t3)
+addi $t2, $t2, 1
+addi $t3, $t3, 1
+beq $zero, $zero, fill
+filled:
+add $t0, $zero, $zero   #i
+add $s4, $s3, $zero     #&C[i][j]
+add $s5, $s1, $zero     #&A[i][0]
+rows:
+beq $t0, $s0, multiplied
+add $t1, $zero, $zero   #j
+cols:
+beq $t1, $s0, nextrow
+add $t5, $zero, $zero   #C[i][j]
+add $t6, $s5, $zero     #&A[i][k]
+add $t7, $s2, $t1       #&B[k][j]
+add $t2, $zero, $zero   #k
+dot:
+beq $t2, $s0, stored
+lw $t8, 0($t6)
+lw $t9, 0($t7)
+mul $t8, $t8, $t9
+add $t5, $t5, $t8
+addi $t6, $t6, 1
+add $t7, $t7, $s0
+addi $t2, $t2, 1
+beq $zero, $zero, dot
+stored:
+sw $t5, 0($s4)
+addi $s4, $s4, 1
+addi $t1, $t1, 1
+beq $zero, $zero, cols
+nextrow:
+add $s5, $s5, $s0
+addi $t0, $t0, 1
+beq $zero, $zero, rows
+multiplied:
+add $v0, $zero, $zero
+add $t2, $s3, $zero
+mul $t1, $s0, $s0
+add $t1, $t1, $s3       #end of C
+sum:
+beq $t2, $t1, done
+lw $t3, 0($t2)
+add $v0, $v0, $t3
+addi $t2, $t2, 1
+beq $zero, $zero, sum
+done:
+halt
@@ -0,0 +1,50 @@
+#Benchmark kernel: memset then memcpy of a 4096 word buffer, 8 times
+#Each pass fills words 8192-12287 with the pass number (8 down to 1) and
+#copies them to 16384-20479, unrolled by four words like a library memcpy.
+#The sum of the copy after the last pass, 4096, ends up in $v0.
+addi $s0, $zero, 8      #passes left
+addi $s1, $zero, 8192   #source
+addi $s2, $zero, 12288  #end of source
+addi $s3, $zero, 16384  #destination
+addi $s4, $zero, 20480  #end of destination
+pass:
+beq $s0, $zero, copied
+add $t0, $s1, $zero
+set:
+beq $t0, $s2, setdone
+sw $s0, 0($t0)
+sw $s0, 4($t0)
+sw $s0, 8($t0)
+sw $s0, 12($t0)
+addi $t0, $t0, 4
+beq $zero, $zero, set
+setdone:
+add $t0, $s1, $zero
+add $t2, $s3, $zero
+copy:
+beq $t0, $s2, passdone
+lw $t3, 0($t0)
+lw $t4, 4($t0)
+lw $t5, 8($t0)
+lw $t6, 12($t0)
+sw $t3, 0($t2)
+sw $t4, 4($t2)
+sw $t5, 8($t2)
+sw $t6, 12($t2)
+addi $t0, $t0, 4
+addi $t2, $t2, 4
+beq $zero, $zero, copy
+passdone:
+addi $s0, $s0, -1
+beq $zero, $zero, pass
+copied:
+add $v0, $zero, $zero
+add $t2, $s3, $zero
+sum:
+beq $t2, $s4, done
+lw $t3, 0($t2)
+add $v0, $v0, $t3
+addi $t2, $t2, 1
+beq $zero, $zero, sum
+done:
+halt
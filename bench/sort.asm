@@ -0,0 +1,65 @@
+#Benchmark kernel: bubble sort of 160 pseudo-random words at word 1000
+#The values come from x = x * 69069 + 1, kept to 15 bits so that the
+#difference of two of them is negative exactly when its bit 15 and up are
+#set. Afterwards $v0 holds the sum of the array and $v1 the number of
+#neighbours still out of order, 0 when sorted.
+addi $s0, $zero, 160    #n
+addi $s1, $zero, 1000   #a
+addi $t0, $zero, 23023
+addi $t1, $zero, 3
+mul $s2, $t0, $t1       #69069
+addi $s3, $zero, 32767  #value mask
+addi $s4, $zero, -32768 #sign test
+addi $t0, $zero, 12345  #x
+add $t1, $zero, $zero   #i
+add $t2, $s1, $zero     #&a[i]
+fill:
+beq $t1, $s0, filled
+mul $t0, $t0, $s2
+addi $t0, $t0, 1
+and $t3, $t0, $s3
+sw $t3, 0($t2)
+addi $t2, $t2, 1
+addi $t1, $t1, 1
+beq $zero, $zero, fill
+filled:
+addi $t4, $s0, -1       #last index of the unsorted part
+outer:
+beq $t4, $zero, sorted
+add $t2, $s1, $zero     #&a[j]
+add $t5, $s1, $t4       #&a[last]
+inner:
+beq $t2, $t5, passdone
+lw $t6, 0($t2)
+lw $t7, 4($t2)
+sub $t8, $t7, $t6
+and $t8, $t8, $s4
+beq $t8, $zero, ordered #a[j] <= a[j + 1]
+sw $t7, 0($t2)
+sw $t6, 4($t2)
+ordered:
+addi $t2, $t2, 1
+beq $zero, $zero, inner
+passdone:
+addi $t4, $t4, -1
+beq $zero, $zero, outer
+sorted:
+add $v0, $zero, $zero
+add $v1, $zero, $zero
+add $t2, $s1, $zero
+add $t5, $s1, $s0
+addi $t5, $t5, -1
+check:
+lw $t6, 0($t2)
+add $v0, $v0, $t6
+beq $t2, $t5, done
+lw $t7, 4($t2)
+sub $t8, $t7, $t6
+and $t8, $t8, $s4
+beq $t8, $zero, inorder
+addi $v1, $v1, 1
+inorder:
+addi $t2, $t2, 1
+beq $zero, $zero, check
+done:
+halt
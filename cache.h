@@ -0,0 +1,340 @@
+/*
+ * cache.h
+ *
+ *  Created on: Oct 18, 2026
+ *
+ *  Timing model of a cache hierarchy between the pipeline and RAM: split
+ *  L1 instruction and data caches in front of a unified L2. The caches
+ *  only keep tags, the data itself always lives in ram.h, so they decide
+ *  how long IF and MEM take but never what a load returns.
+ *
+ *  Every level has its own size, associativity, line size, replacement
+ *  policy (lru, plru: tree pseudo LRU, random), write policy and latency:
+ *    write-back:    write allocate; dirty lines are written to the next
+ *                   level when evicted, through a write buffer that costs
+ *                   no extra cycles
+ *    write-through: no write allocate; every store waits for the next
+ *                   level to take it
+ *  An access costs the latency of each level it reaches, RAM costing
+ *  LW_CLOCK_WAIT. Lines are tagged by 64-bit byte address: data at 4 * its
+ *  word address, which needs up to 34 bits, and instructions at TEXT_BASE +
+ *  4 * pc in a space of their own above that, so both share the L2
+ *  without aliasing.
+ *
+ *  REFERENCES: see projmain.c header comment.
+ */
+
+#ifndef CACHE_H_
+#define CACHE_H_
+
+/******************************************************************************
+ * Constants/Definitions
+ */
+#define TEXT_BASE 0x00400000 //byte address of instruction 0, as on MIPS
+#define TEXT_SPACE ((uint64_t) 1 << 34) //above every data byte address
+#define CACHE_LEVELS 3 //L1I, L1D, L2
+
+/******************************************************************************
+ * Global Vars and Structs
+ */
+typedef enum _replacement_tag {
+	REPLACE_LRU, REPLACE_PLRU, REPLACE_RANDOM
+} replacement;
+
+typedef struct cache_config_tag {
+	const char *name;
+	uint32_t size; //bytes
+	uint32_t assoc;
+	uint32_t lineSize; //bytes
+	replacement policy;
+	bool writeBack;
+	int32_t latency; //cycles for an access that hits here
+} cache_config;
+
+typedef struct cache_line_tag {
+	bool valid;
+	bool dirty;
+	uint64_t block; //address / lineSize, doubles as the tag
+	uint64_t lastUsed;
+} cache_line;
+
+typedef struct cache_tag {
+	cache_config config;
+	uint32_t sets;
+	int lineBits;
+	cache_line *lines; //sets * assoc, one set after another
+	uint64_t *plruBits; //one tree of assoc - 1 bits per set
+	uint64_t useCounter;
+	uint32_t randomState;
+	struct cache_tag *next; //NULL is RAM
+
+	//counters for the statistics
+	int64_t reads;
+	int64_t writes;
+	int64_t hits;
+	int64_t misses;
+	int64_t evictions;
+	int64_t writebacks;
+} cache;
+
+//name, size, assoc, line, replacement, write-back, latency
+const cache_config defaultCacheConfig[CACHE_LEVELS] = {
+		{ "l1i", 32 * 1024, 4, 64, REPLACE_LRU, true, 1 },
+		{ "l1d", 32 * 1024, 8, 64, REPLACE_LRU, true, 3 },
+		{ "l2", 256 * 1024, 8, 64, REPLACE_LRU, true, 12 } };
+
+const char *replacementNames[] = { "lru", "plru", "random" };
+
+/******************************************************************************
+ * Function Prototypes
+ */
+bool parseCacheConfig(const char*, cache_config*);
+bool parseCacheLevel(char*, cache_config*);
+void initCache(cache*, const cache_config*, cache*);
+void freeCache(cache*);
+int32_t cacheAccess(cache*, uint64_t, bool);
+int findVictim(cache*, uint32_t);
+void touchLine(cache*, uint32_t, int);
+
+/******************************************************************************
+ * Functions
+ */
+
+/**
+ * Fill 'configs' (CACHE_LEVELS entries) from a command line spec: "on" for
+ * the defaults, or comma separated levels overriding them, each written
+ *   level=size:assoc:line:replacement:write:latency
+ * e.g. "l1d=16k:2:32:plru:wt:2,l2=1m". Trailing fields may be left out to
+ * keep their defaults. Returns false for a spec that makes no sense.
+ */
+bool parseCacheConfig(const char *spec, cache_config *configs) {
+	char buffer[MAX_LINE_LENGTH];
+	char *level, *rest;
+	int i;
+
+	memcpy(configs, defaultCacheConfig, sizeof(defaultCacheConfig));
+	if (strcmp(spec, "on") == 0)
+		return true;
+	if (strlen(spec) >= sizeof(buffer))
+		return false;
+	strcpy(buffer, spec);
+
+	for (level = strtok_r(buffer, ",", &rest); level != NULL;
+			level = strtok_r(NULL, ",", &rest)) {
+		char *fields = strchr(level, '=');
+		if (fields == NULL)
+			return false;
+		*fields++ = '\0';
+		for (i = 0; i < CACHE_LEVELS; i++)
+			if (strcmp(level, configs[i].name) == 0)
+				break;
+		if (i == CACHE_LEVELS || !parseCacheLevel(fields, &configs[i]))
+			return false;
+	}
+	return true;
+}
+
+/**
+ * Apply the 'size:assoc:line:replacement:write:latency' fields of one level
+ * and check the geometry: powers of two, at least one set, and no more
+ * than 64 ways for plru.
+ */
+bool parseCacheLevel(char *fields, cache_config *config) {
+	char *field, *end, *rest;
+	int n = 0;
+	uint64_t value;
+
+	for (field = strtok_r(fields, ":", &rest); field != NULL;
+			field = strtok_r(NULL, ":", &rest), n++) {
+		switch (n) {
+		case 0: //size, with an optional k or m suffix
+			value = strtoul(field, &end, 10);
+			if (*end == 'k' || *end == 'K')
+				value *= 1024, end++;
+			else if (*end == 'm' || *end == 'M')
+				value *= 1024 * 1024, end++;
+			if (*end != '\0' || value > UINT32_MAX)
+				return false;
+			config->size = value;
+			break;
+		case 1:
+			config->assoc = strtoul(field, &end, 10);
+			if (*end != '\0')
+				return false;
+			break;
+		case 2:
+			config->lineSize = strtoul(field, &end, 10);
+			if (*end != '\0')
+				return false;
+			break;
+		case 3:
+			for (value = 0; value < 3; value++)
+				if (strcmp(field, replacementNames[value]) == 0)
+					break;
+			if (value == 3)
+				return false;
+			config->policy = value;
+			break;
+		case 4:
+			if (strcmp(field, "wb") != 0 && strcmp(field, "wt") != 0)
+				return false;
+			config->writeBack = strcmp(field, "wb") == 0;
+			break;
+		case 5:
+			config->latency = strtol(field, &end, 10);
+			if (*end != '\0' || config->latency < 1)
+				return false;
+			break;
+		default:
+			return false;
+		}
+	}
+
+#define POWER_OF_TWO(x) ((x) != 0 && ((x) & ((x) - 1)) == 0)
+	if (!POWER_OF_TWO(config->size) || !POWER_OF_TWO(config->assoc)
+			|| !POWER_OF_TWO(config->lineSize) || config->lineSize < 4
+			|| (uint64_t) config->assoc * config->lineSize > config->size
+			|| (config->policy == REPLACE_PLRU && config->assoc > 64))
+		return false;
+#undef POWER_OF_TWO
+	return true;
+}
+
+/**
+ * Set up an empty, all invalid cache in front of 'next' (NULL for RAM).
+ */
+void initCache(cache *c, const cache_config *config, cache *next) {
+	memset(c, 0, sizeof(cache));
+	c->config = *config;
+	c->sets = config->size / (config->assoc * config->lineSize);
+	while ((1u << c->lineBits) < config->lineSize)
+		c->lineBits++;
+	c->lines = calloc((size_t) c->sets * config->assoc, sizeof(cache_line));
+	c->plruBits = calloc(c->sets, sizeof(uint64_t));
+	if (c->lines == NULL || c->plruBits == NULL) {
+		printf("\n>>>ERROR!\n******Out of host memory for the %s cache,"
+				"\n\tFrom: cache.h @ line %d\n", config->name, __LINE__);
+		exit(1);
+	}
+	c->randomState = 0x9e3779b9; //fixed, so runs are repeatable
+	c->next = next;
+}
+
+void freeCache(cache *c) {
+	free(c->lines);
+	free(c->plruBits);
+	c->lines = NULL;
+	c->plruBits = NULL;
+}
+
+/**
+ * Read or write byte address 'addr' through cache 'c' and whatever levels
+ * lie behind it. Returns the cycles the access takes.
+ */
+int32_t cacheAccess(cache *c, uint64_t addr, bool write) {
+	if (c == NULL)
+		return LW_CLOCK_WAIT;
+
+	uint64_t block = addr >> c->lineBits;
+	uint32_t set = (uint32_t) (block & (c->sets - 1));
+	cache_line *ways = &c->lines[set * c->config.assoc];
+	int32_t latency = c->config.latency;
+	uint32_t way;
+
+	if (write)
+		c->writes++;
+	else
+		c->reads++;
+	for (way = 0; way < c->config.assoc; way++)
+		if (ways[way].valid && ways[way].block == block)
+			break;
+
+	if (way < c->config.assoc) { //hit
+		c->hits++;
+		touchLine(c, set, way);
+		if (write && c->config.writeBack)
+			ways[way].dirty = true;
+		else if (write)
+			latency += cacheAccess(c->next, addr, true);
+		return latency;
+	}
+
+	c->misses++;
+	if (write && !c->config.writeBack) //no write allocate
+		return latency + cacheAccess(c->next, addr, true);
+
+	latency += cacheAccess(c->next, addr, false); //fetch the line
+	way = findVictim(c, set);
+	if (ways[way].valid) {
+		c->evictions++;
+		if (ways[way].dirty) { //off to the write buffer
+			c->writebacks++;
+			cacheAccess(c->next, ways[way].block << c->lineBits, true);
+		}
+	}
+	ways[way].valid = true;
+	ways[way].dirty = write;
+	ways[way].block = block;
+	touchLine(c, set, way);
+	return latency;
+}
+
+/**
+ * The way of 'set' to fill next: an invalid one if there is any, otherwise
+ * the one the replacement policy picks.
+ */
+int findVictim(cache *c, uint32_t set) {
+	cache_line *ways = &c->lines[set * c->config.assoc];
+	uint32_t assoc = c->config.assoc;
+	uint32_t way, victim = 0;
+
+	for (way = 0; way < assoc; way++)
+		if (!ways[way].valid)
+			return way;
+
+	switch (c->config.policy) {
+	case REPLACE_LRU:
+		for (way = 1; way < assoc; way++)
+			if (ways[way].lastUsed < ways[victim].lastUsed)
+				victim = way;
+		return victim;
+	case REPLACE_PLRU: { //follow the tree bits down to a leaf
+		uint64_t bits = c->plruBits[set];
+		uint32_t node = 0;
+		while (node < assoc - 1) {
+			uint32_t right = (bits >> node) & 1;
+			victim = victim << 1 | right;
+			node = 2 * node + 1 + right;
+		}
+		return victim;
+	}
+	default: //xorshift32
+		c->randomState ^= c->randomState << 13;
+		c->randomState ^= c->randomState >> 17;
+		c->randomState ^= c->randomState << 5;
+		return c->randomState % assoc;
+	}
+}
+
+/**
+ * Mark 'way' of 'set' as the most recently used.
+ */
+void touchLine(cache *c, uint32_t set, int way) {
+	uint32_t assoc = c->config.assoc;
+	uint32_t node = 0, level;
+
+	c->lines[set * assoc + way].lastUsed = ++c->useCounter;
+	if (c->config.policy != REPLACE_PLRU)
+		return;
+	//point every node on the path to 'way' away from it
+	for (level = assoc >> 1; level > 0; level >>= 1) {
+		uint32_t right = (way & level) != 0;
+		if (right)
+			c->plruBits[set] &= ~(1ull << node);
+		else
+			c->plruBits[set] |= 1ull << node;
+		node = 2 * node + 1 + right;
+	}
+}
+
+#endif /* CACHE_H_ */
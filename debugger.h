@@ -0,0 +1,508 @@
+/*
+ * debugger.h
+ *
+ *  Created on: Oct 18, 2026
+ *
+ *  Interactive debugger for the timing engines (-g): stop at the start of
+ *  the run, step through fetches, run until an instruction, and stop at
+ *  breakpoints, optionally only while a register holds a given value, and
+ *  at watchpoints on the words loads and stores touch. At every stop the
+ *  registers, memory and breakpoints can be looked at from a prompt.
+ *
+ *  Fetch checks one bit of a bitmap with a bit per instruction of the
+ *  program, and the memory stage one bit of a filter with a bit per hash
+ *  of a RAM page; only a set bit calls into the debugger, which then looks
+ *  at the breakpoints of that instruction or the watchpoints of that page.
+ *  Conditions test the register file as it is when the instruction is
+ *  fetched, so older instructions still in flight have not written theirs
+ *  yet. The out-of-order core reports its loads and stores as they commit,
+ *  so wrong path loads never stop it.
+ *
+ *  The debugger is compiled in with -DDEBUGGER. Without it the hooks expand
+ *  to nothing and the machine does not even carry the debugger pointer.
+ *
+ *  REFERENCES: see projmain.c header comment.
+ */
+
+#ifndef DEBUGGER_H_
+#define DEBUGGER_H_
+
+/******************************************************************************
+ * Constants/Definitions
+ */
+#define MAX_BREAKPOINTS 64
+#define MAX_WATCHPOINTS 16
+#define WATCH_FILTER_BITS 4096 //RAM pages hash into these, see watchesPage
+#define DEBUG_PROMPT "(mdb) "
+//what a watchpoint stops on
+#define WATCH_READ 1
+#define WATCH_WRITE 2
+
+/******************************************************************************
+ * Global Vars and Structs
+ */
+#ifdef DEBUGGER
+//comparisons a conditional breakpoint can make
+typedef enum _compare_tag {
+	CMP_EQ, CMP_NE, CMP_LT, CMP_LE, CMP_GT, CMP_GE
+} compare;
+
+typedef struct breakpoint_tag {
+	int32_t pc;
+	bool conditional; //only stop while 'reg' 'test' 'value' holds
+	int8_t reg;
+	compare test;
+	int32_t value;
+	bool temporary; //set by until, gone once anything stops the run
+} breakpoint;
+
+typedef struct watchpoint_tag {
+	uint32_t addr; //word address
+	uint8_t on; //WATCH_READ and/or WATCH_WRITE
+} watchpoint;
+
+typedef struct debugger_tag {
+	uint64_t *breakBits; //a bit per instruction with a breakpoint
+	int32_t instructions; //in the program, the bits of 'breakBits'
+	breakpoint breaks[MAX_BREAKPOINTS];
+	int breakCount;
+	uint64_t watchFilter[WATCH_FILTER_BITS / 64]; //see watchesPage
+	watchpoint watches[MAX_WATCHPOINTS];
+	int watchCount;
+	int32_t stepsLeft; //fetches until the next stop, 0 when not stepping
+} debugger;
+
+//hooks for the stage functions, nothing unless compiled with -DDEBUGGER
+#define DEBUG_FETCH(m, pc) do { \
+	if ((m)->debug != NULL && ((m)->debug->stepsLeft > 0 \
+			|| ((m)->debug->breakBits[(pc) >> 6] >> ((pc) & 63) & 1))) \
+		debugFetch(m, pc); \
+} while (0)
+#define DEBUG_ACCESS(m, pc, addr, store) do { \
+	if ((m)->debug != NULL && watchesPage((m)->debug, addr)) \
+		debugAccess(m, pc, addr, store); \
+} while (0)
+#define watchesPage(d, addr) ((d)->watchFilter[watchSlot(addr) >> 6] \
+		>> (watchSlot(addr) & 63) & 1)
+#define watchSlot(addr) (((addr) >> PAGE_BITS) % WATCH_FILTER_BITS)
+#else
+#define DEBUG_FETCH(m, pc)
+#define DEBUG_ACCESS(m, pc, addr, store)
+#endif
+
+/******************************************************************************
+ * Function Prototypes
+ */
+#ifdef DEBUGGER
+debugger* attachDebugger(const program*);
+void detachDebugger(debugger*);
+void debugFetch(machine*, int32_t);
+void debugAccess(machine*, int32_t, uint32_t, bool);
+void debugPrompt(machine*);
+bool addBreakpoint(machine*, char*, bool);
+void deleteBreakpoints(debugger*, int32_t);
+bool addWatchpoint(debugger*, char*, uint8_t);
+void deleteWatchpoint(debugger*, uint32_t);
+bool conditionHolds(machine*, breakpoint*);
+void printDebugRegisters(machine*);
+void printDebugMemory(machine*, char*);
+void printBreakpoints(debugger*);
+void formatInstruction(const instr*, char*, size_t);
+int debugRegister(const char*);
+
+/******************************************************************************
+ * Functions
+ */
+
+/**
+ * A debugger for a machine running 'prog', with nothing set yet, that stops
+ * at the first fetch.
+ */
+debugger* attachDebugger(const program *prog) {
+	debugger *d = calloc(1, sizeof(debugger));
+
+	if (d == NULL || (d->breakBits = calloc((prog->count + 63) / 64 + 1,
+			sizeof(uint64_t))) == NULL) {
+		printf("\n>>>ERROR!\n******Out of host memory for the debugger,"
+				"\n\tFrom: debugger.h @ line %d\n", __LINE__);
+		exit(1);
+	}
+	d->instructions = prog->count;
+	d->stepsLeft = 1;
+	return d;
+}
+
+/**
+ * Free the debugger.
+ */
+void detachDebugger(debugger *d) {
+	free(d->breakBits);
+	free(d);
+}
+
+/**
+ * IF is fetching the instruction at 'pc', which has a breakpoint or comes
+ * at the end of a step: stop if the step is over or a breakpoint there
+ * holds.
+ */
+void debugFetch(machine *m, int32_t pc) {
+	debugger *d = m->debug;
+	char text[64];
+	int k;
+
+	if (d->stepsLeft > 0 && --d->stepsLeft == 0) {
+		formatInstruction(&m->prog->instructions[pc], text, sizeof(text));
+		printf("\nclock %d, fetching %d: %s\n", m->clocks, pc, text);
+		debugPrompt(m);
+		return;
+	}
+	for (k = 0; k < d->breakCount; k++) {
+		breakpoint *b = &d->breaks[k];
+		if (b->pc != pc || (b->conditional && !conditionHolds(m, b)))
+			continue;
+		formatInstruction(&m->prog->instructions[pc], text, sizeof(text));
+		printf("\n%s at clock %d, fetching %d: %s\n", b->temporary ?
+				"Until" : "Breakpoint", m->clocks, pc, text);
+		debugPrompt(m);
+		return;
+	}
+}
+
+/**
+ * MEM loaded or stored the word at 'addr', on a page with a watchpoint:
+ * stop if a watchpoint is on that word for this kind of access.
+ */
+void debugAccess(machine *m, int32_t pc, uint32_t addr, bool store) {
+	debugger *d = m->debug;
+	char text[64];
+	int k;
+
+	for (k = 0; k < d->watchCount; k++) {
+		watchpoint *w = &d->watches[k];
+		if (w->addr != addr || !(w->on & (store ? WATCH_WRITE : WATCH_READ)))
+			continue;
+		formatInstruction(&m->prog->instructions[pc], text, sizeof(text));
+		printf("\nWatchpoint 0x%04x at clock %d, %d: %s %s 0x%08x\n", addr,
+				m->clocks, pc, text, store ? "stored" : "loaded",
+				memRead(&m->memory, addr));
+		debugPrompt(m);
+		return;
+	}
+}
+
+/**
+ * Read and run commands until one of them carries on with the run. The end
+ * of the input detaches the debugger, so the run finishes on its own.
+ */
+void debugPrompt(machine *m) {
+	debugger *d = m->debug;
+	char line[MAX_LINE_LENGTH];
+	char *command, *args;
+
+	//until's breakpoint only lasts until the next stop, whatever it was
+	deleteBreakpoints(d, -1);
+
+	for (;;) {
+		printf(DEBUG_PROMPT);
+		fflush(stdout);
+		if (fgets(line, sizeof(line), stdin) == NULL) {
+			printf("\nDetached.\n");
+			m->debug = NULL;
+			detachDebugger(d);
+			return;
+		}
+		command = strtok(line, " \t\n");
+		args = strtok(NULL, "\n");
+		if (command == NULL)
+			continue;
+
+		if (!strcmp(command, "s") || !strcmp(command, "step")) {
+			d->stepsLeft = args != NULL ? atoi(args) : 1;
+			if (d->stepsLeft > 0)
+				return;
+			printf("Steps must be 1 or more.\n");
+		} else if (!strcmp(command, "c") || !strcmp(command, "continue")) {
+			return;
+		} else if (!strcmp(command, "u") || !strcmp(command, "until")) {
+			if (addBreakpoint(m, args, true))
+				return;
+		} else if (!strcmp(command, "b") || !strcmp(command, "break")) {
+			addBreakpoint(m, args, false);
+		} else if (!strcmp(command, "d") || !strcmp(command, "delete")) {
+			if (args != NULL && atoi(args) >= 0)
+				deleteBreakpoints(d, atoi(args));
+		} else if (!strcmp(command, "watch")) {
+			addWatchpoint(d, args, WATCH_WRITE);
+		} else if (!strcmp(command, "rwatch")) {
+			addWatchpoint(d, args, WATCH_READ);
+		} else if (!strcmp(command, "awatch")) {
+			addWatchpoint(d, args, WATCH_READ | WATCH_WRITE);
+		} else if (!strcmp(command, "unwatch")) {
+			if (args != NULL)
+				deleteWatchpoint(d, strtoul(args, NULL, 0));
+		} else if (!strcmp(command, "r") || !strcmp(command, "regs")) {
+			printDebugRegisters(m);
+		} else if (!strcmp(command, "m") || !strcmp(command, "mem")) {
+			printDebugMemory(m, args);
+		} else if (!strcmp(command, "i") || !strcmp(command, "info")) {
+			printf("clock %d, next fetch %d, %lld retired\n", m->clocks,
+					m->pc, (long long) m->retiredInstructions);
+			printBreakpoints(d);
+		} else if (!strcmp(command, "q") || !strcmp(command, "quit")) {
+			exit(0);
+		} else {
+			printf("step [n]             stop after n more fetches\n");
+			printf("continue             run to the next stop\n");
+			printf("until pc             run until pc is fetched\n");
+			printf("break pc [if $r op value]\n");
+			printf("                     stop when pc is fetched, while"
+					" the condition holds\n");
+			printf("delete pc            remove the breakpoints at pc\n");
+			printf("watch|rwatch|awatch addr\n");
+			printf("                     stop when a store, load or either"
+					" touches the word\n");
+			printf("unwatch addr         remove the watchpoint on addr\n");
+			printf("regs                 show the register file\n");
+			printf("mem addr [count]     show count words from addr\n");
+			printf("info                 show the clock, breakpoints and"
+					" watchpoints\n");
+			printf("quit                 end the simulation\n");
+		}
+	}
+}
+
+/**
+ * Set a breakpoint from "pc [if $reg op value]". Returns false, after
+ * saying why, when it could not be set.
+ */
+bool addBreakpoint(machine *m, char *args, bool temporary) {
+	debugger *d = m->debug;
+	breakpoint b = { 0 };
+	char reg[16], test[4], extra;
+	const char *tests[] = { "==", "!=", "<", "<=", ">", ">=" };
+	int k, fields;
+
+	if (args == NULL) {
+		printf("Which instruction?\n");
+		return false;
+	}
+	fields = sscanf(args, "%d if %15s %3s %i %c", &b.pc, reg, test,
+			&b.value, &extra);
+	if (fields != 1 && fields != 4) {
+		printf("Write a breakpoint as: pc [if $reg op value].\n");
+		return false;
+	}
+	if (b.pc < 0 || b.pc >= m->prog->count) {
+		printf("The program has instructions 0 to %d.\n",
+				m->prog->count - 1);
+		return false;
+	}
+	if (fields == 4) {
+		b.conditional = true;
+		b.reg = debugRegister(reg);
+		for (k = 0; k < 6 && strcmp(tests[k], test) != 0; k++)
+			;
+		if (b.reg < 0 || k == 6) {
+			printf("Conditions compare a register, with one of == != < <="
+					" > >=.\n");
+			return false;
+		}
+		b.test = k;
+	}
+	if (d->breakCount == MAX_BREAKPOINTS) {
+		printf("No more than %d breakpoints.\n", MAX_BREAKPOINTS);
+		return false;
+	}
+	b.temporary = temporary;
+	d->breaks[d->breakCount++] = b;
+	d->breakBits[b.pc >> 6] |= (uint64_t) 1 << (b.pc & 63);
+	return true;
+}
+
+/**
+ * Remove every breakpoint at 'pc', or with -1 the one until set. The
+ * bitmap is built again from the breakpoints left.
+ */
+void deleteBreakpoints(debugger *d, int32_t pc) {
+	int k, kept = 0;
+	for (k = 0; k < d->breakCount; k++)
+		if (pc < 0 ? !d->breaks[k].temporary : d->breaks[k].pc != pc)
+			d->breaks[kept++] = d->breaks[k];
+	d->breakCount = kept;
+	memset(d->breakBits, 0, ((d->instructions + 63) / 64 + 1)
+			* sizeof(uint64_t));
+	for (k = 0; k < d->breakCount; k++)
+		d->breakBits[d->breaks[k].pc >> 6] |= (uint64_t) 1
+				<< (d->breaks[k].pc & 63);
+}
+
+/**
+ * Watch the word at the address in 'args' for the accesses in 'on'.
+ * Returns false, after saying why, when it could not be set.
+ */
+bool addWatchpoint(debugger *d, char *args, uint8_t on) {
+	char *end;
+	uint32_t addr;
+	int k;
+
+	if (args == NULL || (addr = strtoul(args, &end, 0), end == args)) {
+		printf("Which word address?\n");
+		return false;
+	}
+	for (k = 0; k < d->watchCount; k++)
+		if (d->watches[k].addr == addr) {
+			d->watches[k].on |= on;
+			return true;
+		}
+	if (d->watchCount == MAX_WATCHPOINTS) {
+		printf("No more than %d watchpoints.\n", MAX_WATCHPOINTS);
+		return false;
+	}
+	d->watches[d->watchCount].addr = addr;
+	d->watches[d->watchCount++].on = on;
+	d->watchFilter[watchSlot(addr) >> 6] |= (uint64_t) 1
+			<< (watchSlot(addr) & 63);
+	return true;
+}
+
+/**
+ * Stop watching the word at 'addr'. The filter is built again from the
+ * watchpoints left, since pages can share its bits.
+ */
+void deleteWatchpoint(debugger *d, uint32_t addr) {
+	int k, kept = 0;
+	for (k = 0; k < d->watchCount; k++)
+		if (d->watches[k].addr != addr)
+			d->watches[kept++] = d->watches[k];
+	d->watchCount = kept;
+	memset(d->watchFilter, 0, sizeof(d->watchFilter));
+	for (k = 0; k < d->watchCount; k++)
+		d->watchFilter[watchSlot(d->watches[k].addr) >> 6] |= (uint64_t) 1
+				<< (watchSlot(d->watches[k].addr) & 63);
+}
+
+/**
+ * Does the register file meet the condition of 'b' right now?
+ */
+bool conditionHolds(machine *m, breakpoint *b) {
+	int32_t value = m->regs[b->reg];
+	switch (b->test) {
+	case CMP_EQ:
+		return value == b->value;
+	case CMP_NE:
+		return value != b->value;
+	case CMP_LT:
+		return value < b->value;
+	case CMP_LE:
+		return value <= b->value;
+	case CMP_GT:
+		return value > b->value;
+	default:
+		return value >= b->value;
+	}
+}
+
+/**
+ * The register file, four registers a line. In a pipeline the instructions
+ * still in flight have not written theirs yet.
+ */
+void printDebugRegisters(machine *m) {
+	int reg;
+	for (reg = 0; reg < 32; reg++)
+		printf("$%-4s %11d%s", regMap[reg].name, m->regs[reg],
+				reg % 4 == 3 ? "\n" : "   ");
+}
+
+/**
+ * The 'count' words of memory from the address in 'args', "addr [count]".
+ */
+void printDebugMemory(machine *m, char *args) {
+	char *end;
+	uint32_t addr;
+	int count = 1;
+
+	if (args == NULL || (addr = strtoul(args, &end, 0), end == args)) {
+		printf("Which word address?\n");
+		return;
+	}
+	if (*end != '\0')
+		count = atoi(end);
+	for (; count > 0; count--, addr++)
+		printf(" 0x%04x->\t0x%08x\t%8d\n", addr, memRead(&m->memory, addr),
+				memRead(&m->memory, addr));
+}
+
+/**
+ * List the breakpoints and watchpoints.
+ */
+void printBreakpoints(debugger *d) {
+	const char *tests[] = { "==", "!=", "<", "<=", ">", ">=" };
+	const char *on[] = { "", "load", "store", "access" };
+	int k;
+
+	for (k = 0; k < d->breakCount; k++) {
+		breakpoint *b = &d->breaks[k];
+		printf("break %d", b->pc);
+		if (b->conditional)
+			printf(" if $%s %s %d", regMap[b->reg].name, tests[b->test],
+					b->value);
+		printf("\n");
+	}
+	for (k = 0; k < d->watchCount; k++)
+		printf("watch 0x%04x on %s\n", d->watches[k].addr,
+				on[d->watches[k].on]);
+}
+
+/**
+ * Write 'inst' back out as assembly, the way the assembler reads it.
+ */
+void formatInstruction(const instr *inst, char *text, size_t size) {
+	const op_info *info = &opTable[inst->op];
+	const char *rs = regMap[inst->rs & 31].name;
+	const char *rt = regMap[inst->rt & 31].name;
+	const char *rd = regMap[inst->rd & 31].name;
+	int32_t i = info->roles & ZERO_EXTENDS ? (uint16_t) inst->i : inst->i;
+
+	switch (info->shape) {
+	case OPS_RD_RS_RT:
+		snprintf(text, size, "%s $%s, $%s, $%s", info->name, rd, rs, rt);
+		break;
+	case OPS_RD_RT_SHAMT:
+		snprintf(text, size, "%s $%s, $%s, %d", info->name, rd, rt, i);
+		break;
+	case OPS_RS:
+		snprintf(text, size, "%s $%s", info->name, rs);
+		break;
+	case OPS_RT_RS_IMM:
+	case OPS_RS_RT_OFFSET:
+		snprintf(text, size, "%s $%s, $%s, %d", info->name, rt, rs, i);
+		break;
+	case OPS_RT_IMM:
+		snprintf(text, size, "%s $%s, %d", info->name, rt, i);
+		break;
+	case OPS_RT_OFFSET_BASE:
+		snprintf(text, size, "%s $%s, %d($%s)", info->name, rt, i, rs);
+		break;
+	case OPS_TARGET:
+		snprintf(text, size, "%s %d", info->name, i);
+		break;
+	default:
+		snprintf(text, size, "%s", info->name);
+		break;
+	}
+}
+
+/**
+ * The number of a register written like $t0 or $8, -1 if there is none.
+ */
+int debugRegister(const char *name) {
+	const reg_name *r;
+	if (name[0] != '$')
+		return -1;
+	r = lookupRegister(name + 1);
+	return r == NULL ? -1 : r->index;
+}
+
+#endif /* DEBUGGER */
+
+#endif /* DEBUGGER_H_ */
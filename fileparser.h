@@ -14,15 +14,41 @@
 /******************************************************************************
  * Constants/Definitions
  */
+#define OBJ_MAGIC "MOBJ" //first 4 bytes of every object file
+#define OBJ_VERSION 1
+#define DATA_ADDR 0x1000 //word address a source's .data section loads at
 
 /******************************************************************************
  * Global Vars and Structs
  */
 
+/*
+ * Object file layout (host byte order, all fields 32-bit aligned):
+ *   obj_header
+ *   text section: textCount machine code words, one per instruction
+ *   data section: dataCount words, loaded into RAM starting at word address
+ *                 dataAddr
+ */
+typedef struct obj_header_tag {
+	char magic[4];
+	uint16_t version;
+	uint16_t headerSize; //bytes, so newer headers can grow
+	uint32_t entry; //instruction index execution starts at
+	uint32_t textCount;
+	uint32_t dataAddr;
+	uint32_t dataCount;
+} obj_header;
+
 /******************************************************************************
  * Function Prototypes
  */
-void parseASMFile(char*, char*);
+void parseASMFile(program*, char*, char*);
+void parseLine(program*, symbol_table*, char*, bool*, bool);
+void parseDirective(program*, symbol_table*, char*, bool*);
+void resolveFixups(program*, symbol_table*);
+bool isObjectFile(char*);
+void loadObjectFile(program*, char*);
+void requireHalt(const program*, char*);
 
 /******************************************************************************
  * Functions
@@ -30,29 +56,335 @@ void parseASMFile(char*, char*);
 
 /*
  * Take in an assembly file (.asm) with MIPS instructions, parse each line
- * of text into an array and send it to the 'parseInstruction' function found
- * in 'instruction.h' header file.
+ * of text into an array and send it to 'parseLine', which adds its labels,
+ * directives and instruction to 'prog'. Label operands are patched in once
+ * the whole file is read, then the machine code is written out. A NULL
+ * 'outFile' assembles quietly, without writing an object file.
  */
-void parseASMFile(char *inFile, char *outFile) {
+void parseASMFile(program *prog, char *inFile, char *outFile) {
 
-	char instrStr[100];//instruction string/lines
+	char *instrStr = NULL; //instruction string/lines, of any length
+	size_t instrSize = 0;
+	symbol_table symbols = { 0 };
+	bool inData = false; //in a .data section, not .text
+	int32_t i;
 
 	FILE *fptr = fopen(inFile, "r");
 	if (fptr == NULL) {
 		printf("Input file '%s' could not be opened.", inFile);
 		exit(1);
 	}
-	FILE *fptrOUT = fopen(outFile, "w");
-	if (fptrOUT == NULL) {
+	FILE *fptrOUT = NULL;
+	if (outFile != NULL && (fptrOUT = fopen(outFile, "wb")) == NULL) {
 			printf("Output file '%s' could not be opened.", outFile);
 			exit(1);
 	}
 
-	printf("Instructions found:\n");
-	while (fgets(instrStr, 100, fptr))
-		parseInstruction(instrStr, fptrOUT);
+	if (fptrOUT != NULL)
+		printf("Instructions found:\n");
+	while (getline(&instrStr, &instrSize, fptr) != -1) {
+		symbols.line++;
+		//UTF-8 byte order mark some editors put at the start of a file
+		if (symbols.line == 1 && (uint8_t) instrStr[0] == 0xef
+				&& (uint8_t) instrStr[1] == 0xbb
+				&& (uint8_t) instrStr[2] == 0xbf)
+			memmove(instrStr, instrStr + 3, strlen(instrStr + 3) + 1);
+		parseLine(prog, &symbols, instrStr, &inData, fptrOUT != NULL);
+	}
+	free(instrStr);
+	fclose(fptr);
+	resolveFixups(prog, &symbols);
+	freeSymbols(&symbols);
+	requireHalt(prog, inFile);
+
+	if (fptrOUT != NULL) {
+		obj_header header = { .version = OBJ_VERSION,
+				.headerSize = sizeof(obj_header) };
+		memcpy(header.magic, OBJ_MAGIC, 4);
+		header.entry = prog->entry;
+		header.textCount = prog->count;
+		header.dataAddr = prog->dataAddr;
+		header.dataCount = prog->dataCount;
+		fwrite(&header, sizeof(header), 1, fptrOUT);
+		//the machine code words of the text section, then the data
+		for (i = 0; i < prog->count; i++) {
+			uint32_t word = encodeInstruction(&prog->instructions[i]);
+			fwrite(&word, sizeof(word), 1, fptrOUT);
+		}
+		fwrite(prog->data, sizeof(int32_t), prog->dataCount, fptrOUT);
+		fclose(fptrOUT);
+	}
+}
+
+/*
+ * One source line: any 'label:' definitions, then a directive or an
+ * instruction. A label names the next instruction, or the next data word
+ * inside a .data section.
+ */
+void parseLine(program *prog, symbol_table *symbols, char *source,
+		bool *inData, bool echo) {
+	char *p = source;
+
+	for (;;) {
+		while (isspace((unsigned char) *p))
+			p++;
+		token name = { p, 0 };
+		while (isalnum((unsigned char) p[name.length])
+				|| p[name.length] == '_' || p[name.length] == '.')
+			name.length++;
+		if (name.length == 0 || p[name.length] != ':')
+			break;
+		if (*inData)
+			defineSymbol(symbols, name, prog->dataAddr + prog->dataCount,
+					true);
+		else
+			defineSymbol(symbols, name, prog->count, false);
+		p += name.length + 1;
+	}
+
+	if (*p == '.')
+		parseDirective(prog, symbols, p, inData);
+	else if (*inData && *p != '\0' && *p != '#')
+		syntaxError("Instruction inside the data section", __LINE__);
+	else
+		parseInstruction(prog, symbols, p, echo);
+}
+
+/*
+ * .text and .data switch sections; in a data section .word appends the
+ * numbers and labels listed after it, and .space appends enough zero words
+ * for the given number of bytes.
+ */
+void parseDirective(program *prog, symbol_table *symbols, char *p,
+		bool *inData) {
+	token name = { p, 1 };
+	char *end;
+
+	while (isalnum((unsigned char) p[name.length]))
+		name.length++;
+	p += name.length;
+	if (name.length == 5 && strncmp(name.start, ".text", 5) == 0) {
+		*inData = false;
+	} else if (name.length == 5 && strncmp(name.start, ".data", 5) == 0) {
+		*inData = true;
+		if (prog->dataCount == 0)
+			prog->dataAddr = DATA_ADDR;
+	} else if (name.length == 5 && strncmp(name.start, ".word", 5) == 0) {
+		if (!*inData)
+			syntaxError("'.word' outside the data section", __LINE__);
+		do {
+			while (isspace((unsigned char) *p))
+				p++;
+			token value = { p, 0 };
+			while (value.start[value.length] != '\0'
+					&& value.start[value.length] != ','
+					&& value.start[value.length] != '#'
+					&& !isspace((unsigned char) value.start[value.length]))
+				value.length++;
+			if (value.length == 0)
+				syntaxError("Missing value in '.word'", __LINE__);
+
+			prog->data = growArray(prog->data, &prog->dataCapacity,
+					prog->dataCount + 1, sizeof(int32_t));
+			if (isLabel(value)) {
+				addFixup(symbols, FIX_WORD, value, prog->dataCount);
+				prog->data[prog->dataCount++] = 0;
+			} else {
+				long long word = strtoll(value.start, &end, 0);
+				if (end != value.start + value.length || word < INT32_MIN
+						|| word > UINT32_MAX)
+					syntaxError("Invalid value in '.word'", __LINE__);
+				prog->data[prog->dataCount++] = (int32_t) word;
+			}
+			p += value.length;
+			while (isspace((unsigned char) *p))
+				p++;
+		} while (*p++ == ',');
+		p--;
+	} else if (name.length == 6 && strncmp(name.start, ".space", 6) == 0) {
+		if (!*inData)
+			syntaxError("'.space' outside the data section", __LINE__);
+		long bytes = strtol(p, &end, 0);
+		if (end == p || bytes < 0 || bytes > INT32_MAX - 3)
+			syntaxError("Invalid size in '.space'", __LINE__);
+		int32_t words = (bytes + 3) / 4;
+		prog->data = growArray(prog->data, &prog->dataCapacity,
+				prog->dataCount + words, sizeof(int32_t));
+		memset(prog->data + prog->dataCount, 0, words * sizeof(int32_t));
+		prog->dataCount += words;
+		p = end;
+	} else {
+		printf("\n>>>ERROR!\n******Unknown directive: * %.*s * on line %d,"
+				"\n\tFrom: fileparser.h @ line %d\n", name.length,
+				name.start, symbols->line, __LINE__);
+		exit(1);
+	}
+
+	while (isspace((unsigned char) *p))
+		p++;
+	if (*p != '\0' && *p != '#')
+		syntaxError("Unexpected text after directive", __LINE__);
+}
+
+/*
+ * Now that every label is known, patch each operand that uses one.
+ */
+void resolveFixups(program *prog, symbol_table *symbols) {
+	int32_t i, value;
+	instr *inst;
+
+	for (i = 0; i < symbols->fixupCount; i++) {
+		const fixup *f = &symbols->fixups[i];
+		const symbol *sym = &symbols->symbols[f->symbol];
+		if (!sym->defined) {
+			printf("\n>>>ERROR!\n******Undefined label * %s * used on line"
+					" %d,\n\tFrom: fileparser.h @ line %d\n", sym->name,
+					f->line, __LINE__);
+			exit(1);
+		}
+
+		switch (f->kind) {
+		case FIX_WORD:
+			prog->data[f->at] = sym->value;
+			continue;
+		case FIX_BRANCH:
+			if (sym->isData)
+				goto badTarget;
+			value = sym->value - (f->at + 1);
+			break;
+		case FIX_OFFSET:
+			value = sym->value * 4;
+			if (value / 4 != sym->value)
+				goto tooLarge;
+			break;
+		case FIX_TARGET:
+			if (sym->isData)
+				goto badTarget;
+			value = sym->value;
+			break;
+		case FIX_HIGH:
+			value = (int16_t) ((uint32_t) sym->value >> 16);
+			break;
+		case FIX_LOW:
+			value = (int16_t) sym->value;
+			break;
+		default: //FIX_IMMEDIATE
+			value = sym->value;
+			break;
+		}
+		inst = &prog->instructions[f->at];
+		if (!fitsField(inst, value))
+			goto tooLarge;
+		inst->i = instrType(inst) == JType ? value : (int16_t) value;
+		continue;
+
+		badTarget:
+		printf("\n>>>ERROR!\n******Branch or jump to data label * %s * on line %d,"
+				"\n\tFrom: fileparser.h @ line %d\n", sym->name, f->line,
+				__LINE__);
+		exit(1);
+		tooLarge:
+		printf("\n>>>ERROR!\n******Label * %s * out of range on line %d%s,"
+				"\n\tFrom: fileparser.h @ line %d\n", sym->name, f->line,
+				f->kind == FIX_OFFSET ? " (la can load its address)" : "",
+				__LINE__);
+		exit(1);
+	}
+}
+
+/*
+ * Check the first bytes of a file for the object file magic number, so an
+ * already assembled program can be loaded without re-parsing its source.
+ */
+bool isObjectFile(char *inFile) {
+	char magic[4];
+	bool isObj = false;
 
+	FILE *fptr = fopen(inFile, "rb");
+	if (fptr == NULL)
+		return false;
+	if (fread(magic, 1, 4, fptr) == 4 && memcmp(magic, OBJ_MAGIC, 4) == 0)
+		isObj = true;
 	fclose(fptr);
+	return isObj;
+}
+
+/*
+ * Map an object file written by parseASMFile() into memory and decode the
+ * text section straight from the mapping into 'prog', then copy out the
+ * data section that machines start with in RAM.
+ */
+void loadObjectFile(program *prog, char *objFile) {
+	struct stat st;
+	int fd = open(objFile, O_RDONLY);
+	if (fd < 0 || fstat(fd, &st) < 0) {
+		printf("Input file '%s' could not be opened.", objFile);
+		exit(1);
+	}
+	if ((size_t) st.st_size < sizeof(obj_header)) {
+		printf("\n>>>ERROR!\n******Truncated object file: * %s *"
+				"\n\tFrom: fileparser.h @ line %d\n", objFile, __LINE__);
+		exit(1);
+	}
+	uint8_t *base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (base == MAP_FAILED) {
+		printf("Input file '%s' could not be mapped.", objFile);
+		exit(1);
+	}
+	close(fd);
+
+	obj_header *header = (obj_header*) base;
+	if (memcmp(header->magic, OBJ_MAGIC, 4) != 0
+			|| header->version != OBJ_VERSION
+			|| header->headerSize < sizeof(obj_header)
+			|| header->entry >= header->textCount
+			|| (uint64_t) header->headerSize
+					+ 4 * ((uint64_t) header->textCount + header->dataCount)
+					> (uint64_t) st.st_size
+			|| header->textCount > INT32_MAX / sizeof(instr)) {
+		printf("\n>>>ERROR!\n******Invalid object file: * %s *"
+				"\n\tFrom: fileparser.h @ line %d\n", objFile, __LINE__);
+		exit(1);
+	}
+
+	const uint32_t *text = (const uint32_t*) (base + header->headerSize);
+	const uint32_t *data = text + header->textCount;
+	uint32_t i;
+	reserveInstructions(prog, header->textCount);
+	for (i = 0; i < header->textCount; i++) {
+		prog->instructions[i] = decodeInstruction(text[i]);
+		if (isHalt(&prog->instructions[i]))
+			prog->haltIndex = i;
+	}
+	prog->count = header->textCount;
+	prog->entry = header->entry;
+	prog->dataAddr = header->dataAddr;
+	prog->dataCount = header->dataCount;
+	prog->dataCapacity = header->dataCount;
+	requireHalt(prog, objFile);
+	if (header->dataCount > 0) {
+		prog->data = malloc(header->dataCount * sizeof(int32_t));
+		if (prog->data == NULL) {
+			printf("\n>>>ERROR!\n******Out of host memory for the data section,"
+					"\n\tFrom: fileparser.h @ line %d\n", __LINE__);
+			exit(1);
+		}
+		memcpy(prog->data, data, header->dataCount * sizeof(int32_t));
+	}
+
+	munmap(base, st.st_size);
+}
+
+/*
+ * Stop on a program without a halt: only a retiring halt ends a run, so it
+ * could never finish.
+ */
+void requireHalt(const program *prog, char *file) {
+	if (prog->count == 0 || !isHalt(&prog->instructions[prog->haltIndex])) {
+		printf("\n>>>ERROR!\n******No halt instruction in the program: * %s *"
+				"\n\tFrom: fileparser.h @ line %d\n", file, __LINE__);
+		exit(1);
+	}
 }
 
 #endif /* FILEPARSER_H_ */
@@ -0,0 +1,393 @@
+/*
+ * functional.h
+ *
+ *  Created on: Oct 18, 2026
+ *
+ *  Fast functional simulation: runs the decoded 'instructions' array
+ *  architecturally, one instruction after another, without modeling the
+ *  pipeline or any clock cycles. The final register file and RAM match
+ *  what the cycle by cycle pipeline in pipeline.h produces.
+ *
+ *  The program is first predecoded into 'fast_op' entries that carry the
+ *  address of their handler, then executed with threaded dispatch (GCC's
+ *  computed goto), so each instruction costs a single indirect jump. The
+ *  common opcodes have handlers of their own; the rest of the ALU ops,
+ *  loads and stores share generic handlers that go by 'opTable'.
+ *
+ *  The predecode pass also fuses common pairs of instructions, such as a
+ *  loop counter update and the bne testing it, a slt and its branch, a
+ *  lui/ori constant or a load and the add using it, into
+ *  superinstructions: the first entry of the pair runs the first
+ *  instruction and jumps straight into the handler of the second, saving
+ *  an indirect jump. The second entry keeps its own handler, so branching
+ *  into the middle of a pair still works. Fusing pairs in place stands in
+ *  for forming basic blocks: there is no block cache to key by entry pc,
+ *  and nothing to invalidate, as program text is read only and predecoded
+ *  again for every run. With
+ *  'jitThreshold' set, every branch and jump also hands the block it lands
+ *  on to the translation tier in jit.h, which runs it as host code once it
+ *  is hot.
+ *
+ *  REFERENCES: see projmain.c header comment.
+ */
+
+#ifndef FUNCTIONAL_H_
+#define FUNCTIONAL_H_
+
+#include "pipeline.h"
+#include "jit.h"
+
+/******************************************************************************
+ * Constants/Definitions
+ */
+
+/******************************************************************************
+ * Global Vars and Structs
+ */
+
+//predecoded instruction, ready to be dispatched
+typedef struct fast_op_tag {
+	void *handler;
+	int8_t rs;
+	int8_t rt;
+	int8_t rd;
+	int32_t i;
+} fast_op;
+
+/******************************************************************************
+ * Function Prototypes
+ */
+void runFunctional(machine*);
+
+/******************************************************************************
+ * Functions
+ */
+
+/**
+ * Execute the machine's program from its pc until the halt instruction,
+ * updating its registers and RAM only.
+ */
+void runFunctional(machine *m) {
+	static void *handlers[] = { [ADD] = &&op_add, [ADDU] = &&op_add,
+			[ADDI] = &&op_addi, [ADDIU] = &&op_addi, [SUB] = &&op_sub,
+			[SUBU] = &&op_sub, [AND] = &&op_and, [OR] = &&op_or,
+			[MUL] = &&op_mul, [MULU] = &&op_mul, [LUI] = &&op_lui,
+			[ORI] = &&op_ori, [SLT] = &&op_slt, [SLTI] = &&op_slti,
+			[BEQ] = &&op_beq,
+			[BNE] = &&op_bne, [J] = &&op_j, [JAL] = &&op_jal, [JR] = &&op_jr,
+			[LW] = &&op_lw, [LL] = &&op_lw, [SW] = &&op_sw,
+			[HALT] = &&op_halt, [BUBBLE] = &&op_bubble };
+	//the rest, by what they do
+	static void *generic[] = { [DOES_ALU] = &&op_alu,
+			[DOES_LOAD] = &&op_load, [DOES_STORE] = &&op_store };
+	//superinstructions, by the opcodes of the pair
+	static void *fused[OPCODES][OPCODES] = {
+			[ADDI] = { [BEQ] = &&op_addi_beq, [LW] = &&op_addi_lw,
+					[SW] = &&op_addi_sw, [ADDI] = &&op_addi_addi,
+					[ADD] = &&op_addi_add, [BNE] = &&op_addi_bne },
+			[ADD] = { [BEQ] = &&op_add_beq, [ADD] = &&op_add_add,
+					[ADDI] = &&op_add_addi, [LW] = &&op_add_lw },
+			[SUB] = { [AND] = &&op_sub_and, [BEQ] = &&op_sub_beq },
+			[AND] = { [BEQ] = &&op_and_beq },
+			[MUL] = { [ADD] = &&op_mul_add },
+			[LUI] = { [ORI] = &&op_lui_ori },
+			[SLT] = { [BEQ] = &&op_slt_beq, [BNE] = &&op_slt_bne },
+			[SLTI] = { [BEQ] = &&op_slti_beq, [BNE] = &&op_slti_bne },
+			[LW] = { [LW] = &&op_lw_lw, [ADD] = &&op_lw_add,
+					[SUB] = &&op_lw_sub, [MUL] = &&op_lw_mul,
+					[SW] = &&op_lw_sw, [BEQ] = &&op_lw_beq },
+			[SW] = { [SW] = &&op_sw_sw, [ADDI] = &&op_sw_addi } };
+	const instr *inst;
+	int32_t i, target;
+	int64_t retired = 0;
+	const program *prog = m->prog;
+	int32_t *regs = m->regs;
+	fast_op *fastCode, *op;
+	uint32_t addr;
+	jit *j = m->jitThreshold > 0 ? openJit(prog, m->jitThreshold) : NULL;
+
+	//predecode: resolve every instruction to its handler once, fusing pairs;
+	//one more entry past the end catches a program running off it
+	fastCode = malloc((prog->count + 1) * sizeof(fast_op));
+	if (fastCode == NULL) {
+		printf("\n>>>ERROR!\n******Out of host memory for the program,"
+				"\n\tFrom: functional.h @ line %d\n", __LINE__);
+		exit(1);
+	}
+	for (i = 0; i < prog->count; i++) {
+		inst = &prog->instructions[i];
+		fastCode[i].handler = handlers[inst->op];
+		if (fastCode[i].handler == NULL)
+			fastCode[i].handler = generic[opTable[inst->op].kind];
+		if (fastCode[i].handler == NULL)
+			fastCode[i].handler = &&op_unrecognized;
+		else if (i < prog->count - 1 && fused[inst->op][inst[1].op] != NULL)
+			fastCode[i].handler = fused[inst->op][inst[1].op];
+		fastCode[i].rs = inst->rs;
+		fastCode[i].rt = inst->rt;
+		fastCode[i].rd = inst->rd;
+		fastCode[i].i = inst->i;
+	}
+	fastCode[prog->count].handler = &&op_end;
+
+	//writes to $zero are discarded by clearing it again after each result
+#define DISPATCH() do { retired++; goto *op->handler; } while (0)
+#define NEXT() do { op++; DISPATCH(); } while (0)
+#define WRITE_RD(value) do { regs[op->rd] = (value); regs[0] = 0; } while (0)
+	//a superinstruction's second half: no dispatch, its handler is known
+#define FUSE(handler) do { op++; retired++; goto handler; } while (0)
+
+#define EXEC_ADD() \
+	WRITE_RD((int32_t) ((uint32_t) regs[op->rs] + (uint32_t) regs[op->rt]))
+#define EXEC_ADDI() \
+	WRITE_RD((int32_t) ((uint32_t) regs[op->rs] + (uint32_t) op->i))
+#define EXEC_SUB() \
+	WRITE_RD((int32_t) ((uint32_t) regs[op->rs] - (uint32_t) regs[op->rt]))
+#define EXEC_AND() WRITE_RD(regs[op->rs] & regs[op->rt])
+#define EXEC_OR() WRITE_RD(regs[op->rs] | regs[op->rt])
+#define EXEC_MUL() \
+	WRITE_RD((int32_t) ((uint32_t) regs[op->rs] * (uint32_t) regs[op->rt]))
+#define EXEC_LUI() WRITE_RD((int32_t) ((uint32_t) op->i << 16))
+#define EXEC_ORI() WRITE_RD(regs[op->rs] | (uint16_t) op->i)
+#define EXEC_SLT() WRITE_RD(regs[op->rs] < regs[op->rt])
+#define EXEC_SLTI() WRITE_RD(regs[op->rs] < op->i)
+#define EXEC_LW() do { \
+	if (op->i % 4 != 0) \
+		goto misaligned; \
+	addr = regs[op->rs] + op->i / 4; \
+	WRITE_RD(memRead(&m->memory, addr)); \
+} while (0)
+#define EXEC_SW() do { \
+	if (op->i % 4 != 0) \
+		goto misaligned; \
+	addr = regs[op->rs] + op->i / 4; \
+	memWrite(&m->memory, addr, regs[op->rt]); \
+} while (0)
+	//every taken branch and jump lands on the start of a block
+#define EXEC_BRANCH(taken) do { \
+	if (taken) { \
+		op += op->i; \
+		if (op - fastCode >= prog->count - 1 || op - fastCode + 1 < 0) { \
+			target = op - fastCode + 1; \
+			goto outside; \
+		} \
+	} \
+	if (j != NULL) { /* a block starts here */ \
+		op = &fastCode[runTranslated(j, m, op - fastCode + 1)]; \
+		DISPATCH(); \
+	} \
+	NEXT(); \
+} while (0)
+#define EXEC_JUMP(to) do { \
+	target = (to); \
+	if (target < 0 || target >= prog->count) \
+		goto outside; \
+	op = &fastCode[j != NULL ? runTranslated(j, m, target) : target]; \
+	DISPATCH(); \
+} while (0)
+
+	op = &fastCode[j != NULL ? runTranslated(j, m, m->pc) : m->pc];
+	DISPATCH();
+
+	op_add:
+	EXEC_ADD();
+	NEXT();
+	op_addi:
+	EXEC_ADDI();
+	NEXT();
+	op_sub:
+	EXEC_SUB();
+	NEXT();
+	op_and:
+	EXEC_AND();
+	NEXT();
+	op_or:
+	EXEC_OR();
+	NEXT();
+	op_mul:
+	EXEC_MUL();
+	NEXT();
+	op_lui:
+	EXEC_LUI();
+	NEXT();
+	op_ori:
+	EXEC_ORI();
+	NEXT();
+	op_slt:
+	EXEC_SLT();
+	NEXT();
+	op_slti:
+	EXEC_SLTI();
+	NEXT();
+	op_beq:
+	EXEC_BRANCH(regs[op->rs] == regs[op->rt]);
+	op_bne:
+	EXEC_BRANCH(regs[op->rs] != regs[op->rt]);
+	op_j:
+	EXEC_JUMP(op->i);
+	op_jal:
+	WRITE_RD(op - fastCode + 1);
+	EXEC_JUMP(op->i);
+	op_jr:
+	EXEC_JUMP(regs[op->rs]);
+	op_lw:
+	EXEC_LW();
+	NEXT();
+	op_sw:
+	EXEC_SW();
+	NEXT();
+	op_alu:
+	inst = &prog->instructions[op - fastCode];
+	WRITE_RD(opTable[inst->op].execute(regs[op->rs], regs[op->rt], op->i));
+	NEXT();
+	op_load:
+	inst = &prog->instructions[op - fastCode];
+	if (!isAligned(inst))
+		goto misaligned;
+	WRITE_RD(loadValue(inst,
+			memRead(&m->memory, wordAddress(inst, regs[op->rs]))));
+	NEXT();
+	op_store:
+	inst = &prog->instructions[op - fastCode];
+	if (!isAligned(inst))
+		goto misaligned;
+	addr = wordAddress(inst, regs[op->rs]);
+	memWrite(&m->memory, addr, storeValue(inst, opTable[inst->op].size < 4 ?
+			memRead(&m->memory, addr) : 0, regs[op->rt]));
+	if (opTable[inst->op].roles & WRITES_RD)
+		WRITE_RD(1); //sc always succeeds
+	NEXT();
+
+	op_addi_beq:
+	EXEC_ADDI();
+	FUSE(op_beq);
+	op_addi_lw:
+	EXEC_ADDI();
+	FUSE(op_lw);
+	op_addi_sw:
+	EXEC_ADDI();
+	FUSE(op_sw);
+	op_addi_addi:
+	EXEC_ADDI();
+	FUSE(op_addi);
+	op_addi_add:
+	EXEC_ADDI();
+	FUSE(op_add);
+	op_addi_bne:
+	EXEC_ADDI();
+	FUSE(op_bne);
+	op_add_beq:
+	EXEC_ADD();
+	FUSE(op_beq);
+	op_add_add:
+	EXEC_ADD();
+	FUSE(op_add);
+	op_add_addi:
+	EXEC_ADD();
+	FUSE(op_addi);
+	op_add_lw:
+	EXEC_ADD();
+	FUSE(op_lw);
+	op_sub_and:
+	EXEC_SUB();
+	FUSE(op_and);
+	op_sub_beq:
+	EXEC_SUB();
+	FUSE(op_beq);
+	op_and_beq:
+	EXEC_AND();
+	FUSE(op_beq);
+	op_mul_add:
+	EXEC_MUL();
+	FUSE(op_add);
+	op_lui_ori:
+	EXEC_LUI();
+	FUSE(op_ori);
+	op_slt_beq:
+	EXEC_SLT();
+	FUSE(op_beq);
+	op_slt_bne:
+	EXEC_SLT();
+	FUSE(op_bne);
+	op_slti_beq:
+	EXEC_SLTI();
+	FUSE(op_beq);
+	op_slti_bne:
+	EXEC_SLTI();
+	FUSE(op_bne);
+	op_lw_lw:
+	EXEC_LW();
+	FUSE(op_lw);
+	op_lw_add:
+	EXEC_LW();
+	FUSE(op_add);
+	op_lw_sub:
+	EXEC_LW();
+	FUSE(op_sub);
+	op_lw_mul:
+	EXEC_LW();
+	FUSE(op_mul);
+	op_lw_sw:
+	EXEC_LW();
+	FUSE(op_sw);
+	op_lw_beq:
+	EXEC_LW();
+	FUSE(op_beq);
+	op_sw_sw:
+	EXEC_SW();
+	FUSE(op_sw);
+	op_sw_addi:
+	EXEC_SW();
+	FUSE(op_addi);
+
+	op_bubble:
+	retired--; //a bubble does no work
+	NEXT();
+	op_halt:
+	retired--; //nor does the halt itself
+	m->pc = op - fastCode;
+	m->jitBlocks = 0;
+	if (j != NULL) {
+		retired += j->retired;
+		m->jitBlocks = j->translated;
+		closeJit(j);
+	}
+	m->retiredInstructions += retired;
+	free(fastCode);
+	return;
+
+	op_end:
+	printf("\n>>>ERROR!\n******Ran past the end of the program, pc: * %d *"
+			"\n\tFrom: functional.h @ line %d\n", prog->count, __LINE__);
+	exit(1);
+	outside:
+	printf("\n>>>ERROR!\n******Branched beyond program boundaries,"
+			" pc: * %d * and instructions: * %d *\n\tFrom: functional.h"
+			" @ line %d\n", target, prog->count, __LINE__);
+	exit(1);
+	misaligned:
+	printf("\n>>>ERROR!\n******Memory Misaligned/Access,"
+			"\n\tFrom: functional.h @ line %d\n", __LINE__);
+	exit(1);
+	op_unrecognized:
+	printf("\n>>>ERROR!\n******Unrecognized Operation,"
+			"\n\tFrom: functional.h @ line %d\n", __LINE__);
+	exit(1);
+
+#undef DISPATCH
+#undef NEXT
+#undef WRITE_RD
+#undef FUSE
+#undef EXEC_ADD
+#undef EXEC_ADDI
+#undef EXEC_SUB
+#undef EXEC_AND
+#undef EXEC_OR
+#undef EXEC_MUL
+#undef EXEC_LW
+#undef EXEC_SW
+#undef EXEC_BRANCH
+#undef EXEC_JUMP
+} //end function runFunctional()
+
+#endif /* FUNCTIONAL_H_ */
@@ -29,6 +29,19 @@
 //#define J 0b000010			//J     => 2
 //#define BEQ 0b000100		//BEQ   => 4
 //#define MOVE 0b000110		//MOVE  => 6
+#define EX_CLOCK_WAIT 10 //cycles the ALU takes for most operations
+#define MUL_CLOCK_WAIT 15 //cycles the ALU takes to multiply
+#define DIV_CLOCK_WAIT 40 //cycles the ALU takes to divide
+//functional unit classes, as the out-of-order core groups its stations
+#define UNIT_ALU 0
+#define UNIT_MUL 1 //multiplies and divides
+#define UNIT_MEM 2 //loads and stores
+#define UNIT_CLASSES 3
+//operand roles in 'opTable'
+#define READS_RS 1
+#define READS_RT 2
+#define WRITES_RD 4
+#define ZERO_EXTENDS 8 //its immediate is unsigned, 0 to 65535
 /******************************************************************************
  * Global Vars and Structs
  */
@@ -58,15 +71,58 @@ typedef enum _instruction_type {
 	R, I, B, JType
 } instr_type;
 
+//how the operands of an instruction are written in assembly
+typedef enum _operand_shape {
+	OPS_NONE,			//halt
+	OPS_RD_RS_RT,		//add $d, $s, $t
+	OPS_RD_RT_SHAMT,	//sll $d, $t, h
+	OPS_RS,				//jr $s
+	OPS_RT_RS_IMM,		//addi $t, $s, imm
+	OPS_RT_IMM,			//lui $t, imm
+	OPS_RS_RT_OFFSET,	//beq $s, $t, offset
+	OPS_RT_OFFSET_BASE,	//lw $t, offset($s)
+	OPS_TARGET			//j target
+} operand_shape;
 
-typedef struct instruction_tag {
+//what an instruction does with its operands
+typedef enum _op_kind {
+	DOES_NOTHING,	//bubble and halt
+	DOES_ALU,		//rd = execute(rs, rt, i)
+	DOES_LOAD,		//rd = the memory at rs + i
+	DOES_STORE,		//the memory at rs + i = rt, and sc sets rd to 1
+	DOES_BRANCH,	//to pc + 1 + i when execute(rs, rt, i) is not 0
+	DOES_JUMP		//to the target i, or rs for jr; jal links pc + 1 in rd
+} op_kind;
+
+//an ALU result, or whether a branch is taken, from the rs and rt values and
+//the immediate
+typedef int32_t (*alu_handler)(int32_t, int32_t, int32_t);
+
+//everything the assembler and the engines need to know about an opcode
+typedef struct op_info_tag {
+	const char *name;
 	instr_type type;
-	opcode op;
+	operand_shape shape;
+	op_kind kind;
+	uint8_t roles; //READS_RS, READS_RT, WRITES_RD and ZERO_EXTENDS
+	int8_t unit; //UNIT_ALU, UNIT_MUL or UNIT_MEM
+	int8_t latency; //cycles in EX
+	int8_t size; //bytes a load or store moves
+	alu_handler execute;
+} op_info;
+
+
+/*
+ * A decoded instruction, packed into 8 bytes so a cache line holds eight of
+ * them and a latch moves one in a single word. Its type and whether it is
+ * the halt come from 'opTable', see instrType() and isHalt().
+ */
+typedef struct instruction_tag {
+	uint8_t op; //an opcode
 	int8_t rs;
 	int8_t rt;
 	int8_t rd;
 	int32_t i;
-	bool isHalt;
 } instr;
 
 struct {
@@ -85,25 +141,360 @@ struct {
 		{ "fp", "11110" }, { "ra", "11111" }, { "\0", 0 } };
 		//last tuple represents null terminator to mark the end
 
-instr instructions[512];
-int32_t pc = 0;
-int32_t haltIndex = 0;
+/*
+ * Perfect hash tables for the assembler: every mnemonic, and every register
+ * name with or without its numeric $0-$31 form, lands in its own slot of
+ * hashName(name, seed) % size. A lookup is one hash and one strcmp.
+ * The seeds were found by trying seeds in order until none of the keys
+ * collided, so adding a key means searching for a new seed.
+ */
+#define MNEMONIC_SEED 1643204u
+#define MNEMONIC_SLOTS 64
+#define REGISTER_SEED 106368220u
+#define REGISTER_SLOTS 128
+#define SYMBOL_SEED 2166136261u
+#define MAX_LABEL_LENGTH 128
+
+typedef struct mnemonic_tag {
+	const char *name;
+	opcode op;
+} mnemonic;
+
+//a piece of a source line, pointing straight into the line buffer
+typedef struct token_tag {
+	const char *start;
+	int length;
+} token;
+
+//one tokenized source line: opcode, up to 3 operands and a base register
+typedef struct asm_line_tag {
+	token opcode;
+	token operands[3];
+	int8_t operandCount;
+	token base; //the register inside offset($base), length 0 if none
+	const char *end; //one past the last character of the instruction
+} asm_line;
+
+typedef struct reg_name_tag {
+	const char *name;
+	int8_t index;
+} reg_name;
+
+const mnemonic mnemonicTable[MNEMONIC_SLOTS] = {
+		[0] = { "beq", BEQ },
+		[1] = { "j", J },
+		[3] = { "mulu", MULU },
+		[5] = { "jal", JAL },
+		[6] = { "addi", ADDI },
+		[7] = { "divu", DIVU },
+		[8] = { "sub", SUB },
+		[9] = { "jr", JR },
+		[11] = { "ori", ORI },
+		[14] = { "bubble", BUBBLE },
+		[15] = { "sltiu", SLTIU },
+		[16] = { "sh", SH },
+		[17] = { "bne", BNE },
+		[20] = { "add", ADD },
+		[21] = { "sw", SW },
+		[23] = { "sb", SB },
+		[24] = { "or", OR },
+		[25] = { "sll", SLL },
+		[26] = { "mul", MUL },
+		[28] = { "addu", ADDU },
+		[29] = { "andi", ANDI },
+		[30] = { "ll", LL },
+		[34] = { "halt", HALT },
+		[35] = { "sc", SC },
+		[38] = { "div", DIV },
+		[41] = { "srl", SRL },
+		[42] = { "lbu", LBU },
+		[43] = { "addiu", ADDIU },
+		[46] = { "subu", SUBU },
+		[47] = { "nor", NOR },
+		[49] = { "lw", LW },
+		[50] = { "lui", LUI },
+		[51] = { "lhu", LHU },
+		[52] = { "slt", SLT },
+		[55] = { "sltu", SLTU },
+		[56] = { "and", AND },
+		[63] = { "slti", SLTI }
+};
+
+const reg_name registerTable[REGISTER_SLOTS] = {
+		[0] = { "t4", 12 }, [3] = { "14", 14 }, [7] = { "s0", 16 },
+		[8] = { "t2", 10 }, [10] = { "28", 28 }, [11] = { "30", 30 },
+		[13] = { "17", 17 }, [14] = { "20", 20 }, [16] = { "s4", 20 },
+		[17] = { "s7", 23 }, [19] = { "23", 23 }, [20] = { "1", 1 },
+		[22] = { "a3", 7 }, [25] = { "t1", 9 }, [28] = { "8", 8 },
+		[30] = { "13", 13 }, [31] = { "t9", 25 }, [32] = { "zero", 0 },
+		[33] = { "29", 29 }, [36] = { "19", 19 }, [37] = { "7", 7 },
+		[38] = { "16", 16 }, [39] = { "v0", 2 }, [41] = { "0", 0 },
+		[43] = { "2", 2 }, [44] = { "s2", 18 }, [48] = { "t8", 24 },
+		[50] = { "22", 22 }, [52] = { "25", 25 }, [56] = { "t0", 8 },
+		[57] = { "15", 15 }, [59] = { "4", 4 }, [61] = { "s3", 19 },
+		[64] = { "31", 31 }, [65] = { "27", 27 }, [68] = { "at", 1 },
+		[69] = { "s6", 22 }, [71] = { "11", 11 }, [72] = { "26", 26 },
+		[74] = { "v1", 3 }, [75] = { "k0", 26 }, [77] = { "9", 9 },
+		[78] = { "s5", 21 }, [80] = { "t5", 13 }, [85] = { "21", 21 },
+		[87] = { "10", 10 }, [88] = { "5", 5 }, [90] = { "a2", 6 },
+		[91] = { "6", 6 }, [93] = { "k1", 27 }, [98] = { "18", 18 },
+		[101] = { "t3", 11 }, [103] = { "24", 24 }, [104] = { "12", 12 },
+		[105] = { "s1", 17 }, [107] = { "s8", 30 }, [112] = { "gp", 28 },
+		[115] = { "ra", 31 }, [116] = { "a1", 5 }, [119] = { "3", 3 },
+		[123] = { "t6", 14 }, [124] = { "a0", 4 }, [125] = { "sp", 29 },
+		[126] = { "fp", 30 }, [127] = { "t7", 15 } };
+
+/*
+ * A decoded program, grown as it is assembled or loaded. Machines only read
+ * it, so any number of them can run the same program at once.
+ */
+typedef struct program_tag {
+	instr *instructions;
+	int32_t count;
+	int32_t capacity;
+	int32_t haltIndex; //the last halt; code after it, subroutines, runs too
+	int32_t entry; //instruction index execution starts at
+	//initial RAM contents, copied into every machine running the program
+	int32_t *data;
+	uint32_t dataAddr;
+	uint32_t dataCount;
+	int32_t dataCapacity;
+} program;
+
+//how the value of a label operand goes into what uses it
+typedef enum _fixup_kind {
+	FIX_BRANCH,		//beq offset: from the next instruction to the label
+	FIX_IMMEDIATE,	//addi immediate: the label's value
+	FIX_OFFSET,		//lw/sw offset: the label's word address, in bytes
+	FIX_TARGET,		//j/jal target: the label's instruction index
+	FIX_HIGH,		//la's lui immediate: the label's value, upper half
+	FIX_LOW,		//la's ori immediate: the label's value, lower half
+	FIX_WORD		//.word: the label's value, in the data section
+} fixup_kind;
+
+typedef struct symbol_tag {
+	char *name;
+	int32_t value; //instruction index, or word address of a data label
+	int32_t line; //source line defined on, or first used on until then
+	bool defined;
+	bool isData;
+} symbol;
+
+//a label operand to fill in once every label is known
+typedef struct fixup_tag {
+	fixup_kind kind;
+	int32_t symbol; //index into 'symbols'
+	int32_t at; //instruction index, or data word for FIX_WORD
+	int32_t line;
+} fixup;
+
+/*
+ * The labels of the program being assembled. Their names are only known as
+ * the source is read, so unlike the tables above this is an open addressing
+ * table with linear probing, grown to stay at most half full. Its slots
+ * index 'symbols', which holds the labels in the order first seen. A label
+ * used before its definition goes in undefined, and every label operand
+ * leaves a fixup behind, so the file is read once and patched at the end.
+ */
+typedef struct symbol_table_tag {
+	symbol *symbols;
+	int32_t count;
+	int32_t capacity;
+	int32_t *slots; //-1 for a free slot
+	int32_t slotCount; //a power of 2
+	fixup *fixups;
+	int32_t fixupCount;
+	int32_t fixupCapacity;
+	int32_t line; //source line being assembled, for errors
+} symbol_table;
+
+/*
+ * Machine code fields for every opcode, following the layouts sketched in
+ * displayBits() in projmain.c. R types live under the SPECIAL (0) primary
+ * opcode and are told apart by 'funct'; I and J types only use 'primary'.
+ * MUL is the MIPS32 SPECIAL2 (0x1c) three operand form. MULU, DIV and DIVU
+ * have no HI/LO registers in this simulator, so their rd is kept in the
+ * usual rd field. HALT borrows the 'break' funct and a bubble is the nop.
+ */
+struct {
+	uint8_t primary;
+	uint8_t funct;
+} opcodeBits[] = {
+		[ADD] = { 0x00, 0x20 }, [ADDI] = { 0x08, 0 }, [ADDIU] = { 0x09, 0 },
+		[ADDU] = { 0x00, 0x21 }, [AND] = { 0x00, 0x24 }, [ANDI] = { 0x0c, 0 },
+		[BEQ] = { 0x04, 0 }, [BNE] = { 0x05, 0 }, [J] = { 0x02, 0 },
+		[JAL] = { 0x03, 0 }, [JR] = { 0x00, 0x08 }, [LBU] = { 0x24, 0 },
+		[LHU] = { 0x25, 0 }, [LL] = { 0x30, 0 }, [LUI] = { 0x0f, 0 },
+		[LW] = { 0x23, 0 }, [NOR] = { 0x00, 0x27 }, [OR] = { 0x00, 0x25 },
+		[ORI] = { 0x0d, 0 }, [SLT] = { 0x00, 0x2a }, [SLTI] = { 0x0a, 0 },
+		[SLTIU] = { 0x0b, 0 }, [SLTU] = { 0x00, 0x2b }, [SLL] = { 0x00, 0x00 },
+		[SRL] = { 0x00, 0x02 }, [SB] = { 0x28, 0 }, [SC] = { 0x38, 0 },
+		[SH] = { 0x29, 0 }, [SW] = { 0x2b, 0 }, [MUL] = { 0x1c, 0x02 },
+		[MULU] = { 0x00, 0x19 }, [SUB] = { 0x00, 0x22 }, [SUBU] = { 0x00, 0x23 },
+		[DIV] = { 0x00, 0x1a }, [DIVU] = { 0x00, 0x1b }, [BUBBLE] = { 0x00, 0 },
+		[HALT] = { 0x00, 0x0d } };
+
+//operands written in assembly, by operand shape
+const int8_t shapeOperands[] = { [OPS_NONE] = 0, [OPS_RD_RS_RT] = 3,
+		[OPS_RD_RT_SHAMT] = 3, [OPS_RS] = 1, [OPS_RT_RS_IMM] = 3,
+		[OPS_RT_IMM] = 2, [OPS_RS_RT_OFFSET] = 3, [OPS_RT_OFFSET_BASE] = 2,
+		[OPS_TARGET] = 1 };
+
+/*
+ * The execute handlers of 'opTable'. Everything wraps around like the
+ * unsigned ops do: no instruction traps on overflow. Dividing by zero gives
+ * 0, and the one signed quotient that does not fit, INT32_MIN / -1, wraps
+ * to INT32_MIN.
+ */
+#define ALU_HANDLER(name, result) \
+	int32_t name(int32_t s, int32_t t, int32_t i) { return (result); }
+ALU_HANDLER(aluAdd, (uint32_t) s + (uint32_t) t)
+ALU_HANDLER(aluAddImm, (uint32_t) s + (uint32_t) i)
+ALU_HANDLER(aluSub, (uint32_t) s - (uint32_t) t)
+ALU_HANDLER(aluAnd, s & t)
+ALU_HANDLER(aluAndImm, s & (uint16_t) i)
+ALU_HANDLER(aluOr, s | t)
+ALU_HANDLER(aluOrImm, s | (uint16_t) i)
+ALU_HANDLER(aluNor, ~(s | t))
+ALU_HANDLER(aluSlt, s < t)
+ALU_HANDLER(aluSltImm, s < i)
+ALU_HANDLER(aluSltu, (uint32_t) s < (uint32_t) t)
+ALU_HANDLER(aluSltuImm, (uint32_t) s < (uint32_t) i)
+ALU_HANDLER(aluSll, (uint32_t) t << (i & 0x1f))
+ALU_HANDLER(aluSrl, (uint32_t) t >> (i & 0x1f))
+ALU_HANDLER(aluLui, (uint32_t) i << 16)
+ALU_HANDLER(aluMul, (uint32_t) s * (uint32_t) t)
+ALU_HANDLER(aluDiv, t == 0 ? 0 : t == -1 ? 0u - (uint32_t) s : s / t)
+ALU_HANDLER(aluDivu, t == 0 ? 0 : (uint32_t) s / (uint32_t) t)
+ALU_HANDLER(branchEqual, s == t)
+ALU_HANDLER(branchNotEqual, s != t)
+#undef ALU_HANDLER
+
+/*
+ * One entry per opcode: how it is written, which registers it reads and
+ * writes, the unit and EX cycles it takes and what it computes. The
+ * assembler, the hazard checks and every engine go by this table, so a new
+ * instruction is one more entry here (and in 'mnemonicTable' and
+ * 'opcodeBits'). Loads and stores address bytes at rs * 4 + i, rs being a
+ * word address as everywhere in RAM; halfwords and words must be aligned.
+ */
+#define ROLES_R (READS_RS | READS_RT | WRITES_RD)
+#define ROLES_I (READS_RS | WRITES_RD)
+const op_info opTable[] = {
+		[ADD] = { "add", R, OPS_RD_RS_RT, DOES_ALU, ROLES_R, UNIT_ALU,
+				EX_CLOCK_WAIT, 0, aluAdd },
+		[ADDI] = { "addi", I, OPS_RT_RS_IMM, DOES_ALU, ROLES_I, UNIT_ALU,
+				EX_CLOCK_WAIT, 0, aluAddImm },
+		[ADDIU] = { "addiu", I, OPS_RT_RS_IMM, DOES_ALU, ROLES_I, UNIT_ALU,
+				EX_CLOCK_WAIT, 0, aluAddImm },
+		[ADDU] = { "addu", R, OPS_RD_RS_RT, DOES_ALU, ROLES_R, UNIT_ALU,
+				EX_CLOCK_WAIT, 0, aluAdd },
+		[AND] = { "and", R, OPS_RD_RS_RT, DOES_ALU, ROLES_R, UNIT_ALU,
+				EX_CLOCK_WAIT, 0, aluAnd },
+		[ANDI] = { "andi", I, OPS_RT_RS_IMM, DOES_ALU, ROLES_I | ZERO_EXTENDS,
+				UNIT_ALU, EX_CLOCK_WAIT, 0, aluAndImm },
+		[BEQ] = { "beq", I, OPS_RS_RT_OFFSET, DOES_BRANCH, READS_RS | READS_RT,
+				UNIT_ALU, EX_CLOCK_WAIT, 0, branchEqual },
+		[BNE] = { "bne", I, OPS_RS_RT_OFFSET, DOES_BRANCH, READS_RS | READS_RT,
+				UNIT_ALU, EX_CLOCK_WAIT, 0, branchNotEqual },
+		[J] = { "j", JType, OPS_TARGET, DOES_JUMP, 0, UNIT_ALU,
+				EX_CLOCK_WAIT, 0, NULL },
+		[JAL] = { "jal", JType, OPS_TARGET, DOES_JUMP, WRITES_RD, UNIT_ALU,
+				EX_CLOCK_WAIT, 0, NULL },
+		[JR] = { "jr", R, OPS_RS, DOES_JUMP, READS_RS, UNIT_ALU,
+				EX_CLOCK_WAIT, 0, NULL },
+		[LBU] = { "lbu", I, OPS_RT_OFFSET_BASE, DOES_LOAD, ROLES_I, UNIT_MEM,
+				EX_CLOCK_WAIT, 1, NULL },
+		[LHU] = { "lhu", I, OPS_RT_OFFSET_BASE, DOES_LOAD, ROLES_I, UNIT_MEM,
+				EX_CLOCK_WAIT, 2, NULL },
+		[LL] = { "ll", I, OPS_RT_OFFSET_BASE, DOES_LOAD, ROLES_I, UNIT_MEM,
+				EX_CLOCK_WAIT, 4, NULL },
+		[LUI] = { "lui", I, OPS_RT_IMM, DOES_ALU, WRITES_RD | ZERO_EXTENDS,
+				UNIT_ALU, EX_CLOCK_WAIT, 0, aluLui },
+		[LW] = { "lw", I, OPS_RT_OFFSET_BASE, DOES_LOAD, ROLES_I, UNIT_MEM,
+				EX_CLOCK_WAIT, 4, NULL },
+		[NOR] = { "nor", R, OPS_RD_RS_RT, DOES_ALU, ROLES_R, UNIT_ALU,
+				EX_CLOCK_WAIT, 0, aluNor },
+		[OR] = { "or", R, OPS_RD_RS_RT, DOES_ALU, ROLES_R, UNIT_ALU,
+				EX_CLOCK_WAIT, 0, aluOr },
+		[ORI] = { "ori", I, OPS_RT_RS_IMM, DOES_ALU, ROLES_I | ZERO_EXTENDS,
+				UNIT_ALU, EX_CLOCK_WAIT, 0, aluOrImm },
+		[SLT] = { "slt", R, OPS_RD_RS_RT, DOES_ALU, ROLES_R, UNIT_ALU,
+				EX_CLOCK_WAIT, 0, aluSlt },
+		[SLTI] = { "slti", I, OPS_RT_RS_IMM, DOES_ALU, ROLES_I, UNIT_ALU,
+				EX_CLOCK_WAIT, 0, aluSltImm },
+		[SLTIU] = { "sltiu", I, OPS_RT_RS_IMM, DOES_ALU, ROLES_I, UNIT_ALU,
+				EX_CLOCK_WAIT, 0, aluSltuImm },
+		[SLTU] = { "sltu", R, OPS_RD_RS_RT, DOES_ALU, ROLES_R, UNIT_ALU,
+				EX_CLOCK_WAIT, 0, aluSltu },
+		[SLL] = { "sll", R, OPS_RD_RT_SHAMT, DOES_ALU, READS_RT | WRITES_RD,
+				UNIT_ALU, EX_CLOCK_WAIT, 0, aluSll },
+		[SRL] = { "srl", R, OPS_RD_RT_SHAMT, DOES_ALU, READS_RT | WRITES_RD,
+				UNIT_ALU, EX_CLOCK_WAIT, 0, aluSrl },
+		[SB] = { "sb", I, OPS_RT_OFFSET_BASE, DOES_STORE, READS_RS | READS_RT,
+				UNIT_MEM, EX_CLOCK_WAIT, 1, NULL },
+		[SC] = { "sc", I, OPS_RT_OFFSET_BASE, DOES_STORE, ROLES_R, UNIT_MEM,
+				EX_CLOCK_WAIT, 4, NULL },
+		[SH] = { "sh", I, OPS_RT_OFFSET_BASE, DOES_STORE, READS_RS | READS_RT,
+				UNIT_MEM, EX_CLOCK_WAIT, 2, NULL },
+		[SW] = { "sw", I, OPS_RT_OFFSET_BASE, DOES_STORE, READS_RS | READS_RT,
+				UNIT_MEM, EX_CLOCK_WAIT, 4, NULL },
+		[MUL] = { "mul", R, OPS_RD_RS_RT, DOES_ALU, ROLES_R, UNIT_MUL,
+				MUL_CLOCK_WAIT, 0, aluMul },
+		[MULU] = { "mulu", R, OPS_RD_RS_RT, DOES_ALU, ROLES_R, UNIT_MUL,
+				MUL_CLOCK_WAIT, 0, aluMul },
+		[SUB] = { "sub", R, OPS_RD_RS_RT, DOES_ALU, ROLES_R, UNIT_ALU,
+				EX_CLOCK_WAIT, 0, aluSub },
+		[SUBU] = { "subu", R, OPS_RD_RS_RT, DOES_ALU, ROLES_R, UNIT_ALU,
+				EX_CLOCK_WAIT, 0, aluSub },
+		[DIV] = { "div", R, OPS_RD_RS_RT, DOES_ALU, ROLES_R, UNIT_MUL,
+				DIV_CLOCK_WAIT, 0, aluDiv },
+		[DIVU] = { "divu", R, OPS_RD_RS_RT, DOES_ALU, ROLES_R, UNIT_MUL,
+				DIV_CLOCK_WAIT, 0, aluDivu },
+		[BUBBLE] = { "bubble", B, OPS_NONE, DOES_NOTHING, 0, UNIT_ALU,
+				EX_CLOCK_WAIT, 0, NULL },
+		[HALT] = { "halt", B, OPS_NONE, DOES_NOTHING, 0, UNIT_ALU,
+				EX_CLOCK_WAIT, 0, NULL } };
+#undef ROLES_R
+#undef ROLES_I
 /******************************************************************************
  * Function Prototypes
  */
 
-void parseInstruction(char*, FILE*);
-void trimInstruction(char*);
-bool isAValidCharacter(char);
-bool isAValidReg(char);
-char* extractOpcode(char*);
-int extractRegister(char*, int);
-int extractImmediate(char*, int);
-int extractBase(char*);
-opcode stringToOpcode(char*);
-bool isRType(char* opcode);
-bool isIType(char* opcode);
+void parseInstruction(program*, symbol_table*, char*, bool);
+void parseLoadAddress(program*, symbol_table*, const asm_line*);
+bool tokenizeLine(const char*, asm_line*);
+void syntaxError(const char*, int);
+int extractRegister(token);
+int32_t extractImmediate(token);
+bool fitsField(const instr*, int32_t);
 int regValue(char*);
+uint32_t hashName(const char*, uint32_t);
+const mnemonic* lookupMnemonic(const char*);
+const char* opcodeName(opcode);
+const reg_name* lookupRegister(const char*);
+instr_type instrType(const instr*);
+bool isHalt(const instr*);
+bool isBType(const instr*);
+bool isMemoryAccess(const instr*);
+bool isControl(const instr*);
+bool resultFromMemory(const instr*);
+int32_t controlTarget(const instr*, int32_t, int32_t, int32_t);
+bool isAligned(const instr*);
+uint32_t wordAddress(const instr*, int32_t);
+int32_t loadValue(const instr*, int32_t);
+int32_t storeValue(const instr*, int32_t, int32_t);
+uint32_t encodeInstruction(instr*);
+void reserveInstructions(program*, int32_t);
+void freeProgram(program*);
+instr decodeInstruction(uint32_t);
+int32_t immediateOperand(program*, symbol_table*, token, fixup_kind);
+bool isLabel(token);
+int32_t lookupSymbol(symbol_table*, token);
+void defineSymbol(symbol_table*, token, int32_t, bool);
+void addFixup(symbol_table*, fixup_kind, token, int32_t);
+void freeSymbols(symbol_table*);
+void* growArray(void*, int32_t*, int32_t, size_t);
 
 /******************************************************************************
  * Functions
@@ -111,173 +502,495 @@ int regValue(char*);
 
 /**
  * After parsing the .asm file in the fileparser.h function, each line
- * instruction is sent here for parsing into MIPS instructions.
+ * instruction is sent here for parsing into MIPS instructions. Label
+ * operands are left for fixups in 'symbols'. With 'echo' set the line is
+ * also printed.
  */
-void parseInstruction(char *instr, FILE *outFile) {
+void parseInstruction(program *prog, symbol_table *symbols, char *source,
+		bool echo) {
 
-	char *ignore = "#"; //check for comments
-	char *c = instr; //store copy of the instruction string
-	while (*c) { //iterate through string checking each char
-		if (strchr(ignore, *c))
-			return; //if comment found, do not parse this line!
-		c++;
-	}
+	asm_line line;
+	char opcode[8];
 
-	trimInstruction(instr);
-
-	printf("\t%s\n", instr);
-	char* opcode = extractOpcode(instr);
-
-	if (isRType(opcode)) {
-		int rs = extractRegister(instr, 1);
-		int rt = extractRegister(instr, 2);
-		int rd = extractRegister(instr, 0);
-		instructions[pc].type = R;
-		instructions[pc].op = stringToOpcode(opcode);
-		instructions[pc].rs = rs;
-		instructions[pc].rt = rt;
-		instructions[pc].rd = rd;
-		instructions[pc].i = -1;
-		instructions[pc].isHalt = false;
-	} else if (isIType(opcode)) {
-		int rs, imm;
-		int rt = extractRegister(instr, 0);
-		if (strcmp(opcode, "lw") != 0 && strcmp(opcode, "sw") != 0) {
-			rs = extractRegister(instr, 1);
-			imm = extractImmediate(instr, 2);
-		} else { //opcode is lw or sw
-			rs = extractBase(instr);
-			imm = extractImmediate(instr, 1);
-		}
-		instructions[pc].type = I;
-		instructions[pc].op = stringToOpcode(opcode);
-		instructions[pc].rs = rs;
-		instructions[pc].rt = rt;
-		instructions[pc].rd = rt;
-		instructions[pc].i = imm;
-		instructions[pc].isHalt = false;
-	} else if (strcmp(opcode, "halt") == 0) {
-		instructions[pc].type = B;
-		instructions[pc].op = HALT;
-		instructions[pc].rs = -1;
-		instructions[pc].rt = -1;
-		instructions[pc].rd = -1;
-		instructions[pc].i = -1;
-		instructions[pc].isHalt = true;
-		haltIndex = pc;
-	} else {
+	if (!tokenizeLine(source, &line))
+		return; //blank or comment only line, nothing to assemble
+
+	if (echo)
+		printf("\t%.*s\n", (int) (line.end - line.opcode.start),
+				line.opcode.start);
+	snprintf(opcode, sizeof(opcode), "%.*s", line.opcode.length,
+			line.opcode.start);
+	if (strcmp(opcode, "la") == 0) { //the one pseudo-op, two instructions
+		parseLoadAddress(prog, symbols, &line);
+		return;
+	}
+	const mnemonic *m = lookupMnemonic(opcode);
+	if (m == NULL || line.opcode.length >= (int) sizeof(opcode)) {
 		printf("\n>>>ERROR!\n******Illegal or unimplemented"
-				" opcode: * %s *\n\tFrom: instruction.h @ line 168\n", opcode);
+				" opcode: * %.*s *\n\tFrom: instruction.h @ line %d\n",
+				line.opcode.length, line.opcode.start, __LINE__);
 		exit(1);
 	}
+	const op_info *info = &opTable[m->op];
+
+	//check the operands are written the way this opcode expects
+	if (line.operandCount != shapeOperands[info->shape])
+		syntaxError("Wrong number of operands", __LINE__);
+	if ((line.base.length > 0) != (info->shape == OPS_RT_OFFSET_BASE))
+		syntaxError("Invalid Parentheses", __LINE__);
+
+	//registers an instruction does not name stay 0, as decoding leaves them
+	reserveInstructions(prog, prog->count + 1);
+	instr *inst = &prog->instructions[prog->count];
+	inst->op = m->op;
+	inst->rs = 0;
+	inst->rt = 0;
+	inst->rd = 0;
+	inst->i = -1;
+	switch (info->shape) {
+	case OPS_RD_RS_RT:
+		inst->rs = extractRegister(line.operands[1]);
+		inst->rt = extractRegister(line.operands[2]);
+		inst->rd = extractRegister(line.operands[0]);
+		break;
+	case OPS_RD_RT_SHAMT:
+		inst->rt = extractRegister(line.operands[1]);
+		inst->rd = extractRegister(line.operands[0]);
+		inst->i = extractImmediate(line.operands[2]);
+		if (inst->i < 0 || inst->i > 31)
+			syntaxError("Invalid Shift Amount", __LINE__);
+		break;
+	case OPS_RS:
+		inst->rs = extractRegister(line.operands[0]);
+		break;
+	case OPS_RT_RS_IMM:
+	case OPS_RS_RT_OFFSET:
+		inst->rt = extractRegister(line.operands[0]);
+		inst->rs = extractRegister(line.operands[1]);
+		inst->rd = inst->rt;
+		inst->i = immediateOperand(prog, symbols, line.operands[2],
+				info->shape == OPS_RS_RT_OFFSET ? FIX_BRANCH : FIX_IMMEDIATE);
+		break;
+	case OPS_RT_IMM:
+		inst->rt = extractRegister(line.operands[0]);
+		inst->rd = inst->rt;
+		inst->i = immediateOperand(prog, symbols, line.operands[1],
+				FIX_IMMEDIATE);
+		break;
+	case OPS_RT_OFFSET_BASE:
+		inst->rt = extractRegister(line.operands[0]);
+		inst->rs = extractRegister(line.base);
+		inst->rd = inst->rt;
+		inst->i = immediateOperand(prog, symbols, line.operands[1],
+				FIX_OFFSET);
+		break;
+	case OPS_TARGET:
+		inst->rd = info->roles & WRITES_RD ? 31 : 0; //jal links in $ra
+		inst->i = immediateOperand(prog, symbols, line.operands[0],
+				FIX_TARGET);
+		break;
+	default:
+		if (m->op == BUBBLE) { //the nop
+			inst->i = 0;
+			break;
+		}
+		inst->rs = -1;
+		inst->rt = -1;
+		inst->rd = -1;
+		prog->haltIndex = prog->count;
+		break;
+	}
 
-	pc++;
+	prog->count++;
 }
 
 /**
- * remove spaces or unnecessary characters from each instruction line
+ * 'la $rt, label': load the label's value, the word address of a data label
+ * or the index of an instruction, as a lui of its upper half and an ori of
+ * its lower half. A lw or sw offset only reaches the first 16 KiB of .data
+ * by label; a base register loaded with la reaches any of it.
  */
-void trimInstruction(char* instruction) {
-	int stage = 0; //How many times we've gone from not a space to a space
-	int newIndex = 0;
-	char temp[100];
+void parseLoadAddress(program *prog, symbol_table *symbols,
+		const asm_line *line) {
 	int i;
-	bool lastCharWasSpace = true;
-	for (i = 0; instruction[i] != '\0'; i++) {
-		if (isAValidCharacter(instruction[i])) { //Is alphanumeric or a dollar sign or a comma or a dash or a paren
-			temp[newIndex++] = instruction[i];
-			lastCharWasSpace = false;
-		} else { //Basically is a space
-			if (!lastCharWasSpace) {
-				stage++;
-				if (stage == 1) {
-					temp[newIndex++] = ' ';
-				}
-			}
-			lastCharWasSpace = true;
-		}
+
+	if (line->operandCount != 2)
+		syntaxError("Wrong number of operands", __LINE__);
+	if (line->base.length > 0)
+		syntaxError("Invalid Parentheses", __LINE__);
+	if (!isLabel(line->operands[1]))
+		syntaxError("la takes a label", __LINE__);
+
+	reserveInstructions(prog, prog->count + 2);
+	for (i = 0; i < 2; i++) {
+		instr *inst = &prog->instructions[prog->count];
+		inst->op = i == 0 ? LUI : ORI;
+		inst->rt = extractRegister(line->operands[0]);
+		inst->rs = i == 0 ? 0 : inst->rt;
+		inst->rd = inst->rt;
+		inst->i = 0;
+		addFixup(symbols, i == 0 ? FIX_HIGH : FIX_LOW, line->operands[1],
+				prog->count);
+		prog->count++;
 	}
-	temp[newIndex++] = '\0';
-	strcpy(instruction, temp);
 }
 
 /**
- * Check if the opcode is an R, I, B, or J Type instruction
+ * Make room in 'instructions' for at least 'count' instructions, doubling
+ * the capacity so assembling stays linear in the program size.
  */
-bool isRType(char* opcode) {
-	return strcmp(opcode, "add") == 0 || strcmp(opcode, "sub") == 0
-			|| strcmp(opcode, "and") == 0 || strcmp(opcode, "or") == 0
-			|| strcmp(opcode, "mul") == 0;
+void reserveInstructions(program *prog, int32_t count) {
+	if (count <= prog->capacity)
+		return;
+	int32_t capacity = prog->capacity ? prog->capacity : 512;
+	while (capacity < count)
+		capacity *= 2;
+	instr *grown = realloc(prog->instructions, capacity * sizeof(instr));
+	if (grown == NULL) {
+		printf("\n>>>ERROR!\n******Out of host memory for %d instructions,"
+				"\n\tFrom: instruction.h @ line %d\n", capacity, __LINE__);
+		exit(1);
+	}
+	memset(grown + prog->capacity, 0,
+			(capacity - prog->capacity) * sizeof(instr));
+	prog->instructions = grown;
+	prog->capacity = capacity;
 }
 
 /**
- * Check if the opcode is an R, I, B, or J Type instruction
+ * Give back a program's storage, leaving it empty and ready to reuse.
  */
-bool isIType(char* opcode) {
-	return strcmp(opcode, "addi") == 0 || strcmp(opcode, "lw") == 0
-			|| strcmp(opcode, "sw") == 0 || strcmp(opcode, "beq") == 0;
+void freeProgram(program *prog) {
+	free(prog->instructions);
+	free(prog->data);
+	memset(prog, 0, sizeof(program));
 }
 
 /**
- * built in function 'isalnum' (is alphanumeric)
- * or other various approved chars
+ * Assemble one decoded instruction into its 32-bit MIPS machine code word.
  */
-bool isAValidCharacter(char c) {
-	return isalnum(c) || c == '$' || c == ',' || c == '-' || c == '('
-			|| c == ')';
+uint32_t encodeInstruction(instr *inst) {
+	uint32_t primary = opcodeBits[inst->op].primary;
+	uint32_t funct = opcodeBits[inst->op].funct;
+
+	if (inst->op == BUBBLE)
+		return 0; //nop
+	if (inst->op == HALT)
+		return funct;
+	if (instrType(inst) == JType)
+		return primary << 26 | ((uint32_t) inst->i & 0x03ffffff);
+	if (instrType(inst) == R) {
+		//shift amount only has meaning for the shift ops
+		uint32_t shamt = (inst->op == SLL || inst->op == SRL) ?
+				(uint32_t) inst->i & 0x1f : 0;
+		return primary << 26 | (uint32_t) (inst->rs & 0x1f) << 21
+				| (uint32_t) (inst->rt & 0x1f) << 16
+				| (uint32_t) (inst->rd & 0x1f) << 11 | shamt << 6 | funct;
+	}
+	//I type
+	return primary << 26 | (uint32_t) (inst->rs & 0x1f) << 21
+			| (uint32_t) (inst->rt & 0x1f) << 16
+			| ((uint32_t) inst->i & 0xffff);
 }
 
 /**
- * is alphanumeric?
+ * Disassemble a 32-bit MIPS machine code word back into the same decoded
+ * form that parseInstruction() builds from source text.
  */
-bool isAValidReg(char c) {
-	return isalnum(c) || c == '$';
+instr decodeInstruction(uint32_t word) {
+	instr inst = { BUBBLE, 0, 0, 0, 0 };
+	uint8_t primary = word >> 26;
+	uint8_t funct = word & 0x3f;
+	int op;
+
+	if (word == 0)
+		return inst; //nop
+	if (word == opcodeBits[HALT].funct) {
+		inst.op = HALT;
+		inst.rs = inst.rt = inst.rd = -1;
+		inst.i = -1;
+		return inst;
+	}
+	for (op = ADD; op < BUBBLE; op++) {
+		if (opcodeBits[op].primary != primary)
+			continue;
+		//SPECIAL and SPECIAL2 words also have to match on funct
+		if ((primary == 0x00 || primary == 0x1c)
+				&& opcodeBits[op].funct != funct)
+			continue;
+		break;
+	}
+	if (op == BUBBLE) {
+		printf("\n>>>ERROR!\n******Illegal machine code: * 0x%08x *"
+				"\n\tFrom: instruction.h @ line %d\n", word, __LINE__);
+		exit(1);
+	}
+
+	inst.op = op;
+	inst.rs = (word >> 21) & 0x1f;
+	inst.rt = (word >> 16) & 0x1f;
+	if (primary == 0x00 || primary == 0x1c) {
+		inst.rd = (word >> 11) & 0x1f;
+		inst.i = (op == SLL || op == SRL) ? (word >> 6) & 0x1f : -1;
+	} else if (opTable[op].type == JType) {
+		inst.rs = inst.rt = 0;
+		inst.rd = opTable[op].roles & WRITES_RD ? 31 : 0; //jal links in $ra
+		inst.i = word & 0x03ffffff;
+	} else {
+		inst.rd = inst.rt;
+		inst.i = (int16_t) (word & 0xffff); //sign extend
+	}
+	return inst;
 }
 
 /**
- * take the opcode from instr line and return as string
+ * Split a source line into its opcode and operands in a single pass,
+ * without copying anything: the tokens point into 'text'. Whitespace is
+ * free around commas and parentheses, and '#' starts a comment anywhere.
+ * Returns false for blank and comment only lines.
  */
-char* extractOpcode(char* instr) {
-	char* opcode = (char *) malloc(sizeof(char) * 15);
-	int i;
-	for (i = 0; instr[i] != ' '; i++) {
-		opcode[i] = instr[i];
+bool tokenizeLine(const char *text, asm_line *line) {
+	const char *p = text;
+
+	while (isspace((unsigned char) *p))
+		p++;
+	if (*p == '\0' || *p == '#')
+		return false;
+
+	line->operandCount = 0;
+	line->base.length = 0;
+	line->opcode.start = p;
+	while (isalnum((unsigned char) *p))
+		p++;
+	line->opcode.length = p - line->opcode.start;
+	line->end = p;
+	if (line->opcode.length == 0 || (*p != '\0' && *p != '#'
+			&& !isspace((unsigned char) *p)))
+		syntaxError("Invalid Opcode", __LINE__);
+
+	while (isspace((unsigned char) *p))
+		p++;
+	while (*p != '\0' && *p != '#') {
+		if (line->operandCount == 3)
+			syntaxError("Too many operands", __LINE__);
+		token *operand = &line->operands[line->operandCount++];
+		operand->start = p;
+		while (*p != '\0' && *p != '#' && *p != ',' && *p != '('
+				&& !isspace((unsigned char) *p))
+			p++;
+		operand->length = p - operand->start;
+		line->end = p;
+		while (isspace((unsigned char) *p))
+			p++;
+
+		if (*p == '(') { //offset($base)
+			p++;
+			while (isspace((unsigned char) *p))
+				p++;
+			line->base.start = p;
+			while (*p != '\0' && *p != ')' && *p != '#' && *p != ','
+					&& !isspace((unsigned char) *p))
+				p++;
+			line->base.length = p - line->base.start;
+			while (isspace((unsigned char) *p))
+				p++;
+			if (*p != ')' || line->base.length == 0)
+				syntaxError("Invalid Parentheses", __LINE__);
+			line->end = ++p;
+			while (isspace((unsigned char) *p))
+				p++;
+		}
+
+		if (*p == ',') {
+			p++;
+			while (isspace((unsigned char) *p))
+				p++;
+			if (*p == '\0' || *p == '#')
+				syntaxError("Missing operand after ','", __LINE__);
+		} else if (*p != '\0' && *p != '#') {
+			syntaxError("Expected ',' between operands", __LINE__);
+		}
+		if (operand->length == 0)
+			syntaxError("Missing operand", __LINE__);
 	}
-	opcode[i] = '\0';
-	return opcode;
+	return true;
 }
 
 /**
- * remove any unecessary chars, then return the register name as string
+ * Report a malformed source line and stop assembling.
  */
-int extractRegister(char* instr, int index) {
-	int i;
-	int regIdx = 0;
-	int charIdx = 0;
-	bool gotOp = false; //did we find the opcode yet?
-	char reg[6]; //to hold $zero+'\0'
-
-	for (i = 0; instr[i] != '\0'; i++) {
-		if (gotOp && instr[i] == ',')
-			regIdx++;
-		if (gotOp && isAValidReg(instr[i]) && index == regIdx)
-			reg[charIdx++] = instr[i];
-		if (instr[i] == ' ')
-			gotOp = true;
+void syntaxError(const char *message, int line) {
+	printf("\n>>>ERROR!\n******%s,\n\tFrom: instruction.h @ line %d\n",
+			message, line);
+	exit(1);
+}
+
+/**
+ * The R, I, J or B type of a decoded instruction.
+ */
+instr_type instrType(const instr *inst) {
+	return opTable[inst->op].type;
+}
+
+/**
+ * Is this the halt that ends the program?
+ */
+bool isHalt(const instr *inst) {
+	return inst->op == HALT;
+}
+
+/**
+ * Is this a type B instruction, a bubble or the halt? Those two close the
+ * opcode enum, so this needs no lookup in 'opTable'.
+ */
+bool isBType(const instr *inst) {
+	return inst->op >= BUBBLE;
+}
+
+/**
+ * Does this instruction load or store?
+ */
+bool isMemoryAccess(const instr *inst) {
+	return opTable[inst->op].kind == DOES_LOAD
+			|| opTable[inst->op].kind == DOES_STORE;
+}
+
+/**
+ * Does this instruction decide where the program goes next: a branch or a
+ * jump?
+ */
+bool isControl(const instr *inst) {
+	return opTable[inst->op].kind == DOES_BRANCH
+			|| opTable[inst->op].kind == DOES_JUMP;
+}
+
+/**
+ * Is the register this instruction writes only known once MEM has been to
+ * memory: a load's value, or the success flag of sc? Nothing can forward it
+ * from EX.
+ */
+bool resultFromMemory(const instr *inst) {
+	return isMemoryAccess(inst) && (opTable[inst->op].roles & WRITES_RD);
+}
+
+/**
+ * The pc after the instruction at 'pc', given the values of its rs and rt.
+ */
+int32_t controlTarget(const instr *inst, int32_t pc, int32_t rsVal,
+		int32_t rtVal) {
+	const op_info *info = &opTable[inst->op];
+	if (info->kind == DOES_BRANCH && info->execute(rsVal, rtVal, inst->i))
+		return pc + 1 + inst->i;
+	if (info->kind == DOES_JUMP)
+		return info->roles & READS_RS ? rsVal : inst->i;
+	return pc + 1;
+}
+
+/**
+ * Is the byte offset of a load or store a multiple of its size?
+ */
+bool isAligned(const instr *inst) {
+	return (inst->i & (opTable[inst->op].size - 1)) == 0;
+}
+
+/**
+ * The word address a load or store accesses, from the value of its rs.
+ */
+uint32_t wordAddress(const instr *inst, int32_t rsVal) {
+	return (uint32_t) rsVal + (uint32_t) (inst->i >> 2);
+}
+
+/**
+ * What a load puts in its register, from the word it accessed: the byte or
+ * halfword at its offset, zero extended, or the whole word.
+ */
+int32_t loadValue(const instr *inst, int32_t word) {
+	int size = opTable[inst->op].size;
+	if (size == 4)
+		return word;
+	return ((uint32_t) word >> 8 * (inst->i & 3)) & ((1u << 8 * size) - 1);
+}
+
+/**
+ * The word a store leaves in memory: 'value', or its low byte or halfword
+ * merged into the old 'word' at the store's offset.
+ */
+int32_t storeValue(const instr *inst, int32_t word, int32_t value) {
+	int size = opTable[inst->op].size;
+	if (size == 4)
+		return value;
+	uint32_t mask = ((1u << 8 * size) - 1) << 8 * (inst->i & 3);
+	return (word & ~mask) | (((uint32_t) value << 8 * (inst->i & 3)) & mask);
+}
+
+/**
+ * FNV-1a over the name, started from 'seed', with a final bit mix so the
+ * low bits used for the table slot depend on every character.
+ */
+uint32_t hashName(const char *name, uint32_t seed) {
+	uint32_t h = seed;
+	for (; *name; name++) {
+		h ^= (uint8_t) *name;
+		h *= 16777619u;
 	}
-	reg[charIdx++] = '\0'; //null terminate
+	h ^= h >> 16;
+	h *= 0x7feb352du;
+	h ^= h >> 15;
+	return h;
+}
+
+/**
+ * Mnemonic to opcode, format and operand shape; NULL if unknown.
+ */
+const mnemonic* lookupMnemonic(const char *name) {
+	const mnemonic *m = &mnemonicTable[hashName(name, MNEMONIC_SEED)
+			% MNEMONIC_SLOTS];
+	if (m->name != NULL && strcmp(m->name, name) == 0)
+		return m;
+	return NULL;
+}
 
-	if (reg[0] != '$') {
-		printf("\n>>>ERROR!\n******Invalid Register Name: * %s  *,"
-				"\n\tFrom: instruction.h @ line 270\n", (char*) reg);
+/**
+ * Opcode back to its mnemonic, for reports.
+ */
+const char* opcodeName(opcode op) {
+	if (op < ADD || op > HALT)
+		return "?";
+	return opTable[op].name;
+}
+
+/**
+ * Register name (without the '$') to register number; NULL if unknown.
+ */
+const reg_name* lookupRegister(const char *name) {
+	const reg_name *r = &registerTable[hashName(name, REGISTER_SEED)
+			% REGISTER_SLOTS];
+	if (r->name != NULL && strcmp(r->name, name) == 0)
+		return r;
+	return NULL;
+}
+
+/**
+ * Turn a register operand like $t0 or $8 into its register number.
+ */
+int extractRegister(token reg) {
+	char name[8]; //to hold $zero+'\0' with room to spare
+
+	if (reg.length < 2 || reg.length >= (int) sizeof(name)
+			|| reg.start[0] != '$') {
+		printf("\n>>>ERROR!\n******Invalid Register Name: * %.*s  *,"
+				"\n\tFrom: instruction.h @ line %d\n", reg.length, reg.start,
+				__LINE__);
 		exit(1);
 	}
 	//trim dollar sign
-	int regVal = regValue(reg + 1);
-	//Register is invalid: only one char
+	memcpy(name, reg.start + 1, reg.length - 1);
+	name[reg.length - 1] = '\0';
+	int regVal = regValue(name);
 	if (regVal == -1) {
-		printf("\n>>>ERROR!\n******Invalid Register Name: * %c  *,"
-				"\n\tFrom: instruction.h @ line 278\n", (char) regVal);
+		printf("\n>>>ERROR!\n******Invalid Register Name: * %.*s  *,"
+				"\n\tFrom: instruction.h @ line %d\n", reg.length, reg.start,
+				__LINE__);
 		exit(1);
 	}
 	return regVal;
@@ -289,210 +1002,248 @@ int extractRegister(char* instr, int index) {
  */
 int regValue(char* c) {
 
-	int retVal = -1; //return -1 if not found in register map
-	if (isalpha(c[0])) {
-		int i = 0;
-		while (strcmp(c, regMap[i].name) != 0) { // && regMap[i].name != NULL) {
-			if (strcmp("\0", regMap[i].name) != 0)
-				i++;
-		    else
-				return retVal;
-		}
-
-		if (strcmp(c, regMap[i].name) == 0)
-			retVal = i;
-
-	} else {
-		/*If no letter in first index, check if it is $# format.
-		 * Then check if all chars after '$' are numbers...
-		 * If numbers, then convert to int to check if it's between 0 and 31
-		 *  Otherwise return -1
-		 */
-		int i = 0;
-		char currC = c[i];
-		while (currC != '\0') {
-			if (!isdigit(currC))
-				return -1;
-			currC = c[++i];
-		}
-		//If we've made it here, the string is a number
-		int regIndex = atoi(c);
-		if (regIndex >= 0 && regIndex <= 31)
-			return regIndex;
-		else {
-			printf("\n>>>ERROR!\n******Register Index:* %d *out of bounds,"
-					"\n\tFrom: projmain.h @ line 322\n", regIndex);
-			exit(1);
-		}
-	}	//end else
+	const reg_name *r = lookupRegister(c);
+	if (r != NULL)
+		return r->index;
 
-	return retVal;
+	/*Not a register name or canonical number: check if it is still a number
+	 * in $# format, like $07, to report it or give its index.
+	 */
+	int i = 0;
+	if (c[0] == '\0')
+		return -1;
+	for (i = 0; c[i] != '\0'; i++) {
+		if (!isdigit(c[i]))
+			return -1;
+	}
+	//If we've made it here, the string is a number
+	int regIndex = atoi(c);
+	if (regIndex >= 0 && regIndex <= 31)
+		return regIndex;
+	printf("\n>>>ERROR!\n******Register Index:* %d *out of bounds,"
+			"\n\tFrom: instruction.h @ line %d\n", regIndex, __LINE__);
+	exit(1);
 }	//end regValue function
 
 
 /**
- * For instrs with Base registers...
+ * For IType instrs, get the constant number: decimal, or hex after 0x.
+ * fitsField() checks it against the field it goes in.
  */
-int extractBase(char* instr) {
-	int i;
-	int charIdx = 0;
-	bool paren1 = false; //checking for opening parenthesis
-	bool paren2 = false; //checking for closing parenthesis
-	char reg[6]; //To hold $zero+'\0'
-	for (i = 0; instr[i] != '\0'; i++) {
-
-		if (instr[i] == ')')
-			paren2 = true;
-		if (paren1 && !paren2) {
-			reg[charIdx] = instr[i];
-			charIdx++;
-		}
-		if (instr[i] == '(')
-			paren1 = true;
+int32_t extractImmediate(token imm) {
+	int i = 0, base = 10, digit;
+	int64_t value = 0;
+	bool negative = imm.length > 0 && imm.start[0] == '-';
 
+	if (negative)
+		i++;
+	if (imm.length - i > 2 && imm.start[i] == '0'
+			&& (imm.start[i + 1] == 'x' || imm.start[i + 1] == 'X')) {
+		base = 16;
+		i += 2;
 	}
-	if (!paren2 || !paren1) {
-		printf("\n>>>ERROR!\n******Invalid Parentheses,"
-				"\n\tFrom: instruction.h @ line 354\n");
+	if (i == imm.length)
+		syntaxError("Invalid Immediate Field", __LINE__);
+	for (; i < imm.length; i++) {
+		char c = imm.start[i];
+		if (isdigit((unsigned char) c))
+			digit = c - '0';
+		else if (base == 16 && isxdigit((unsigned char) c))
+			digit = tolower((unsigned char) c) - 'a' + 10;
+		else
+			syntaxError("Invalid Immediate Field", __LINE__);
+		value = value * base + digit;
+		if (value > (int64_t) UINT32_MAX)
+			break; //too large already, and must not overflow
+	}
+	if (negative)
+		value = -value;
+	if (value > INT32_MAX || value < INT32_MIN) {
+		printf("\n>>>ERROR!\n******Invalid Immediate Field: Too Large at "
+				"* %.*s *\n\tFrom: instruction.h @ line %d\n", imm.length,
+				imm.start, __LINE__);
 		exit(1);
 	}
-	if (reg[0] != '$') {
-		printf("\n>>>ERROR!\n******Invalid Offset/Base Register (no $),"
-				"\n\tFrom: instruction.h @ line 359\n");
+	return value;
+}
+
+/**
+ * Does 'value' fit the immediate field of 'inst': 26 unsigned bits for a
+ * jump target, 16 bits otherwise, which are unsigned for the ops that zero
+ * extend them?
+ */
+bool fitsField(const instr *inst, int32_t value) {
+	if (instrType(inst) == JType)
+		return value >= 0 && value <= 0x03ffffff;
+	if (opTable[inst->op].roles & ZERO_EXTENDS)
+		return value >= -32768 && value <= 65535;
+	return value >= -32768 && value <= 32767;
+}
+
+/**
+ * An immediate operand: a number, or a label, which 'kind' of fixup fills
+ * in at the end of the file (0 until then). Goes in the instruction being
+ * assembled, as it will come back when decoded: 16-bit fields sign
+ * extended.
+ */
+int32_t immediateOperand(program *prog, symbol_table *symbols, token operand,
+		fixup_kind kind) {
+	const instr *inst = &prog->instructions[prog->count];
+	if (isLabel(operand)) {
+		addFixup(symbols, kind, operand, prog->count);
+		return 0;
+	}
+	int32_t value = extractImmediate(operand);
+	if (!fitsField(inst, value)) {
+		printf("\n>>>ERROR!\n******Invalid Immediate Field: Too Large at "
+				"* %.*s *\n\tFrom: instruction.h @ line %d\n",
+				operand.length, operand.start, __LINE__);
 		exit(1);
 	}
-	reg[charIdx++] = '\0'; //null terminate
-	return regValue(reg + 1);
+	return instrType(inst) == JType ? value : (int16_t) value;
 }
 
 /**
- * For IType instrs, get the constant number
+ * Whether 'name' is a label: a letter or '_', then letters, digits, '_'
+ * and '.'.
  */
-int extractImmediate(char* instruction, int index) {
+bool isLabel(token name) {
 	int i;
-	int regIdx = 0;
-	int charIdx = 0;
-	bool readOpcode = false;
-	char reg[6]; //To be able to hold $zero, which is 5 characters and the null character
-//	printf("extractImmediate\n");
-	for (i = 0; instruction[i] != '\0' && instruction[i] != '('; i++) {
-		if (readOpcode && instruction[i] == ',')
-			regIdx++;
-		if (readOpcode && instruction[i] != ',' && regIdx == index)
-			reg[charIdx++] = instruction[i];
-		if (instruction[i] == ' ')
-			readOpcode = true;
+	if (name.length == 0 || (!isalpha((unsigned char) name.start[0])
+			&& name.start[0] != '_'))
+		return false;
+	for (i = 1; i < name.length; i++)
+		if (!isalnum((unsigned char) name.start[i]) && name.start[i] != '_'
+				&& name.start[i] != '.')
+			return false;
+	return true;
+}
+
+/**
+ * The index in 'symbols' of the label 'name', entered undefined if it is
+ * new.
+ */
+int32_t lookupSymbol(symbol_table *symbols, token name) {
+	char key[MAX_LABEL_LENGTH];
+	int32_t i, index;
+	uint32_t slot;
+
+	if (!isLabel(name) || name.length >= MAX_LABEL_LENGTH) {
+		printf("\n>>>ERROR!\n******Invalid label: * %.*s * on line %d,"
+				"\n\tFrom: instruction.h @ line %d\n", name.length,
+				name.start, symbols->line, __LINE__);
+		exit(1);
 	}
-	reg[charIdx++] = '\0';
-	for (i = 0; reg[i] != '\0'; i++) {
-		if (!isdigit(reg[i])) {
-			if (!(i == 0 && reg[i] == '-')) {
-				printf("\n>>>ERROR!\n******Invalid Immediate Field,"
-						"\n\tFrom: instruction.h @ line 389\n");
-				exit(1);
-			}
+	memcpy(key, name.start, name.length);
+	key[name.length] = '\0';
+
+	//keep the table at most half full, so probe runs stay short
+	if (2 * (symbols->count + 1) > symbols->slotCount) {
+		int32_t slotCount = symbols->slotCount ? 2 * symbols->slotCount : 1024;
+		int32_t *slots = malloc(slotCount * sizeof(int32_t));
+		if (slots == NULL)
+			goto outOfMemory;
+		memset(slots, 0xff, slotCount * sizeof(int32_t));
+		for (i = 0; i < symbols->count; i++) {
+			slot = hashName(symbols->symbols[i].name, SYMBOL_SEED);
+			while (slots[slot & (slotCount - 1)] >= 0)
+				slot++;
+			slots[slot & (slotCount - 1)] = i;
 		}
+		free(symbols->slots);
+		symbols->slots = slots;
+		symbols->slotCount = slotCount;
 	}
-	int imm = atoi(reg);
-	if (imm > 32767 || imm < -32768) {
-		printf("\n>>>ERROR!\n******Invalid Immediate Field: Too Large at size="
-				"%d\n\tFrom: instruction.h @ line 397\n", imm);
+
+	for (slot = hashName(key, SYMBOL_SEED);; slot++) {
+		index = symbols->slots[slot & (symbols->slotCount - 1)];
+		if (index < 0)
+			break;
+		if (strcmp(symbols->symbols[index].name, key) == 0)
+			return index;
+	}
+
+	symbols->symbols = growArray(symbols->symbols, &symbols->capacity,
+			symbols->count + 1, sizeof(symbol));
+	index = symbols->count++;
+	symbol *sym = &symbols->symbols[index];
+	memset(sym, 0, sizeof(symbol));
+	if ((sym->name = strdup(key)) == NULL)
+		goto outOfMemory;
+	sym->line = symbols->line;
+	symbols->slots[slot & (symbols->slotCount - 1)] = index;
+	return index;
+
+	outOfMemory:
+	printf("\n>>>ERROR!\n******Out of host memory for labels,"
+			"\n\tFrom: instruction.h @ line %d\n", __LINE__);
+	exit(1);
+}
+
+/**
+ * Define the label 'name' as 'value' on the current line.
+ */
+void defineSymbol(symbol_table *symbols, token name, int32_t value,
+		bool isData) {
+	int32_t index = lookupSymbol(symbols, name); //before it can move
+	symbol *sym = &symbols->symbols[index];
+	if (sym->defined) {
+		printf("\n>>>ERROR!\n******Label * %s * on line %d already defined"
+				" on line %d,\n\tFrom: instruction.h @ line %d\n", sym->name,
+				symbols->line, sym->line, __LINE__);
 		exit(1);
 	}
-	return imm;
-}
-
-/**
- * If valid op, assign the Enum value...
- * TODO: Switch/Case instead
- */
-opcode stringToOpcode(char* opcode) {
-	/*add types*/
-	if (strcmp(opcode, "add") == 0)
-		return ADD;
-	else if (strcmp(opcode, "addi") == 0)
-		return ADDI;
-	else if (strcmp(opcode, "addiu") == 0)
-		return ADDIU;
-	else if (strcmp(opcode, "addu") == 0)
-		return ADDU;
-	/*and types*/
-	else if (strcmp(opcode, "and") == 0)
-		return AND;
-	else if (strcmp(opcode, "andi") == 0)
-		return ANDI;
-	/*branching and jumping types*/
-	else if (strcmp(opcode, "beq") == 0)
-		return BEQ;
-	else if (strcmp(opcode, "bne") == 0)
-		return BNE;
-	else if (strcmp(opcode, "j") == 0)
-		return J;
-	else if (strcmp(opcode, "jal") == 0)
-		return JAL;
-	else if (strcmp(opcode, "jr") == 0)
-		return JR;
-	/*load types*/
-	else if (strcmp(opcode, "lbu") == 0)
-		return LBU;
-	else if (strcmp(opcode, "lhu") == 0)
-		return LHU;
-	else if (strcmp(opcode, "ll") == 0)
-		return LL;
-	else if (strcmp(opcode, "lui") == 0)
-		return LUI;
-	else if (strcmp(opcode, "lw") == 0)
-		return LW;
-	/*or type*/
-	else if (strcmp(opcode, "nor") == 0)
-		return NOR;
-	else if (strcmp(opcode, "or") == 0)
-		return OR;
-	else if (strcmp(opcode, "ori") == 0)
-		return ORI;
-	/*set less than types*/
-	else if (strcmp(opcode, "slt") == 0)
-		return SLT;
-	else if (strcmp(opcode, "slti") == 0)
-		return SLTI;
-	else if (strcmp(opcode, "sltiu") == 0)
-		return SLTIU;
-	else if (strcmp(opcode, "sltu") == 0)
-		return SLTU;
-	/*shift types*/
-	else if (strcmp(opcode, "sll") == 0)
-		return SLL;
-	else if (strcmp(opcode, "srl") == 0)
-		return SRL;
-	/*store types*/
-	else if (strcmp(opcode, "sb") == 0)
-		return SB;
-	else if (strcmp(opcode, "sc") == 0)
-		return SC;
-	else if (strcmp(opcode, "sh") == 0)
-		return SH;
-	else if (strcmp(opcode, "sw") == 0)
-		return SW;
-	/*arithmetic types*/
-	else if (strcmp(opcode, "mul") == 0)
-		return MUL;
-	else if (strcmp(opcode, "mulu") == 0)
-		return MULU;
-	else if (strcmp(opcode, "sub") == 0)
-		return SUB;
-	else if (strcmp(opcode, "subu") == 0)
-		return SUBU;
-	else if (strcmp(opcode, "div") == 0)
-		return DIV;
-	else if (strcmp(opcode, "divu") == 0)
-		return DIVU;
-	/*custom types*/
-	else if (strcmp(opcode, "bubble") == 0)
-		return BUBBLE;
-	else if (strcmp(opcode, "halt") == 0)
-		return HALT;
-	else
-		return HALT;
-} //end function stringToOpcode()
+	sym->value = value;
+	sym->line = symbols->line;
+	sym->defined = true;
+	sym->isData = isData;
+}
+
+/**
+ * Remember that the instruction or data word 'at' uses the label 'name'.
+ */
+void addFixup(symbol_table *symbols, fixup_kind kind, token name, int32_t at) {
+	int32_t index = lookupSymbol(symbols, name);
+	symbols->fixups = growArray(symbols->fixups, &symbols->fixupCapacity,
+			symbols->fixupCount + 1, sizeof(fixup));
+	fixup *f = &symbols->fixups[symbols->fixupCount++];
+	f->kind = kind;
+	f->symbol = index;
+	f->at = at;
+	f->line = symbols->line;
+}
+
+/**
+ * Give back the labels and fixups, leaving an empty table.
+ */
+void freeSymbols(symbol_table *symbols) {
+	int32_t i;
+	for (i = 0; i < symbols->count; i++)
+		free(symbols->symbols[i].name);
+	free(symbols->symbols);
+	free(symbols->slots);
+	free(symbols->fixups);
+	memset(symbols, 0, sizeof(symbol_table));
+}
+
+/**
+ * 'array' of 'size' byte elements with room for at least 'count', its
+ * '*capacity' doubled as often as needed, as reserveInstructions() does.
+ */
+void* growArray(void *array, int32_t *capacity, int32_t count, size_t size) {
+	if (count <= *capacity)
+		return array;
+	int32_t grown = *capacity ? *capacity : 256;
+	while (grown < count)
+		grown *= 2;
+	array = realloc(array, grown * size);
+	if (array == NULL) {
+		printf("\n>>>ERROR!\n******Out of host memory for %d entries,"
+				"\n\tFrom: instruction.h @ line %d\n", grown, __LINE__);
+		exit(1);
+	}
+	*capacity = grown;
+	return array;
+}
 
 #endif /* INSTRUCTION_H_ */
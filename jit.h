@@ -0,0 +1,465 @@
+/*
+ * jit.h
+ *
+ *  Created on: Oct 18, 2026
+ *
+ *  Translation tier for the functional engine: counts how often each basic
+ *  block is entered and, once a block gets hot, translates it to x86-64
+ *  code in mmap'd executable memory. The guest register file stays in the
+ *  machine's 'regs' array, pinned in a host register while translated code
+ *  runs, so the interpreter and the translations can hand over at any
+ *  block boundary.
+ *
+ *  A block starts where a branch or jump lands (or at the entry point) and
+ *  runs up to its first beq, bne, j or jal. Each of its exits at first
+ *  returns to the interpreter with the guest pc; once the target block is
+ *  translated too the exit is patched into a direct jump, so hot loops run
+ *  without leaving host code. Anything a block cannot translate (an unknown
+ *  opcode, a misaligned load or store, a branch out of the program) ends the
+ *  block early, and the interpreter runs it and reports the error as usual.
+ *  A block that would end on a control instruction left to the interpreter,
+ *  a jr say, is not translated at all: every pass through it would leave
+ *  host code anyway, and the round trip costs more than it saves.
+ *
+ *  Only built for x86-64 Linux. Elsewhere, or when the host will not map
+ *  executable memory, the interpreter runs everything.
+ *
+ *  REFERENCES: see projmain.c header comment.
+ */
+
+#ifndef JIT_H_
+#define JIT_H_
+
+#include "pipeline.h"
+
+/******************************************************************************
+ * Constants/Definitions
+ */
+#if defined(__x86_64__) && defined(__linux__)
+#define JIT_SUPPORTED
+#endif
+
+#define JIT_THRESHOLD 50 //block entries before it gets translated
+#define JIT_CODE_SIZE (16 << 20) //bytes of host code at most
+#define JIT_MAX_BLOCK 256 //instructions in one block at most
+#define JIT_MAX_BYTES 80 //host code one instruction translates to at most
+#define JIT_EXIT_BYTES 10 //mov eax, pc; jmp epilogue
+
+//host registers, by their x86 encoding
+#define HOST_EAX 0
+#define HOST_ECX 1
+#define HOST_ESI 6
+
+/******************************************************************************
+ * Global Vars and Structs
+ */
+
+//translated code is entered with the register file, RAM, the retired
+//counter and the block; it returns the guest pc to interpret from
+typedef int32_t (*jit_entry)(int32_t*, ram*, int64_t*, uint8_t*);
+
+typedef struct jit_block_tag {
+	uint8_t *code; //NULL until translated
+	int32_t entries; //-1 once it turned out not to translate
+	int32_t pending; //first exit waiting for this block to translate, or -1
+} jit_block;
+
+//an exit to a block not translated yet, patched once it is
+typedef struct jit_exit_tag {
+	uint8_t *site;
+	int32_t next; //the next exit waiting for the same block, or -1
+} jit_exit;
+
+typedef struct jit_tag {
+	const program *prog;
+	int32_t threshold;
+	jit_block *blocks; //by the pc a block starts at
+	jit_exit *exits;
+	int32_t exitCount;
+	int32_t exitCapacity;
+	uint8_t *code; //the mapping, the entry code first
+	size_t used;
+	uint8_t *epilogue;
+	jit_entry enter;
+	int64_t retired; //instructions retired in translated code
+	int32_t translated; //blocks
+} jit;
+
+/******************************************************************************
+ * Function Prototypes
+ */
+jit* openJit(const program*, int32_t);
+void closeJit(jit*);
+int32_t runTranslated(jit*, machine*, int32_t);
+bool translateBlock(jit*, int32_t);
+bool isTranslatable(const program*, int32_t);
+void translateInstruction(jit*, const instr*, int32_t);
+void translateMemory(jit*, const instr*);
+void emitExit(jit*, int32_t);
+void patchExits(jit*, int32_t);
+void emitByte(jit*, uint8_t);
+void emitWord(jit*, uint32_t);
+void emitRegister(jit*, uint8_t, int, int8_t);
+uint8_t* emitJump8(jit*, uint8_t);
+void landJump8(jit*, uint8_t*);
+
+/******************************************************************************
+ * Functions
+ */
+
+/**
+ * Map the code buffer for 'prog' and write the entry code into it. Returns
+ * NULL where there is no translation, so the caller only interprets.
+ */
+jit* openJit(const program *prog, int32_t threshold) {
+#ifdef JIT_SUPPORTED
+	int32_t i;
+	jit *j = calloc(1, sizeof(jit));
+	//one past the end too, for exits off the end of the program
+	if (j == NULL || (j->blocks = malloc((prog->count + 1)
+			* sizeof(jit_block))) == NULL) {
+		printf("\n>>>ERROR!\n******Out of host memory for the JIT,"
+				"\n\tFrom: jit.h @ line %d\n", __LINE__);
+		exit(1);
+	}
+	j->code = mmap(NULL, JIT_CODE_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (j->code == MAP_FAILED) { //no executable memory here, interpret
+		free(j->blocks);
+		free(j);
+		return NULL;
+	}
+	j->prog = prog;
+	j->threshold = threshold;
+	for (i = 0; i <= prog->count; i++) {
+		j->blocks[i].code = NULL;
+		j->blocks[i].entries = 0;
+		j->blocks[i].pending = -1;
+	}
+
+	//entry: save the registers kept pinned, load them, jump to the block
+	j->enter = (jit_entry) (void*) j->code;
+	emitByte(j, 0x53); //push rbx
+	emitByte(j, 0x41); emitByte(j, 0x55); //push r13
+	emitByte(j, 0x41); emitByte(j, 0x56); //push r14
+	emitByte(j, 0x48); emitByte(j, 0x89); emitByte(j, 0xFB); //mov rbx, rdi
+	emitByte(j, 0x49); emitByte(j, 0x89); emitByte(j, 0xF6); //mov r14, rsi
+	emitByte(j, 0x49); emitByte(j, 0x89); emitByte(j, 0xD5); //mov r13, rdx
+	emitByte(j, 0xFF); emitByte(j, 0xE1); //jmp rcx
+	//exits come back here with the next guest pc in eax
+	j->epilogue = j->code + j->used;
+	emitByte(j, 0x41); emitByte(j, 0x5E); //pop r14
+	emitByte(j, 0x41); emitByte(j, 0x5D); //pop r13
+	emitByte(j, 0x5B); //pop rbx
+	emitByte(j, 0xC3); //ret
+	return j;
+#else
+	return NULL;
+#endif
+}
+
+/**
+ * Unmap the translations and free the tier.
+ */
+void closeJit(jit *j) {
+	munmap(j->code, JIT_CODE_SIZE);
+	free(j->blocks);
+	free(j->exits);
+	free(j);
+}
+
+/**
+ * The interpreter reached the start of the block at 'pc': count the entry,
+ * translate the block once it is hot, and run translated code for as long
+ * as it lasts. Returns the pc the interpreter carries on from.
+ */
+int32_t runTranslated(jit *j, machine *m, int32_t pc) {
+	for (;;) {
+		jit_block *b = &j->blocks[pc];
+		if (b->code == NULL) {
+			if (b->entries < 0 || ++b->entries < j->threshold)
+				return pc;
+			if (!translateBlock(j, pc)) {
+				b->entries = -1;
+				return pc;
+			}
+		}
+		pc = j->enter(m->regs, &m->memory, &j->retired, b->code);
+	}
+}
+
+/**
+ * Translate the block starting at 'pc', chaining it to the blocks it exits
+ * to that are translated already and them to it. Returns false when not a
+ * single instruction of it translates, when it stops short of a control
+ * instruction the interpreter has to run, or the code buffer is full.
+ */
+bool translateBlock(jit *j, int32_t pc) {
+	const instr *code = j->prog->instructions;
+	int32_t i, end, counted = 0;
+
+	if (j->used + (JIT_MAX_BLOCK + 2) * JIT_MAX_BYTES > JIT_CODE_SIZE)
+		return false;
+	for (end = pc; end < j->prog->count && end - pc < JIT_MAX_BLOCK
+			&& isTranslatable(j->prog, end); end++) {
+		if (code[end].op != BUBBLE)
+			counted++;
+		if (isControl(&code[end])) {
+			end++;
+			break;
+		}
+	}
+	if (counted == 0 || (end < j->prog->count && end - pc < JIT_MAX_BLOCK
+			&& !isControl(&code[end - 1]) && isControl(&code[end])))
+		return false;
+
+	//set before the exits go out, so a loop back to the start chains too
+	j->blocks[pc].code = j->code + j->used;
+	emitByte(j, 0x49); //add qword [r13], counted
+	emitByte(j, 0x81);
+	emitByte(j, 0x45);
+	emitByte(j, 0x00);
+	emitWord(j, counted);
+	for (i = pc; i < end; i++) {
+		size_t start = j->used;
+		translateInstruction(j, &code[i], i);
+		//the room checked for above; a sw with an offset is the longest, 66
+		if (j->used - start > JIT_MAX_BYTES) {
+			printf("\n>>>ERROR!\n******Translated instruction longer than"
+					" JIT_MAX_BYTES,\n\tFrom: jit.h @ line %d\n", __LINE__);
+			exit(1);
+		}
+	}
+	if (!isControl(&code[end - 1]))
+		emitExit(j, end);
+
+	patchExits(j, pc);
+	j->translated++;
+	return true;
+}
+
+/**
+ * Whether the instruction at 'pc' can run as host code: the interpreter
+ * keeps anything that would stop the program with an error.
+ */
+bool isTranslatable(const program *prog, int32_t pc) {
+	const instr *inst = &prog->instructions[pc];
+	switch (inst->op) {
+	case ADD: case SUB: case AND: case OR: case MUL: case ADDI: case BUBBLE:
+		return true;
+	case LW: case SW:
+		return inst->i % 4 == 0;
+	case BEQ: case BNE:
+		return pc + 1 + inst->i >= 0 && pc + 1 + inst->i < prog->count;
+	case J: case JAL:
+		return inst->i >= 0 && inst->i < prog->count;
+	default:
+		return false;
+	}
+}
+
+/**
+ * Host code for 'inst', found at 'pc'. Guest registers are read from and
+ * written to the register file at rbx; writes to $zero are left out.
+ */
+void translateInstruction(jit *j, const instr *inst, int32_t pc) {
+	uint8_t *notTaken;
+
+	switch (inst->op) {
+	case ADD: case SUB: case AND: case OR: case MUL: case ADDI:
+		if (inst->rd == 0)
+			break;
+		emitRegister(j, 0x8B, HOST_EAX, inst->rs); //mov eax, rs
+		if (inst->op == ADDI) {
+			emitByte(j, 0x05); //add eax, i
+			emitWord(j, inst->i);
+		} else if (inst->op == MUL) {
+			emitByte(j, 0x0F); //imul eax, rt
+			emitRegister(j, 0xAF, HOST_EAX, inst->rt);
+		} else {
+			emitRegister(j, inst->op == ADD ? 0x03 : inst->op == SUB ? 0x2B :
+					inst->op == AND ? 0x23 : 0x0B, HOST_EAX, inst->rt);
+		}
+		emitRegister(j, 0x89, HOST_EAX, inst->rd); //mov rd, eax
+		break;
+	case LW: case SW:
+		translateMemory(j, inst);
+		break;
+	case BEQ: case BNE:
+		emitRegister(j, 0x8B, HOST_EAX, inst->rs); //mov eax, rs
+		emitRegister(j, 0x3B, HOST_EAX, inst->rt); //cmp eax, rt
+		notTaken = emitJump8(j, inst->op == BEQ ? 0x75 : 0x74); //jne or je
+		emitExit(j, pc + 1 + inst->i);
+		landJump8(j, notTaken);
+		emitExit(j, pc + 1);
+		break;
+	case JAL:
+		if (inst->rd != 0) {
+			emitRegister(j, 0xC7, HOST_EAX, inst->rd); //mov dword rd, pc + 1
+			emitWord(j, pc + 1);
+		}
+		emitExit(j, inst->i);
+		break;
+	case J:
+		emitExit(j, inst->i);
+		break;
+	default: //a bubble does nothing
+		break;
+	}
+}
+
+/**
+ * Host code for a load or store: straight to the page when it is the one
+ * RAM looked up last, otherwise through memRead()/memWrite().
+ */
+void translateMemory(jit *j, const instr *inst) {
+	bool load = inst->op == LW;
+	uint8_t *slow, *otherPage, *done;
+
+	if (load && inst->rd == 0)
+		return; //nothing to see
+	emitRegister(j, 0x8B, HOST_ESI, inst->rs); //mov esi, rs
+	if (inst->i != 0) {
+		emitByte(j, 0x81); //add esi, i / 4
+		emitByte(j, 0xC6);
+		emitWord(j, inst->i / 4);
+	}
+	if (!load)
+		emitRegister(j, 0x8B, HOST_ECX, inst->rt); //mov ecx, rt
+
+	emitByte(j, 0x89); //mov eax, esi
+	emitByte(j, 0xF0);
+	emitByte(j, 0xC1); //shr eax, PAGE_BITS
+	emitByte(j, 0xE8);
+	emitByte(j, PAGE_BITS);
+	emitByte(j, 0x41); //cmp eax, [r14 + lastPageNumber]
+	emitByte(j, 0x3B);
+	emitByte(j, 0x86);
+	emitWord(j, offsetof(ram, lastPageNumber));
+	slow = emitJump8(j, 0x75); //jne
+	emitByte(j, 0x49); //mov rdx, [r14 + lastPage]
+	emitByte(j, 0x8B);
+	emitByte(j, 0x96);
+	emitWord(j, offsetof(ram, lastPage));
+	emitByte(j, 0x48); //test rdx, rdx
+	emitByte(j, 0x85);
+	emitByte(j, 0xD2);
+	otherPage = emitJump8(j, 0x74); //jz
+	emitByte(j, 0x81); //and esi, PAGE_WORDS - 1
+	emitByte(j, 0xE6);
+	emitWord(j, PAGE_WORDS - 1);
+	emitByte(j, load ? 0x8B : 0x89); //mov eax, [rdx + rsi * 4] or back
+	emitByte(j, load ? 0x04 : 0x0C);
+	emitByte(j, 0xB2);
+	done = emitJump8(j, 0xEB); //jmp
+
+	landJump8(j, slow);
+	landJump8(j, otherPage);
+	if (!load) {
+		emitByte(j, 0x89); //mov edx, ecx
+		emitByte(j, 0xCA);
+	}
+	emitByte(j, 0x4C); //mov rdi, r14
+	emitByte(j, 0x89);
+	emitByte(j, 0xF7);
+	emitByte(j, 0x48); //mov rax, memRead or memWrite
+	emitByte(j, 0xB8);
+	uint64_t helper = load ? (uint64_t) (uintptr_t) &memRead :
+			(uint64_t) (uintptr_t) &memWrite;
+	emitWord(j, (uint32_t) helper);
+	emitWord(j, (uint32_t) (helper >> 32));
+	emitByte(j, 0xFF); //call rax
+	emitByte(j, 0xD0);
+
+	landJump8(j, done);
+	if (load)
+		emitRegister(j, 0x89, HOST_EAX, inst->rd); //mov rd, eax
+}
+
+/**
+ * Leave the block for the guest instruction at 'target': a jump straight
+ * to its translation when there is one, otherwise back to the interpreter,
+ * to be patched once the target is translated. Always JIT_EXIT_BYTES long.
+ */
+void emitExit(jit *j, int32_t target) {
+	uint8_t *site = j->code + j->used;
+
+	if (j->blocks[target].code != NULL) {
+		emitByte(j, 0xE9); //jmp target
+		emitWord(j, j->blocks[target].code - (site + 5));
+		emitByte(j, 0x0F); //5 byte nop
+		emitByte(j, 0x1F);
+		emitByte(j, 0x44);
+		emitByte(j, 0x00);
+		emitByte(j, 0x00);
+		return;
+	}
+
+	if (j->exitCount == j->exitCapacity) {
+		j->exitCapacity = j->exitCapacity == 0 ? 256 : 2 * j->exitCapacity;
+		j->exits = realloc(j->exits, j->exitCapacity * sizeof(jit_exit));
+		if (j->exits == NULL) {
+			printf("\n>>>ERROR!\n******Out of host memory for the JIT,"
+					"\n\tFrom: jit.h @ line %d\n", __LINE__);
+			exit(1);
+		}
+	}
+	j->exits[j->exitCount].site = site;
+	j->exits[j->exitCount].next = j->blocks[target].pending;
+	j->blocks[target].pending = j->exitCount++;
+
+	emitByte(j, 0xB8); //mov eax, target
+	emitWord(j, target);
+	emitByte(j, 0xE9); //jmp epilogue
+	emitWord(j, j->epilogue - (site + JIT_EXIT_BYTES));
+}
+
+/**
+ * The block at 'target' was just translated: turn every exit waiting for it
+ * into a direct jump.
+ */
+void patchExits(jit *j, int32_t target) {
+	int32_t e;
+	for (e = j->blocks[target].pending; e >= 0; e = j->exits[e].next) {
+		uint8_t *site = j->exits[e].site;
+		int32_t offset = j->blocks[target].code - (site + 5);
+		site[0] = 0xE9; //jmp target
+		memcpy(&site[1], &offset, sizeof(offset));
+	}
+	j->blocks[target].pending = -1;
+}
+
+void emitByte(jit *j, uint8_t b) {
+	j->code[j->used++] = b;
+}
+
+void emitWord(jit *j, uint32_t w) { //little endian, as x86 wants
+	memcpy(&j->code[j->used], &w, sizeof(w));
+	j->used += sizeof(w);
+}
+
+/**
+ * 'opcode' with host register 'host' and guest register 'reg', in the
+ * register file at rbx, as its operands.
+ */
+void emitRegister(jit *j, uint8_t opcode, int host, int8_t reg) {
+	emitByte(j, opcode);
+	emitByte(j, 0x43 | host << 3); //[rbx + disp8]
+	emitByte(j, reg * 4);
+}
+
+/**
+ * A short jump with 'opcode' to somewhere not emitted yet; landJump8()
+ * points it at the code that follows.
+ */
+uint8_t* emitJump8(jit *j, uint8_t opcode) {
+	emitByte(j, opcode);
+	emitByte(j, 0);
+	return j->code + j->used - 1;
+}
+
+void landJump8(jit *j, uint8_t *jump) {
+	*jump = j->code + j->used - (jump + 1);
+}
+
+#endif /* JIT_H_ */
@@ -0,0 +1,420 @@
+/*
+ * lanes.h
+ *
+ *  Created on: Oct 18, 2026
+ *
+ *  Lockstep functional simulation of many machines at once: the same
+ *  program runs on up to MAX_LANES independent register files and RAMs,
+ *  each lane starting from its own registers and memory words, for
+ *  parameter sweeps and randomized input testing. The register files are
+ *  kept as structure of arrays, every register a row of lanes, so the ALU
+ *  instructions execute for LANE_WIDTH lanes at a time with vector
+ *  instructions (GCC vector extensions: AVX2 when built with -mavx2, SSE
+ *  otherwise). Loads and stores go lane by lane, to each lane's own RAM,
+ *  and so do divides and jumps, through the handlers in 'opTable'.
+ *
+ *  Each lane has its own pc. Every step runs the instruction at the lowest
+ *  pc any lane is at, masked to the lanes that are there, so lanes a branch
+ *  splits up wait for each other and go on together once they meet again
+ *  (at the latest at the instruction after a loop they left early). Final
+ *  registers, memory and instructions retired per lane are the same as a
+ *  functional run from the same state.
+ *
+ *  REFERENCES: see projmain.c header comment.
+ */
+
+#ifndef LANES_H_
+#define LANES_H_
+
+#include "pipeline.h"
+
+/******************************************************************************
+ * Constants/Definitions
+ */
+#ifdef __AVX2__
+#define LANE_BYTES 32
+#else
+#define LANE_BYTES 16
+#endif
+#define LANE_WIDTH (LANE_BYTES / 4) //lanes per vector
+#define MAX_LANES 256
+#define LANE_VECTORS (MAX_LANES / LANE_WIDTH)
+#define LANE_HALTED INT32_MAX //pc of a lane that is done, never the lowest
+#define LANE_FLUSH (1 << 30) //steps before the 32-bit retired counts flush
+#define LANE_ROW(vectors) ((uint32_t*) (vectors)) //a row of vectors by lane
+
+/******************************************************************************
+ * Global Vars and Structs
+ */
+typedef uint32_t lane_vec __attribute__((vector_size(LANE_BYTES)));
+typedef int32_t lane_mask __attribute__((vector_size(LANE_BYTES)));
+
+typedef struct lanes_tag {
+	const program *prog;
+	int32_t count; //lanes in use
+	int32_t vectors; //vectors it takes to cover them
+	lane_vec regs[32][LANE_VECTORS];
+	lane_vec pc[LANE_VECTORS]; //lanes beyond 'count' are halted from the start
+	lane_vec counted[LANE_VECTORS]; //retired since the last flush
+	int64_t retired[MAX_LANES];
+	int64_t steps; //instructions run, each for however many lanes
+	ram *memory; //one address space per lane
+
+	//every lane's last page, packed together unlike the ones in 'memory'
+	mem_page *lastPage[MAX_LANES];
+	uint32_t lastPageNumber[MAX_LANES];
+} lanes;
+
+/******************************************************************************
+ * Function Prototypes
+ */
+lanes* loadLanes(const program*, const char*);
+void freeLanes(lanes*);
+void runLanes(lanes*);
+void flushRetired(lanes*);
+int32_t laneRegister(lanes*, int, int);
+int32_t* laneWord(lanes*, int, uint32_t, bool);
+bool setLaneState(lanes*, int, char*);
+
+/******************************************************************************
+ * Functions
+ */
+
+/**
+ * Lanes for 'prog', one per line of 'stateFile'. A line lists what its lane
+ * starts with besides the program's data, as $register=value and
+ * [address]=value words separated by blanks; '#' starts a comment, and
+ * lines with no words are skipped.
+ */
+lanes* loadLanes(const program *prog, const char *stateFile) {
+	char line[1024];
+	int lineNumber = 0;
+	int32_t k, i;
+	FILE *in = fopen(stateFile, "r");
+	lanes *l = calloc(1, sizeof(lanes));
+
+	if (l == NULL || (l->memory = calloc(MAX_LANES, sizeof(ram))) == NULL) {
+		printf("\n>>>ERROR!\n******Out of host memory for the lanes,"
+				"\n\tFrom: lanes.h @ line %d\n", __LINE__);
+		exit(1);
+	}
+	if (in == NULL) {
+		printf("Lane state file '%s' could not be opened.\n", stateFile);
+		exit(1);
+	}
+	l->prog = prog;
+	for (k = 0; k < MAX_LANES; k++)
+		LANE_ROW(l->pc)[k] = LANE_HALTED;
+
+	while (fgets(line, sizeof(line), in) != NULL) {
+		lineNumber++;
+		char *comment = strchr(line, '#');
+		if (comment != NULL)
+			*comment = '\0';
+		if (strspn(line, " \t\r\n") == strlen(line))
+			continue;
+		if (l->count == MAX_LANES) {
+			printf("\n>>>ERROR!\n******More than %d lanes in * %s *,"
+					"\n\tFrom: lanes.h @ line %d\n", MAX_LANES, stateFile,
+					__LINE__);
+			exit(1);
+		}
+		k = l->count++;
+		LANE_ROW(l->pc)[k] = prog->entry;
+		for (i = 0; i < prog->dataCount; i++)
+			memWrite(&l->memory[k], prog->dataAddr + i, prog->data[i]);
+		if (!setLaneState(l, k, line)) {
+			printf("\n>>>ERROR!\n******Invalid lane state on line %d of"
+					" * %s *\n\tFrom: lanes.h @ line %d\n", lineNumber,
+					stateFile, __LINE__);
+			exit(1);
+		}
+	}
+	fclose(in);
+	l->vectors = (l->count + LANE_WIDTH - 1) / LANE_WIDTH;
+	return l;
+}
+
+/**
+ * Apply the $register=value and [address]=value words of 'line' to lane
+ * 'k'. Returns false on a word that is neither.
+ */
+bool setLaneState(lanes *l, int k, char *line) {
+	char *word, *value, *end;
+	for (word = strtok(line, " \t\r\n"); word != NULL;
+			word = strtok(NULL, " \t\r\n")) {
+		value = strchr(word, '=');
+		if (value == NULL)
+			return false;
+		*value++ = '\0';
+		int32_t v = strtol(value, &end, 0);
+		if (*value == '\0' || *end != '\0')
+			return false;
+
+		if (word[0] == '$') {
+			int reg = regValue(word + 1);
+			if (reg <= 0) //not a register, or $zero
+				return false;
+			LANE_ROW(l->regs[reg])[k] = v;
+		} else if (word[0] == '[' && word[strlen(word) - 1] == ']') {
+			uint32_t addr = strtoul(word + 1, &end, 0);
+			if (*end != ']')
+				return false;
+			memWrite(&l->memory[k], addr, v);
+		} else {
+			return false;
+		}
+	}
+	return true;
+}
+
+void freeLanes(lanes *l) {
+	int k;
+	for (k = 0; k < MAX_LANES; k++)
+		freeMemory(&l->memory[k]);
+	free(l->memory);
+	free(l);
+}
+
+/**
+ * Run every lane until it halts, see the header comment.
+ */
+void runLanes(lanes *l) {
+	const program *prog = l->prog;
+	const instr *inst;
+	lane_vec at, low;
+	lane_mask here;
+	int32_t pc, c, k, n;
+
+	//one vector of lanes, with 'here' the lanes at 'pc'
+#define EACH_VECTOR(...) \
+	for (c = 0; c < l->vectors; c++) { \
+		here = (lane_mask) (l->pc[c] == at); \
+		__VA_ARGS__ \
+		l->counted[c] -= (lane_vec) here; \
+		l->pc[c] -= (lane_vec) here; \
+	}
+	//rd = expr of RS and RT, in the lanes at 'pc' only
+#define RS (l->regs[inst->rs][c])
+#define RT (l->regs[inst->rt][c])
+#define LANE_ALU(expr) EACH_VECTOR( \
+	if (inst->rd != 0) { \
+		lane_vec result = (expr); \
+		l->regs[inst->rd][c] = (result & (lane_vec) here) \
+				| (l->regs[inst->rd][c] & ~(lane_vec) here); \
+	})
+	//the same lane by lane, for loads and stores
+#define EACH_LANE(...) \
+	for (k = 0; k < l->count; k++) { \
+		if (LANE_ROW(l->pc)[k] != (uint32_t) pc) \
+			continue; \
+		__VA_ARGS__ \
+		LANE_ROW(l->counted)[k]++; \
+		LANE_ROW(l->pc)[k]++; \
+	}
+
+	for (;;) {
+		low = l->pc[0];
+		for (c = 1; c < l->vectors; c++)
+			low ^= (low ^ l->pc[c]) & (lane_vec) (l->pc[c] < low);
+		for (pc = low[0], n = 1; n < LANE_WIDTH; n++)
+			if ((int32_t) low[n] < pc)
+				pc = low[n];
+		if (pc == LANE_HALTED)
+			break;
+		if (pc >= prog->count) {
+			printf("\n>>>ERROR!\n******Ran past the end of the program, pc:"
+					" * %d *\n\tFrom: lanes.h @ line %d\n", pc, __LINE__);
+			exit(1);
+		}
+
+		inst = &prog->instructions[pc];
+		at = (lane_vec) { 0 } + pc;
+		if (++l->steps % LANE_FLUSH == 0)
+			flushRetired(l);
+
+		switch (inst->op) {
+		case ADD:
+		case ADDU:
+			LANE_ALU(RS + RT);
+			break;
+		case ADDI:
+		case ADDIU:
+			LANE_ALU(RS + (uint32_t) inst->i);
+			break;
+		case SUB:
+		case SUBU:
+			LANE_ALU(RS - RT);
+			break;
+		case AND:
+			LANE_ALU(RS & RT);
+			break;
+		case ANDI:
+			LANE_ALU(RS & (uint16_t) inst->i);
+			break;
+		case OR:
+			LANE_ALU(RS | RT);
+			break;
+		case ORI:
+			LANE_ALU(RS | (uint16_t) inst->i);
+			break;
+		case NOR:
+			LANE_ALU(~(RS | RT));
+			break;
+		case SLT:
+			LANE_ALU((lane_vec) ((lane_mask) RS < (lane_mask) RT) & 1);
+			break;
+		case SLTI:
+			LANE_ALU((lane_vec) ((lane_mask) RS < inst->i) & 1);
+			break;
+		case SLTU:
+			LANE_ALU((lane_vec) (RS < RT) & 1);
+			break;
+		case SLTIU:
+			LANE_ALU((lane_vec) (RS < (uint32_t) inst->i) & 1);
+			break;
+		case SLL:
+			LANE_ALU(RT << (inst->i & 0x1f));
+			break;
+		case SRL:
+			LANE_ALU(RT >> (inst->i & 0x1f));
+			break;
+		case LUI:
+			LANE_ALU((lane_vec) { 0 } + ((uint32_t) inst->i << 16));
+			break;
+		case MUL:
+		case MULU:
+			LANE_ALU(RS * RT);
+			break;
+		case BEQ:
+		case BNE: {
+			bool outside = pc + inst->i >= prog->count - 1
+					|| pc + 1 + inst->i < 0;
+			EACH_VECTOR(
+				lane_mask equal = (lane_mask) (RS == RT);
+				lane_mask taken = here & (inst->op == BEQ ? equal : ~equal);
+				for (n = 0; outside && n < LANE_WIDTH; n++)
+					if (taken[n] != 0) {
+						printf("\n>>>ERROR!\n******Branched beyond program"
+								" boundaries in lane %d, pc: * %d * and"
+								" instructions: * %d *\n\tFrom: lanes.h @ line"
+								" %d\n", c * LANE_WIDTH + n,
+								pc + 1 + inst->i, prog->count, __LINE__);
+						exit(1);
+					}
+				l->pc[c] += (uint32_t) inst->i & (lane_vec) taken;
+			)
+			break;
+		}
+		case BUBBLE: //no work, nothing retired
+			EACH_VECTOR(l->counted[c] += (lane_vec) here;)
+			break;
+		case HALT: //nor for the halt, and the lanes stay halted
+			for (c = 0; c < l->vectors; c++) {
+				here = (lane_mask) (l->pc[c] == at);
+				l->pc[c] |= LANE_HALTED & (lane_vec) here;
+			}
+			break;
+		default:
+			if (opTable[inst->op].kind == DOES_ALU) { //divides
+				EACH_LANE(
+					if (inst->rd != 0)
+						LANE_ROW(l->regs[inst->rd])[k] = opTable[inst->op]
+								.execute(laneRegister(l, inst->rs, k),
+										laneRegister(l, inst->rt, k), inst->i);
+				)
+			} else if (opTable[inst->op].kind == DOES_LOAD) {
+				if (!isAligned(inst))
+					goto misaligned;
+				EACH_LANE(
+					int32_t *word = laneWord(l, k, wordAddress(inst,
+							laneRegister(l, inst->rs, k)), false);
+					if (inst->rd != 0)
+						LANE_ROW(l->regs[inst->rd])[k] = word == NULL ? 0 :
+								loadValue(inst, *word);
+				)
+			} else if (opTable[inst->op].kind == DOES_STORE) {
+				if (!isAligned(inst))
+					goto misaligned;
+				EACH_LANE(
+					int32_t *word = laneWord(l, k, wordAddress(inst,
+							laneRegister(l, inst->rs, k)), true);
+					*word = storeValue(inst, *word,
+							laneRegister(l, inst->rt, k));
+					//sc always succeeds
+					if ((opTable[inst->op].roles & WRITES_RD) && inst->rd != 0)
+						LANE_ROW(l->regs[inst->rd])[k] = 1;
+				)
+			} else if (opTable[inst->op].kind == DOES_JUMP) {
+				EACH_LANE(
+					int32_t target = controlTarget(inst, pc,
+							laneRegister(l, inst->rs, k), 0);
+					if (target < 0 || target >= prog->count) {
+						printf("\n>>>ERROR!\n******Branched beyond program"
+								" boundaries in lane %d, pc: * %d * and"
+								" instructions: * %d *\n\tFrom: lanes.h @ line"
+								" %d\n", k, target, prog->count,
+								__LINE__);
+						exit(1);
+					}
+					if (inst->rd != 0) //jal links the next pc
+						LANE_ROW(l->regs[inst->rd])[k] = pc + 1;
+					LANE_ROW(l->pc)[k] = target - 1; //counted on below
+				)
+			} else {
+				printf("\n>>>ERROR!\n******Unrecognized Operation,"
+						"\n\tFrom: lanes.h @ line %d\n", __LINE__);
+				exit(1);
+			}
+			break;
+		}
+	}
+	flushRetired(l);
+	return;
+
+	misaligned:
+	printf("\n>>>ERROR!\n******Memory Misaligned/Access,"
+			"\n\tFrom: lanes.h @ line %d\n", __LINE__);
+	exit(1);
+
+#undef EACH_VECTOR
+#undef RS
+#undef RT
+#undef LANE_ALU
+#undef EACH_LANE
+}
+
+/**
+ * Move the lanes' 32-bit retired counts into their 64-bit totals.
+ */
+void flushRetired(lanes *l) {
+	int32_t k;
+	for (k = 0; k < l->count; k++)
+		l->retired[k] += LANE_ROW(l->counted)[k];
+	memset(l->counted, 0, sizeof(l->counted));
+}
+
+/**
+ * Register 'reg' of lane 'k'.
+ */
+int32_t laneRegister(lanes *l, int reg, int k) {
+	return LANE_ROW(l->regs[reg])[k];
+}
+
+/**
+ * The word at word address 'addr' in lane 'k's RAM, through the lane's last
+ * page; as findPage, NULL for a missing page unless 'allocate' is set.
+ */
+int32_t* laneWord(lanes *l, int k, uint32_t addr, bool allocate) {
+	uint32_t pageNumber = addr >> PAGE_BITS;
+	if (l->lastPage[k] == NULL || pageNumber != l->lastPageNumber[k]) {
+		mem_page *page = findPage(&l->memory[k], addr, allocate);
+		if (page == NULL)
+			return NULL;
+		l->lastPage[k] = page;
+		l->lastPageNumber[k] = pageNumber;
+	}
+	return &l->lastPage[k]->words[addr & (PAGE_WORDS - 1)];
+}
+
+#endif /* LANES_H_ */
@@ -0,0 +1,596 @@
+/*
+ * ooo.h
+ *
+ *  Created on: Oct 18, 2026
+ *
+ *  Out-of-order timing model in the style of Tomasulo's algorithm with a
+ *  reorder buffer:
+ *    fetch:    the superscalar front end (groupIF), 'issueWidth' wide
+ *    dispatch: in order, into a reorder buffer (ROB) entry and a
+ *              reservation station of the instruction's unit class. Source
+ *              registers are renamed to the ROB entries producing them.
+ *    execute:  oldest ready first, out of order. 'issueWidth' ALUs and one
+ *              MUL unit for multiplies and divides, none pipelined, each
+ *              op taking its latency from 'opTable'. Loads and stores
+ *              first take EX_CLOCK_WAIT cycles to form their address; a
+ *              load then reads memory (one access may start per cycle, any
+ *              number may be in flight) once every older store knows its
+ *              address, or takes the value straight from the youngest
+ *              older store to the same word when that one wrote all of it.
+ *    commit:   in order from the ROB head, the WB of this model: registers
+ *              are written and stores reach memory only here.
+ *  Results are broadcast to the waiting stations as soon as they are done.
+ *  Branches resolve when they execute; a mispredicted one flushes every
+ *  younger instruction and restarts fetch on the right path.
+ *
+ *  The window sizes (ROB entries and stations per class) are configurable.
+ *  Statistics give IPC, ROB occupancy and why dispatch and commit stalled.
+ *
+ *  REFERENCES: see projmain.c header comment.
+ */
+
+#ifndef OOO_H_
+#define OOO_H_
+
+#include "superscalar.h"
+
+/******************************************************************************
+ * Constants/Definitions
+ */
+//the unit classes are in instruction.h, with the opcodes that use them
+#define UNIT_NONE -1 //the halt, done as soon as it is dispatched
+
+#define MAX_ROB_SIZE 4096
+
+//why nothing was dispatched in a cycle, after the unit classes' reasons
+#define STALL_FETCH 3 //fetch buffer empty
+#define STALL_ROB 4 //reorder buffer full
+#define DISPATCH_STALLS 5
+
+//what the oldest instruction was still waiting for when nothing committed
+#define WAIT_ALU 0
+#define WAIT_MUL 1
+#define WAIT_LOAD 2
+#define WAIT_STORE 3
+#define WAIT_EMPTY 4 //nothing in the ROB at all
+#define COMMIT_STALLS 5
+
+/******************************************************************************
+ * Global Vars and Structs
+ */
+typedef struct ooo_config_tag {
+	int32_t robSize;
+	int32_t stations[UNIT_CLASSES]; //reservation stations per unit class
+} ooo_config;
+
+typedef struct rob_entry_tag {
+	instr inst;
+	int32_t pc;
+	int32_t predictedPc;
+	int unit;
+	int32_t station; //index in its class, -1 once it has left it
+	bool done;
+	int32_t value; //result
+	int32_t stored; //the data of a store
+	uint32_t addr; //word address of a load or store
+} rob_entry;
+
+typedef struct station_tag {
+	bool busy;
+	bool executing;
+	int32_t rob; //the ROB entry it holds
+	int32_t vj; //source values, valid once their tag is -1
+	int32_t vk;
+	int32_t qj; //ROB entries still producing them
+	int32_t qk;
+	int32_t cycles;
+	int32_t latency;
+	int phase; //loads: 0 forming the address, 1 accessing memory
+} station;
+
+typedef struct ooo_core_tag {
+	ooo_config config;
+	rob_entry *rob; //circular, 'count' entries from 'head'
+	int32_t head;
+	int32_t count;
+	int32_t renameMap[32]; //ROB entry that will write each register, or -1
+	station *stations[UNIT_CLASSES];
+
+	//counters for the statistics
+	int64_t occupancy; //ROB entries in use, summed over every cycle
+	int32_t occupancyMax;
+	int32_t dispatchStalls[DISPATCH_STALLS];
+	int32_t commitStalls[COMMIT_STALLS];
+	int32_t flushes;
+} ooo_core;
+
+const ooo_config defaultOooConfig = { 32, { 8, 4, 8 } };
+
+const char *unitNames[UNIT_CLASSES] = { "alu", "mul", "mem" };
+
+/******************************************************************************
+ * Function Prototypes
+ */
+bool parseOooConfig(const char*, ooo_config*);
+void enableOutOfOrder(machine*, const ooo_config*);
+size_t coreSize(const ooo_config*);
+void placeCoreArrays(ooo_core*);
+void runOutOfOrder(machine*);
+void oooCommit(machine*);
+void oooExecute(machine*);
+bool oooStart(machine*, int32_t, station*, int*, bool*);
+void oooFinish(machine*, int32_t, station*);
+void oooFlush(machine*, int32_t);
+void oooDispatch(machine*);
+int unitClass(instr*);
+void readOperand(machine*, int8_t, int32_t*, int32_t*);
+
+/******************************************************************************
+ * Functions
+ */
+
+/**
+ * Read the window sizes from a command line spec: "on" for the defaults,
+ * or "rob:alu:mul:mem" (ROB entries, then stations per class); trailing
+ * numbers may be left out. Returns false for a spec that makes no sense.
+ */
+bool parseOooConfig(const char *spec, ooo_config *config) {
+	int32_t *fields[] = { &config->robSize, &config->stations[UNIT_ALU],
+			&config->stations[UNIT_MUL], &config->stations[UNIT_MEM] };
+	char *end;
+	int n;
+
+	*config = defaultOooConfig;
+	if (strcmp(spec, "on") == 0)
+		return true;
+	for (n = 0; n < 4; n++) {
+		long value = strtol(spec, &end, 10);
+		if (end == spec || value < 1 || value > MAX_ROB_SIZE)
+			return false;
+		*fields[n] = value;
+		if (*end == '\0')
+			return true;
+		if (*end != ':')
+			return false;
+		spec = end + 1;
+	}
+	return false;
+}
+
+/**
+ * Run the machine as an out-of-order core with windows sized by 'config'.
+ * Everything lives in one block, so freeMachine() can simply free it.
+ */
+void enableOutOfOrder(machine *m, const ooo_config *config) {
+	ooo_core *c = calloc(1, coreSize(config));
+	int r;
+
+	if (c == NULL) {
+		printf("\n>>>ERROR!\n******Out of host memory for the out-of-order"
+				" core,\n\tFrom: ooo.h @ line %d\n", __LINE__);
+		exit(1);
+	}
+	c->config = *config;
+	placeCoreArrays(c);
+	for (r = 0; r < 32; r++)
+		c->renameMap[r] = -1;
+
+	m->core = c;
+	if (m->issueWidth == 0)
+		m->issueWidth = 1;
+}
+
+/**
+ * Bytes of the block holding a core: the ooo_core itself, then its ROB,
+ * then the stations of each class.
+ */
+size_t coreSize(const ooo_config *config) {
+	size_t bytes = sizeof(ooo_core) + config->robSize * sizeof(rob_entry);
+	int u;
+	for (u = 0; u < UNIT_CLASSES; u++)
+		bytes += config->stations[u] * sizeof(station);
+	return bytes;
+}
+
+/**
+ * Point a core's arrays into the rest of its block.
+ */
+void placeCoreArrays(ooo_core *c) {
+	uint8_t *block = (uint8_t*) c + sizeof(ooo_core);
+	int u;
+
+	c->rob = (rob_entry*) block;
+	block += c->config.robSize * sizeof(rob_entry);
+	for (u = 0; u < UNIT_CLASSES; u++) {
+		c->stations[u] = (station*) block;
+		block += c->config.stations[u] * sizeof(station);
+	}
+}
+
+/**
+ * Clock the core until the halt commits, or the clock reaches 'stopClock'.
+ * Like runPipeline(), the stages go from the back of the machine to the
+ * front.
+ */
+void runOutOfOrder(machine *m) {
+	ooo_core *c = m->core;
+	while (!m->allWorkCompleted && !clockStopped(m)) {
+		oooCommit(m);oooExecute(m);oooDispatch(m);groupIF(m);
+		c->occupancy += c->count;
+		if (c->count > c->occupancyMax)
+			c->occupancyMax = c->count;
+		m->clocks++;
+	}
+}
+
+/**
+ * Retire up to 'issueWidth' finished instructions from the ROB head.
+ */
+void oooCommit(machine *m) {
+	ooo_core *c = m->core;
+	int n;
+
+	for (n = 0; n < m->issueWidth && c->count > 0; n++) {
+		rob_entry *e = &c->rob[c->head];
+		if (!e->done)
+			break;
+		TRACE_RETIRE(m, e->pc, e->inst.op,
+				writesRegister(&e->inst) ? e->inst.rd : 0, e->value, e->addr);
+		if (isHalt(&e->inst)) {
+			m->allWorkCompleted = true; //halt execution, end program
+			n++;
+			break;
+		}
+		checkRunOff(m, e->pc, &e->inst);
+		if (writesRegister(&e->inst)) {
+			m->regs[e->inst.rd] = e->value;
+			if (c->renameMap[e->inst.rd] == c->head)
+				c->renameMap[e->inst.rd] = -1;
+		}
+		if (opTable[e->inst.op].kind == DOES_STORE) {
+			//through the store buffer, no waiting
+			int32_t word = opTable[e->inst.op].size < 4 ?
+					memRead(&m->memory, e->addr) : 0;
+			dataAccessTime(m, e->addr, true);
+			memWrite(&m->memory, e->addr,
+					storeValue(&e->inst, word, e->stored));
+			DEBUG_ACCESS(m, e->pc, e->addr, true);
+		} else if (opTable[e->inst.op].kind == DOES_LOAD) {
+			//watched at commit, so loads on a wrong path do not stop
+			DEBUG_ACCESS(m, e->pc, e->addr, false);
+		}
+		m->retiredOps[e->inst.op]++;
+		m->retiredInstructions++;
+		c->head = (c->head + 1) % c->config.robSize;
+		c->count--;
+	}
+
+	//the commit stalls double as the CPI stack
+	if (n > 0) {
+		m->usageWB++;
+		m->cpiStack[CPI_BASE]++;
+	} else if (c->count == 0) {
+		c->commitStalls[WAIT_EMPTY]++;
+		m->cpiStack[CPI_FETCH]++;
+	} else {
+		instr *oldest = &c->rob[c->head].inst;
+		op_kind kind = opTable[oldest->op].kind;
+		c->commitStalls[kind == DOES_LOAD ? WAIT_LOAD :
+						kind == DOES_STORE ? WAIT_STORE :
+						opTable[oldest->op].unit == UNIT_MUL ?
+								WAIT_MUL : WAIT_ALU]++;
+		m->cpiStack[isMemoryAccess(oldest) ? CPI_MEMORY : CPI_EXECUTE]++;
+	}
+}
+
+/**
+ * Advance everything executing, then start whatever is ready, oldest
+ * first, on the units left free.
+ */
+void oooExecute(machine *m) {
+	ooo_core *c = m->core;
+	int busy[UNIT_CLASSES] = { 0 };
+	bool portUsed = false, memoryBusy = false;
+	int32_t i;
+
+	for (i = 0; i < c->count; i++) {
+		int32_t index = (c->head + i) % c->config.robSize;
+		rob_entry *e = &c->rob[index];
+		if (e->station < 0)
+			continue;
+		station *s = &c->stations[e->unit][e->station];
+		if (!s->executing)
+			continue;
+		if (e->unit == UNIT_MEM && s->phase == 1)
+			memoryBusy = true;
+		if (++s->cycles < s->latency) {
+			busy[e->unit]++;
+			continue;
+		}
+		oooFinish(m, index, s); //may flush everything younger
+	}
+
+	for (i = 0; i < c->count; i++) {
+		int32_t index = (c->head + i) % c->config.robSize;
+		rob_entry *e = &c->rob[index];
+		if (e->station < 0)
+			continue;
+		station *s = &c->stations[e->unit][e->station];
+		if (!s->executing && oooStart(m, index, s, busy, &portUsed)
+				&& e->unit == UNIT_MEM && s->phase == 1)
+			memoryBusy = true;
+	}
+
+	if (busy[UNIT_ALU] + busy[UNIT_MUL] + busy[UNIT_MEM] > 0)
+		m->usageEX++;
+	if (memoryBusy)
+		m->usageMEM++;
+}
+
+/**
+ * Start the instruction in station 's' if its operands and a unit are
+ * ready. Returns whether it started.
+ */
+bool oooStart(machine *m, int32_t index, station *s, int *busy,
+		bool *portUsed) {
+	ooo_core *c = m->core;
+	rob_entry *e = &c->rob[index];
+	int32_t i;
+
+	if (s->qj >= 0 || s->qk >= 0)
+		return false;
+
+	switch (e->unit) {
+	case UNIT_ALU:
+		if (busy[UNIT_ALU] >= m->issueWidth)
+			return false;
+		s->latency = exLatency(&e->inst);
+		break;
+	case UNIT_MUL:
+		if (busy[UNIT_MUL] >= 1)
+			return false;
+		s->latency = exLatency(&e->inst);
+		break;
+	default:
+		if (s->phase == 0) { //the address generator of its own station
+			s->latency = EX_CLOCK_WAIT;
+			break;
+		}
+		//every older store must know its address first
+		int32_t forward = -1;
+		for (i = (index - c->head + c->config.robSize) % c->config.robSize;
+				i > 0; i--) {
+			rob_entry *older = &c->rob[(c->head + i - 1) % c->config.robSize];
+			if (opTable[older->inst.op].kind != DOES_STORE)
+				continue;
+			if (!older->done)
+				return false;
+			if (forward < 0 && older->addr == e->addr) {
+				//part of a word has to be merged in memory first
+				if (opTable[older->inst.op].size < 4)
+					return false;
+				forward = (c->head + i - 1) % c->config.robSize;
+			}
+		}
+		if (forward >= 0) { //store to load forwarding
+			s->vk = c->rob[forward].stored;
+			s->latency = 1;
+		} else {
+			if (*portUsed)
+				return false;
+			*portUsed = true;
+			s->vk = memRead(&m->memory, e->addr);
+			s->latency = dataAccessTime(m, e->addr, false);
+		}
+		break;
+	}
+	s->executing = true;
+	s->cycles = 0;
+	busy[e->unit]++;
+	return true;
+}
+
+/**
+ * The instruction in station 's' has finished its latency: produce its
+ * result, broadcast it to the stations waiting on it and free the station.
+ */
+void oooFinish(machine *m, int32_t index, station *s) {
+	ooo_core *c = m->core;
+	rob_entry *e = &c->rob[index];
+	uint32_t vj = s->vj, vk = s->vk;
+	int u, n;
+
+	s->executing = false;
+	const op_info *info = &opTable[e->inst.op];
+	switch (info->kind) {
+	case DOES_ALU:
+		e->value = info->execute(vj, vk, e->inst.i);
+		break;
+	case DOES_LOAD:
+		if (s->phase == 0) { //address ready, the memory access is next
+			if (!isAligned(&e->inst))
+				goto misaligned;
+			e->addr = wordAddress(&e->inst, vj);
+			s->phase = 1;
+			return;
+		}
+		//read when the access started, see oooStart()
+		e->value = loadValue(&e->inst, vk);
+		break;
+	case DOES_STORE:
+		if (!isAligned(&e->inst))
+			goto misaligned;
+		e->addr = wordAddress(&e->inst, vj);
+		e->stored = vk;
+		//sc always succeeds; for other stores the value is for the trace
+		e->value = writesRegister(&e->inst) ? 1 : vk;
+		break;
+	case DOES_BRANCH:
+	case DOES_JUMP: {
+		int32_t nextPc = controlTarget(&e->inst, e->pc, vj, vk);
+		if (nextPc >= m->prog->count || nextPc < 0) {
+			printf("\n>>>ERROR!\n******Branched beyond program boundaries,"
+					" pc: * %d * and instructions: * %d *\n\tFrom: ooo.h"
+					" @ line %d\n", nextPc, m->prog->count, __LINE__);
+			exit(1);
+		}
+		if (info->roles & WRITES_RD) //jal links the next pc
+			e->value = e->pc + 1;
+		if (m->branchPredictor == NULL) {
+			m->pc = nextPc;
+			m->branchWaiting = false;
+		} else if (resolvePrediction(m->branchPredictor, &m->bp, e->pc,
+				&e->inst, e->predictedPc, nextPc)) {
+			oooFlush(m, index);
+			m->pc = nextPc;
+			m->squashFetch = true;
+		}
+		break;
+	}
+	default: //a bubble does nothing
+		break;
+	}
+
+	e->done = true;
+	s->busy = false;
+	e->station = -1;
+	for (u = 0; u < UNIT_CLASSES; u++)
+		for (n = 0; n < c->config.stations[u]; n++) {
+			station *waiting = &c->stations[u][n];
+			if (!waiting->busy)
+				continue;
+			if (waiting->qj == index) {
+				waiting->vj = e->value;
+				waiting->qj = -1;
+			}
+			if (waiting->qk == index) {
+				waiting->vk = e->value;
+				waiting->qk = -1;
+			}
+		}
+	return;
+
+	misaligned:
+	printf("\n>>>ERROR!\n******Memory Misaligned/Access,"
+			"\n\tFrom: ooo.h @ line %d\n", __LINE__);
+	exit(1);
+}
+
+/**
+ * Throw away every instruction younger than ROB entry 'index' and the
+ * fetch buffer, and rebuild the rename map from what is left.
+ */
+void oooFlush(machine *m, int32_t index) {
+	ooo_core *c = m->core;
+	int32_t keep = (index - c->head + c->config.robSize) % c->config.robSize
+			+ 1;
+	int32_t i;
+
+	for (i = keep; i < c->count; i++) {
+		rob_entry *e = &c->rob[(c->head + i) % c->config.robSize];
+		if (e->station >= 0)
+			c->stations[e->unit][e->station].busy = false;
+	}
+	c->count = keep;
+	for (i = 0; i < 32; i++)
+		c->renameMap[i] = -1;
+	for (i = 0; i < c->count; i++) {
+		int32_t kept = (c->head + i) % c->config.robSize;
+		if (writesRegister(&c->rob[kept].inst))
+			c->renameMap[c->rob[kept].inst.rd] = kept;
+	}
+
+	m->fetchCount = 0;
+	m->haltFetched = false;
+	c->flushes++;
+}
+
+/**
+ * Move up to 'issueWidth' instructions, in order, from the fetch buffer
+ * into the ROB and their reservation stations.
+ */
+void oooDispatch(machine *m) {
+	ooo_core *c = m->core;
+	int n, reason = STALL_FETCH;
+
+	for (n = 0; n < m->issueWidth; n++) {
+		if (m->fetchCount == 0) {
+			reason = STALL_FETCH;
+			break;
+		}
+		if (c->count == c->config.robSize) {
+			reason = STALL_ROB;
+			break;
+		}
+		latch *slot = &m->fetchBuffer[0];
+		int unit = unitClass(&slot->inst);
+		int32_t free = -1;
+		if (unit != UNIT_NONE) {
+			for (free = 0; free < c->config.stations[unit]; free++)
+				if (!c->stations[unit][free].busy)
+					break;
+			if (free == c->config.stations[unit]) {
+				reason = unit;
+				break;
+			}
+		}
+
+		int32_t index = (c->head + c->count++) % c->config.robSize;
+		rob_entry *e = &c->rob[index];
+		e->inst = slot->inst;
+		e->pc = slot->pc;
+		e->predictedPc = slot->predictedPc;
+		e->unit = unit;
+		e->station = free;
+		e->done = unit == UNIT_NONE;
+		if (unit != UNIT_NONE) {
+			station *s = &c->stations[unit][free];
+			memset(s, 0, sizeof(station));
+			s->busy = true;
+			s->rob = index;
+			s->qj = s->qk = -1;
+			if (readsRegister(&e->inst, e->inst.rs))
+				readOperand(m, e->inst.rs, &s->vj, &s->qj);
+			if (readsRegister(&e->inst, e->inst.rt))
+				readOperand(m, e->inst.rt, &s->vk, &s->qk);
+		}
+		if (writesRegister(&e->inst))
+			c->renameMap[e->inst.rd] = index;
+
+		m->fetchCount--;
+		memmove(m->fetchBuffer, m->fetchBuffer + 1,
+				m->fetchCount * sizeof(latch));
+	}
+
+	if (n > 0)
+		m->usageID++;
+	else
+		c->dispatchStalls[reason]++;
+}
+
+/**
+ * Which reservation stations an instruction goes to.
+ */
+int unitClass(instr *inst) {
+	if (isHalt(inst))
+		return UNIT_NONE;
+	return opTable[inst->op].unit;
+}
+
+/**
+ * Rename a source register: its value if it is final or already computed,
+ * otherwise the tag of the ROB entry that will produce it.
+ */
+void readOperand(machine *m, int8_t reg, int32_t *value, int32_t *tag) {
+	ooo_core *c = m->core;
+	int32_t producer = c->renameMap[reg];
+	if (producer < 0) {
+		*value = m->regs[reg];
+	} else if (c->rob[producer].done) {
+		*value = c->rob[producer].value;
+	} else {
+		*tag = producer;
+	}
+}
+
+#endif /* OOO_H_ */
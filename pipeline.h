@@ -21,6 +21,8 @@
 #define PIPELINE_H_
 
 #include "instruction.h"
+#include "predictor.h"
+#include "ram.h"
 
 /******************************************************************************
  * Constants/Definitions
@@ -28,6 +30,37 @@
 #define LW_CLOCK_WAIT 100 //simulation of load word time to process
 #define MAX_LINE_LENGTH 256
 #define MAX_LENGTH 32
+#define MAX_ISSUE_WIDTH 4 //widest superscalar mode
+#define STAGES 5
+//stage numbers, e.g. the rows of 'slotUsage'
+#define STAGE_IF 0
+#define STAGE_ID 1
+#define STAGE_EX 2
+#define STAGE_MEM 3
+#define STAGE_WB 4
+//why a stage held work it could not finish or pass on, the columns of
+//'stalls'
+#define CAUSE_BRANCH 0 //IF frozen until EX resolves a branch
+#define CAUSE_FETCH 1 //IF waiting on the instruction cache
+#define CAUSE_HAZARD 2 //ID holding an instruction back for its operands
+#define CAUSE_EXECUTE 3 //EX busy with a multi-cycle operation
+#define CAUSE_MEMORY 4 //MEM waiting on a load or store
+#define CAUSE_FULL 5 //the work is done, but the next latch is still full
+#define CAUSES 6
+//the parts of the CPI stack: each cycle goes to what the oldest
+//instruction in flight is doing
+#define CPI_BASE 0 //retiring
+#define CPI_DEPTH 1 //its single cycle in a stage, e.g. ID
+#define CPI_FETCH 2 //nothing in flight past IF
+#define CPI_BRANCH 3 //a branch in EX, with IF frozen behind it
+#define CPI_HAZARD 4 //waiting in ID for an operand
+#define CPI_EXECUTE 5 //in EX
+#define CPI_MEMORY 6 //a load or store in MEM
+#define CPI_PARTS 7
+#define OPCODES (HALT + 1)
+
+#include "cache.h" //its timings build on LW_CLOCK_WAIT
+#include "trace.h" //needs STAGES
 
 /******************************************************************************
  * Global Vars and Structs
@@ -41,6 +74,8 @@ typedef struct latch_tag {
 	bool valid;
 	bool readyToWork;
 	instr inst;
+	int32_t pc; //where 'inst' was fetched from
+	int32_t predictedPc; //where IF went on fetching after it
 } latch;
 
 //same as latch, but with a data field for propagating data through pipeline
@@ -49,68 +84,284 @@ typedef struct _data_latch_tag {
 	bool readyToWork;
 	int32_t data;
 	instr inst;
+	int32_t pc;
+	uint32_t addr; //word address of a load or store, once MEM has it
 } d_latch;
 
+//the instructions moving through a stage together in superscalar mode,
+//in program order
+typedef struct issue_group_tag {
+	int count;
+	instr inst[MAX_ISSUE_WIDTH];
+	int32_t pc[MAX_ISSUE_WIDTH];
+	int32_t data[MAX_ISSUE_WIDTH];
+	uint32_t addr[MAX_ISSUE_WIDTH]; //word address of a load or store
+	int32_t cycles; //spent in the current stage so far
+	int32_t latency; //cycles the current stage takes, 0 until it starts
+} issue_group;
+
+instr bubble = { BUBBLE, 0, 0, 0, 0 };
+
+/*
+ * Everything that makes up one simulation, so many of them can run in the
+ * same process. Machines only share the program they run, read only.
+ */
+typedef struct machine_tag {
+	const program *prog;
+	int32_t pc;
+	//the register file representing each MIPS register and holding their contents
+	int32_t regs[32];
+	//the main RAM memory, aka 'data memory'
+	ram memory;
+
+	//go-between latches for pipeline STAGE-TO-STAGE - 'connections'
+	latch IF_ID;
+	latch ID_EX;
+	//data latches simply add 'data' fields to their structs to move data
+	d_latch EX_MEM;
+	d_latch MEM_WB;
+
+	uint32_t offsetSW; //to save the calculated offset for the 'sw' instr
+	uint32_t offsetLW; //to save the calculated offset for the 'lw' instr
+	//artificial cycles to represent how long EX and MEM take
+	int exCycles;
+	int memCycles;
+	//cycles the current fetch and load/store take, 0 until they start
+	int32_t fetchLatency;
+	int32_t memLatency;
+	int32_t fetchCycles; //cycles IF has waited on the current fetch
+	bool branchWaiting;
+	bool squashFetch; //ID found a misprediction, drop this cycle's fetch
+	bool allWorkCompleted; //when halt goes through pipeline
+
+	//counter for how many clock cycles the program uses
+	int32_t clocks;
+	//counters to calculate the utilization ratio of each pipeline stage
+	int32_t usageIF;
+	int32_t usageID;
+	int32_t usageEX;
+	int32_t usageMEM;
+	int32_t usageWB;
+	int32_t squashedFetches;
+	//counter for how many instructions the functional engine completed
+	int64_t retiredInstructions;
+	//the same by opcode, for the pipelines
+	int64_t retiredOps[OPCODES];
+	//cycles each stage stalled, by cause
+	int32_t stalls[STAGES][CAUSES];
+	//cycles charged to each part of the CPI stack, they add up to 'clocks'
+	int32_t cpiStack[CPI_PARTS];
+
+	//feed EX_MEM/MEM_WB results straight into EX instead of waiting for WB
+	bool forwarding;
+	//jump the clock over cycles in which no stage can change state
+	bool eventDriven;
+	//the run functions return once the clock gets here, 0 for never
+	int32_t stopClock;
+	//functional runs translate blocks entered this often, 0 for never
+	int32_t jitThreshold;
+	int32_t jitBlocks; //blocks the last functional run translated
+	//resolve branches in ID behind this predictor, NULL to freeze IF
+	const predictor *branchPredictor;
+	bp_state bp;
+	//superscalar mode, see superscalar.h; 0 runs the scalar pipeline
+	int issueWidth;
+	latch fetchBuffer[2 * MAX_ISSUE_WIDTH]; //fetched, waiting to issue
+	int fetchCount;
+	bool haltFetched;
+	issue_group issued; //between ID and EX
+	issue_group executed; //between EX and MEM
+	issue_group accessed; //between MEM and WB
+	//cycles each slot of each stage held an instruction
+	int32_t slotUsage[STAGES][MAX_ISSUE_WIDTH];
+	//cycles ID issued 0, 1, ... instructions
+	int32_t issueCounts[MAX_ISSUE_WIDTH + 1];
+	//issue groups cut short by a dependency inside the group, or by a
+	//second load/store wanting the single memory port
+	int32_t splitDependency;
+	int32_t splitMemoryPort;
+	//out-of-order mode when set, see ooo.h
+	struct ooo_core_tag *core;
 
-int32_t offsetSW = 0; //to save the calculated offset for the 'sw' instr
-int32_t offsetLW = 0; //to save the calculated offset for the 'lw' instr
-//counter for how many clock cycles the program uses
-int32_t clocks = 0;
-//counters to calculate the utilization ratio of each pipeline stage
-int32_t usageIF = 0;
-int32_t usageID = 0;
-int32_t usageEX = 0;
-int32_t usageMEM = 0;
-int32_t usageWB = 0;
-//the main RAM memory, aka 'data memory'
-int32_t RAM[512];
-//the register file representing each MIPS register and holding their contents
-int32_t regs[32];
-
-bool branchWaiting = false;
-bool allWorkCompleted = false; //when halt goes through pipeline
-
-instr bubble = { B, BUBBLE, 0, 0, 0, 0, false };
-//go-between latches for pipeline STAGE-TO-STAGE - 'connections'
-latch IF_ID = { .readyToWork = false };
-latch ID_EX = { .readyToWork = false };
-//data latches simply add 'data' fields to their structs to move data
-d_latch EX_MEM = { .readyToWork = false };
-d_latch MEM_WB = { .readyToWork = false };
+	//instruction and data caches in front of a unified L2, off by default
+	bool cachesEnabled;
+	cache l1i;
+	cache l1d;
+	cache l2;
+#ifdef TRACE
+	struct tracer_tag *trace; //NULL when not tracing, see trace.h
+#endif
+#ifdef DEBUGGER
+	struct debugger_tag *debug; //NULL when not debugging, see debugger.h
+#endif
+} machine;
+
+#include "debugger.h" //its hooks take the machine
+
+const char *causeNames[CAUSES] = { "branch", "fetch", "hazard", "execute",
+		"memory", "full" };
+
+const char *cpiNames[CPI_PARTS] = { "base", "depth", "fetch", "branch",
+		"hazard", "execute", "memory" };
 
 /******************************************************************************
  * Function Prototypes
  */
 //Pipeline Stage declarations
-void IF();
-void ID();
-void EX();
-void MEM();
-void WB();
+void IF(machine*);
+void ID(machine*);
+void EX(machine*);
+void MEM(machine*);
+void WB(machine*);
 
-int isHazard();
+void initMachine(machine*, const program*);
+void enableCaches(machine*, const cache_config*);
+void freeMachine(machine*);
+void runPipeline(machine*);
+bool clockStopped(machine*);
+int32_t quietCycles(machine*);
+void skipCycles(machine*, int32_t);
+int exLatency(instr*);
+int32_t instrAccessTime(machine*, int32_t);
+int32_t dataAccessTime(machine*, uint32_t, bool);
+bool passesThroughEX(machine*, instr*);
+void countStall(machine*, int, int, int32_t);
+int cpiPart(machine*);
+bool isBubble(instr*);
+
+int isHazard(machine*);
+int isLoadUseHazard(machine*);
+int isBranchHazard(machine*);
+void resolveBranch(machine*);
+bool writesRegister(instr*);
+int32_t forwardOperand(machine*, int8_t);
 
 /******************************************************************************
  * Functions
  */
 
+/**
+ * Set up a machine with an empty pipeline, ready to run 'prog' from its
+ * entry point: registers cleared and RAM holding only the program's data.
+ */
+void initMachine(machine *m, const program *prog) {
+	uint32_t i;
+	memset(m, 0, sizeof(machine));
+	m->prog = prog;
+	m->pc = prog->entry;
+	m->eventDriven = true;
+	for (i = 0; i < prog->dataCount; i++)
+		memWrite(&m->memory, prog->dataAddr + i, prog->data[i]);
+}
+
+/**
+ * Put caches configured by 'configs' (L1I, L1D, L2) in front of RAM, so
+ * fetches and loads/stores take as long as the hierarchy says instead of
+ * a fixed time. Call before running the machine.
+ */
+void enableCaches(machine *m, const cache_config *configs) {
+	initCache(&m->l2, &configs[2], NULL);
+	initCache(&m->l1i, &configs[0], &m->l2);
+	initCache(&m->l1d, &configs[1], &m->l2);
+	m->cachesEnabled = true;
+}
+
+/**
+ * Give back what the machine allocated while it ran.
+ */
+void freeMachine(machine *m) {
+	freeMemory(&m->memory);
+	free(m->core);
+#ifdef TRACE
+	if (m->trace != NULL)
+		closeTrace(m->trace);
+#endif
+#ifdef DEBUGGER
+	if (m->debug != NULL)
+		detachDebugger(m->debug);
+#endif
+	if (m->cachesEnabled) {
+		freeCache(&m->l1i);
+		freeCache(&m->l1d);
+		freeCache(&m->l2);
+	}
+}
+
+/**
+ * Clock the pipeline until the halt instruction has been written back, or
+ * the clock reaches 'stopClock'. The stages are iterated in reverse, so
+ * each one sees the latch contents its successor left behind in the same
+ * cycle.
+ */
+void runPipeline(machine *m) {
+	int32_t skip;
+	while (!m->allWorkCompleted && !clockStopped(m)) {
+		if (m->eventDriven && (skip = quietCycles(m)) > 0) {
+			if (m->stopClock > 0 && skip > m->stopClock - m->clocks)
+				skip = m->stopClock - m->clocks;
+			skipCycles(m, skip);
+			continue;
+		}
+		m->cpiStack[cpiPart(m)]++;
+		WB(m);MEM(m);EX(m);ID(m);IF(m);
+		m->clocks++;
+	}
+}
+
+/**
+ * Has the clock reached the cycle the run was asked to stop at?
+ */
+bool clockStopped(machine *m) {
+	return m->stopClock > 0 && m->clocks >= m->stopClock;
+}
+
 /**
  * Instruction Fetch, represents the instruction register (ir) or instruction
  * memory (im).  The first pipeline stage, that retrieves the instruction then
  * passes it on to the second stage: ID
  */
-void IF() {
-	if (!branchWaiting) {
-		if (!IF_ID.valid) {
-			IF_ID.valid = true;
-			IF_ID.inst = instructions[pc];
-			if (pc < haltIndex)
-				pc++;
-			usageIF++;
-			if (!IF_ID.readyToWork)
-				IF_ID.readyToWork = true;
+void IF(machine *m) {
+	if (m->squashFetch) { //the wrong path fetch of this cycle is thrown away
+		m->squashFetch = false;
+		m->squashedFetches++;
+		m->fetchLatency = 0;
+		m->fetchCycles = 0;
+	} else if (!m->branchWaiting) {
+		if (!m->IF_ID.valid) {
+			if (m->pc < 0 || m->pc >= m->prog->count) {
+				printf("\n>>>ERROR!\n******Fetched beyond program boundaries,"
+						" pc: * %d * and instructions: * %d *\n\tFrom: pipeline.h"
+						" @ line %d\n", m->pc, m->prog->count, __LINE__);
+				exit(1);
+			}
+			if (m->fetchLatency == 0)
+				m->fetchLatency = instrAccessTime(m, m->pc);
+			if (m->fetchCycles < m->fetchLatency - 1) { //instruction cache miss
+				countStall(m, STAGE_IF, CAUSE_FETCH, 1);
+				m->fetchCycles++;
+				m->usageIF++;
+				return;
+			}
+			m->fetchLatency = 0;
+			m->fetchCycles = 0;
+			DEBUG_FETCH(m, m->pc);
+			m->IF_ID.valid = true;
+			m->IF_ID.inst = m->prog->instructions[m->pc];
+			m->IF_ID.pc = m->pc;
+			if (m->branchPredictor != NULL)
+				m->pc = predictNextPc(m->branchPredictor, &m->bp, m->pc,
+						&m->IF_ID.inst);
+			else if (!isHalt(&m->IF_ID.inst)) //stay on it until it drains
+				m->pc++;
+			m->IF_ID.predictedPc = m->pc;
+			m->usageIF++;
+			if (!m->IF_ID.readyToWork)
+				m->IF_ID.readyToWork = true;
+		} else {
+			countStall(m, STAGE_IF, CAUSE_FULL, 1);
 		}
 	} else { //branchWaiting
+		countStall(m, STAGE_IF, CAUSE_BRANCH, 1);
 		/*
 		 * Waiting on the completion of a branch
 		 * Hand off to ID? Premature return?
@@ -125,23 +376,33 @@ void IF() {
  * architecture also reads the register files in this stage. Second pipeline
  * stage that feeds into EX.
  */
-void ID() {
-	if (IF_ID.valid && IF_ID.readyToWork && !ID_EX.valid) {
-		if (isHazard() == -1) { //if no hazard
-			//If it's a branch, send it along to ex, IF will wait
-			if (IF_ID.inst.op == BEQ)
-				branchWaiting = true;
-			IF_ID.valid = false;
-			ID_EX.valid = true;
-			ID_EX.inst = IF_ID.inst; //push instruction up the pipe
-			if (ID_EX.inst.type != B)  //if not a bubble we did work here
-				usageID++;
-			if (!ID_EX.readyToWork)
-				ID_EX.readyToWork = true;
+void ID(machine *m) {
+	if (m->IF_ID.valid && m->IF_ID.readyToWork && !m->ID_EX.valid) {
+		if (isHazard(m) == -1) { //if no hazard
+			//If it's a branch or jump, send it along to ex, IF will wait
+			//unless a predictor lets ID resolve it right here
+			if (isControl(&m->IF_ID.inst)) {
+				if (m->branchPredictor != NULL)
+					resolveBranch(m);
+				else
+					m->branchWaiting = true;
+			}
+			m->IF_ID.valid = false;
+			m->ID_EX.valid = true;
+			m->ID_EX.inst = m->IF_ID.inst; //push instruction up the pipe
+			m->ID_EX.pc = m->IF_ID.pc;
+			//if not a bubble we did work here
+			if (!isBType(&m->ID_EX.inst))
+				m->usageID++;
+			if (!m->ID_EX.readyToWork)
+				m->ID_EX.readyToWork = true;
 		} else { //instruction is a bubble
-			ID_EX.valid = true;
-			ID_EX.inst = bubble;
+			countStall(m, STAGE_ID, CAUSE_HAZARD, 1);
+			m->ID_EX.valid = true;
+			m->ID_EX.inst = bubble;
 		} //end inner else
+	} else if (m->IF_ID.valid && m->IF_ID.readyToWork) {
+		countStall(m, STAGE_ID, CAUSE_FULL, 1);
 	} //end big if
 } //end function ID()
 
@@ -151,96 +412,92 @@ void ID() {
  * operations on the data/registers.  Third stage which passes results on to
  * the MEM stage.
  */
-void EX() {
-	if (ID_EX.readyToWork && ID_EX.valid) {
-		//artificial cycles to represent how long it takes
-		static int exCycles = 0;
-		if (ID_EX.inst.type == B) { //it's a bubble
-			if (!EX_MEM.valid) {
-				ID_EX.valid = false;
-				EX_MEM.valid = true;
-				EX_MEM.inst = ID_EX.inst; //push bubble up the pipe
+void EX(machine *m) {
+	if (m->ID_EX.readyToWork && m->ID_EX.valid) {
+		if (passesThroughEX(m, &m->ID_EX.inst)) {
+			if (!m->EX_MEM.valid) {
+				m->ID_EX.valid = false;
+				m->EX_MEM.valid = true;
+				m->EX_MEM.inst = m->ID_EX.inst; //push bubble up the pipe
+			} else if (!isBubble(&m->ID_EX.inst)) {
+				countStall(m, STAGE_EX, CAUSE_FULL, 1);
 			}
 		} else {
-			if (!EX_MEM.valid
-					&& ((exCycles == 15 && ID_EX.inst.op == MUL)
-							|| (exCycles == 10 && ID_EX.inst.op != MUL))) {
-				if (ID_EX.inst.rs > 31 || ID_EX.inst.rt > 31) {
+			if (!m->EX_MEM.valid && m->exCycles == exLatency(&m->ID_EX.inst)) {
+				if (m->ID_EX.inst.rs > 31 || m->ID_EX.inst.rt > 31) {
 					printf("\n>>>ERROR!\n******Invalid register location,"
 							" rs: * %d * and rt: * %d *\n\tFrom: pipeline.h"
-							" @ line 168\n", ID_EX.inst.rs, ID_EX.inst.rt);
+							" @ line 168\n", m->ID_EX.inst.rs, m->ID_EX.inst.rt);
 					exit(1);
 				}
-				if (ID_EX.inst.op == ADD)
-					EX_MEM.data = regs[ID_EX.inst.rs] + regs[ID_EX.inst.rt];
-				else if (ID_EX.inst.op == ADDI)
-					EX_MEM.data = regs[ID_EX.inst.rs] + ID_EX.inst.i;
-				else if (ID_EX.inst.op == SUB)
-					EX_MEM.data = regs[ID_EX.inst.rs] - regs[ID_EX.inst.rt];
-				else if (ID_EX.inst.op == AND)
-					EX_MEM.data = regs[ID_EX.inst.rs] & regs[ID_EX.inst.rt];
-				else if (ID_EX.inst.op == OR)
-					EX_MEM.data = regs[ID_EX.inst.rs] | regs[ID_EX.inst.rt];
-				else if (ID_EX.inst.op == MUL)
-					EX_MEM.data = regs[ID_EX.inst.rs] * regs[ID_EX.inst.rt];
-				else if (ID_EX.inst.op == BEQ) {
-					if (regs[ID_EX.inst.rs] == regs[ID_EX.inst.rt]) {
-						pc = pc + ID_EX.inst.i;
-						if (pc > haltIndex) {
+				//operands come from the register file or the forwarding muxes
+				int32_t rsVal = forwardOperand(m, m->ID_EX.inst.rs);
+				int32_t rtVal = forwardOperand(m, m->ID_EX.inst.rt);
+				const op_info *info = &opTable[m->ID_EX.inst.op];
+				switch (info->kind) {
+				case DOES_ALU:
+					m->EX_MEM.data = info->execute(rsVal, rtVal,
+							m->ID_EX.inst.i);
+					break;
+				case DOES_BRANCH:
+				case DOES_JUMP:
+					if (m->branchPredictor == NULL) { //IF waited for this
+						m->pc = controlTarget(&m->ID_EX.inst, m->ID_EX.pc,
+								rsVal, rtVal);
+						if (m->pc >= m->prog->count || m->pc < 0) {
 							printf("\n>>>ERROR!\n******Branched beyond "
 									"program boundaries, pc: * %d * and "
-									"haltIndex: * %d *\n\tFrom: pipeline.h"
-									" @ line 189\n", pc, haltIndex);
+									"instructions: * %d *\n\tFrom: pipeline.h"
+									" @ line %d\n", m->pc,
+									m->prog->count, __LINE__);
 							exit(1);
-						} //inner inner inner if
-					}
-					branchWaiting = false;
-					/*
-					 * LW and SW code here!
-					 */
-				} else if (ID_EX.inst.op == LW || ID_EX.inst.op == SW) {
-					if (ID_EX.inst.i % 4 == 0) {
-						/* TODO: NOTE!
-						 Storing 'rt' into mem.data is CORRECT!
-						 the first reg in a 'sw' instr is the data to be
-						 stored in memory, while the reg's value in parenthesis
-						 is used as an address + specified offset with which
-						 to store 'rt' data in the memory
-						 */
-						EX_MEM.data = regs[ID_EX.inst.rt];
-//						EX_MEM.data = regs[ID_EX.inst.rs]; NO, not this way
-
-						if (ID_EX.inst.op == SW) {
-							EX_MEM.inst.rd = regs[ID_EX.inst.rs]
-									+ (ID_EX.inst.i / 4);
-							offsetSW = EX_MEM.inst.rd; //save offset
-						}
-						if (ID_EX.inst.op == LW) {
-							EX_MEM.inst.rs = regs[ID_EX.inst.rs]
-									+ (ID_EX.inst.i / 4);
-							offsetLW = EX_MEM.inst.rs;
 						}
-					} else {
+						m->branchWaiting = false;
+					}
+					if (info->roles & WRITES_RD) //jal links the next pc
+						m->EX_MEM.data = m->ID_EX.pc + 1;
+					break;
+				case DOES_LOAD:
+				case DOES_STORE:
+					if (!isAligned(&m->ID_EX.inst)) {
 						printf("\n>>>ERROR!\n******Memory Misaligned/Access,"
-								"\n\tFrom: pipeline.h @ line 223\n");
+								"\n\tFrom: pipeline.h @ line %d\n", __LINE__);
 						exit(1);
 					}
-				} else {
+					/* TODO: NOTE!
+					 Storing 'rt' into mem.data is CORRECT!
+					 the first reg in a 'sw' instr is the data to be
+					 stored in memory, while the reg's value in parenthesis
+					 is used as an address + specified offset with which
+					 to store 'rt' data in the memory
+					 */
+					m->EX_MEM.data = rtVal;
+
+					//save the full 32-bit word address for MEM
+					if (info->kind == DOES_STORE)
+						m->offsetSW = wordAddress(&m->ID_EX.inst, rsVal);
+					else
+						m->offsetLW = wordAddress(&m->ID_EX.inst, rsVal);
+					break;
+				default:
 					printf("\n>>>ERROR!\n******Unrecognized Operation,"
-							"\n\tFrom: pipeline.h @ line 228\n");
+							"\n\tFrom: pipeline.h @ line %d\n", __LINE__);
 					exit(1);
 				}
-				exCycles = 0;
-				ID_EX.valid = false;
-				EX_MEM.valid = true;
-				EX_MEM.inst = ID_EX.inst; //push instr up pipe to MEM
-				if (!EX_MEM.readyToWork)
-					EX_MEM.readyToWork = true;
-			} else if ((exCycles < 15 && ID_EX.inst.op == MUL)
-					|| (exCycles < 10 && ID_EX.inst.op != MUL)) {
-				exCycles++;
+				m->exCycles = 0;
+				m->ID_EX.valid = false;
+				m->EX_MEM.valid = true;
+				m->EX_MEM.inst = m->ID_EX.inst; //push instr up pipe to MEM
+				m->EX_MEM.pc = m->ID_EX.pc;
+				if (!m->EX_MEM.readyToWork)
+					m->EX_MEM.readyToWork = true;
+			} else if (m->exCycles < exLatency(&m->ID_EX.inst)) {
+				countStall(m, STAGE_EX, CAUSE_EXECUTE, 1);
+				m->exCycles++;
+			} else {
+				countStall(m, STAGE_EX, CAUSE_FULL, 1);
 			}
-			usageEX++;
+			m->usageEX++;
 
 		} //end big outer else
 	} //end big outer if
@@ -251,72 +508,75 @@ void EX() {
  * and is system RAM.  Any data that needs to be stored or loaded, as indicated
  *  by the instruction, will be written or read here.
  */
-void MEM() {
-	if (EX_MEM.readyToWork && EX_MEM.valid) {
-		if (EX_MEM.inst.type == B) { //pushing the bubble up
-			if (!MEM_WB.valid) {
-				EX_MEM.valid = false;
-				MEM_WB.valid = true;
-				MEM_WB.inst = EX_MEM.inst;
+void MEM(machine *m) {
+	if (m->EX_MEM.readyToWork && m->EX_MEM.valid) {
+		if (isBType(&m->EX_MEM.inst)) { //pushing the bubble up
+			if (!m->MEM_WB.valid) {
+				m->EX_MEM.valid = false;
+				m->MEM_WB.valid = true;
+				m->MEM_WB.inst = m->EX_MEM.inst;
 			}
 		} else {
-			//artificial cycles to represent how long it takes
-			static int memCycles = 0;
-			bool is_lw = EX_MEM.inst.op == LW;
-			bool is_sw = EX_MEM.inst.op == SW;
+			bool is_lw = opTable[m->EX_MEM.inst.op].kind == DOES_LOAD;
+			bool is_sw = opTable[m->EX_MEM.inst.op].kind == DOES_STORE;
 			/*
 			 * WE MADE IT HERE FOR DEBUGGING LW!!!!!
 			 */
 			if (is_lw || is_sw) {
-				if (memCycles == LW_CLOCK_WAIT && !MEM_WB.valid) {
-					memCycles = 0;
-					EX_MEM.valid = false;
-					MEM_WB.valid = true;
-					MEM_WB.inst = EX_MEM.inst;
-					if (!MEM_WB.readyToWork) {
-						MEM_WB.readyToWork = true;
+				if (m->memLatency == 0)
+					m->memLatency = dataAccessTime(m,
+							is_lw ? m->offsetLW : m->offsetSW, is_sw);
+				if (m->memCycles == m->memLatency - 1 && !m->MEM_WB.valid) {
+					m->memCycles = 0;
+					m->memLatency = 0;
+					m->EX_MEM.valid = false;
+					m->MEM_WB.valid = true;
+					m->MEM_WB.inst = m->EX_MEM.inst;
+					m->MEM_WB.pc = m->EX_MEM.pc;
+					m->MEM_WB.addr = is_lw ? m->offsetLW : m->offsetSW;
+					if (!m->MEM_WB.readyToWork) {
+						m->MEM_WB.readyToWork = true;
 					}
 					/*
 					 * Load Word from Memory/RAM into Register
 					 */
 					if (is_lw) {
-						if (&RAM[EX_MEM.data] == NULL) {
-							printf("\n>>>ERROR!\n******Invalid Memory Read,"
-									"\n\tFrom: pipeline.h @ line 283\n");
-							exit(1);
-						}
-						/*
-						 * TODO: NOTE! Works now. For real.
-						 */
-//						MEM_WB.data = RAM[regs[EX_MEM.inst.rs]];
-						MEM_WB.data = RAM[offsetLW];
+						m->MEM_WB.data = loadValue(&m->EX_MEM.inst,
+								memRead(&m->memory, m->offsetLW));
+						DEBUG_ACCESS(m, m->EX_MEM.pc, m->offsetLW, false);
 					}
 					/**
-					 * Store Word into Memory/RAM
+					 * Store Word into Memory/RAM, the bytes and halfwords
+					 * merged into the word already there
 					 */
 					if (is_sw) {
-						if (&RAM[EX_MEM.data] == NULL) {
-							printf("\n>>>ERROR!\n******Invalid Memory Write,"
-									"\n\tFrom: pipeline.h @ line 298\n");
-							exit(1);
-						}
-						/**
-						 * TODO:  NOTE!  Works now. For real.
-						 */
-						RAM[offsetSW] = EX_MEM.data;
+						int32_t word = opTable[m->EX_MEM.inst.op].size < 4 ?
+								memRead(&m->memory, m->offsetSW) : 0;
+						memWrite(&m->memory, m->offsetSW,
+								storeValue(&m->EX_MEM.inst, word,
+										m->EX_MEM.data));
+						//for the trace, or sc's success flag
+						m->MEM_WB.data = writesRegister(&m->EX_MEM.inst) ?
+								1 : m->EX_MEM.data;
+						DEBUG_ACCESS(m, m->EX_MEM.pc, m->offsetSW, true);
 					}
-				} else if (memCycles < LW_CLOCK_WAIT)
-					memCycles++;
+				} else if (m->memCycles < m->memLatency - 1) {
+					countStall(m, STAGE_MEM, CAUSE_MEMORY, 1);
+					m->memCycles++;
+				} else {
+					countStall(m, STAGE_MEM, CAUSE_FULL, 1);
+				}
 			} else { //not lw && not sw
-				EX_MEM.valid = false;
-				MEM_WB.valid = true;
-				MEM_WB.inst = EX_MEM.inst;
-				MEM_WB.data = EX_MEM.data;
-				if (!MEM_WB.readyToWork)
-					MEM_WB.readyToWork = true;
+				m->EX_MEM.valid = false;
+				m->MEM_WB.valid = true;
+				m->MEM_WB.inst = m->EX_MEM.inst;
+				m->MEM_WB.pc = m->EX_MEM.pc;
+				m->MEM_WB.data = m->EX_MEM.data;
+				if (!m->MEM_WB.readyToWork)
+					m->MEM_WB.readyToWork = true;
 			}
-			if (EX_MEM.inst.type != B)
-				usageMEM++;
+			if (!isBType(&m->EX_MEM.inst))
+				m->usageMEM++;
 		} //end big else
 	} // end big if
 } //end function MEM()
@@ -327,67 +587,318 @@ void MEM() {
  * could have been passed from another register, loaded from MEM/RAM, or
  * calculated by EX in the ALU then passed into the register/cache.
  */
-void WB() {
-	if (MEM_WB.valid && MEM_WB.readyToWork) {
-		if (MEM_WB.inst.op != SW && MEM_WB.inst.op != BEQ
-				&& MEM_WB.inst.op != HALT && MEM_WB.inst.rd != 0
-				&& MEM_WB.inst.type != B) {
-			regs[MEM_WB.inst.rd] = MEM_WB.data; //data latch
-
-			usageWB++;
+void WB(machine *m) {
+	if (m->MEM_WB.valid && m->MEM_WB.readyToWork) {
+		bool written = writesRegister(&m->MEM_WB.inst);
+		if (written) {
+			m->regs[m->MEM_WB.inst.rd] = m->MEM_WB.data; //data latch
+
+			m->usageWB++;
+		}
+		if (!isBubble(&m->MEM_WB.inst)) {
+			TRACE_RETIRE(m, m->MEM_WB.pc, m->MEM_WB.inst.op,
+					written ? m->MEM_WB.inst.rd : 0, m->MEM_WB.data,
+					m->MEM_WB.addr);
+		}
+		if (!isBubble(&m->MEM_WB.inst) && !isHalt(&m->MEM_WB.inst)) {
+			m->retiredOps[m->MEM_WB.inst.op]++;
+			m->retiredInstructions++;
 		}
-		if (MEM_WB.inst.type == B && MEM_WB.inst.isHalt) {
-			allWorkCompleted = true; //halt execution, end program
+		if (isHalt(&m->MEM_WB.inst)) {
+			m->allWorkCompleted = true; //halt execution, end program
 		}
-		MEM_WB.valid = false;
+		m->MEM_WB.valid = false;
 	}
 }
 
+/**
+ * How many of the coming cycles are 'quiet': cycles in which the only
+ * thing any stage does is count down the artificial EX/MEM latency or a
+ * wait on the caches. Those
+ * can be skipped in one go by skipCycles(). Returns 0 when the next cycle
+ * has to be clocked normally.
+ */
+int32_t quietCycles(machine *m) {
+	int32_t skip = INT32_MAX;
+
+	if (m->squashFetch || (m->MEM_WB.valid && m->MEM_WB.readyToWork))
+		return 0; //IF or WB acts
+	if (m->IF_ID.valid && m->IF_ID.readyToWork && !m->ID_EX.valid)
+		return 0; //ID acts
+
+	if (!m->branchWaiting && !m->IF_ID.valid) {
+		//only a fetch waiting on the instruction cache leaves IF quiet
+		if (m->fetchCycles >= m->fetchLatency - 1)
+			return 0;
+		skip = m->fetchLatency - 1 - m->fetchCycles;
+	}
+	if (m->EX_MEM.readyToWork && m->EX_MEM.valid) {
+		//only a load or store counting down its wait leaves MEM quiet
+		if (!isMemoryAccess(&m->EX_MEM.inst)
+				|| m->memCycles >= m->memLatency - 1)
+			return 0;
+		if (m->memLatency - 1 - m->memCycles < skip)
+			skip = m->memLatency - 1 - m->memCycles;
+	}
+	if (m->ID_EX.readyToWork && m->ID_EX.valid && !m->EX_MEM.valid) {
+		//with EX_MEM full, EX just waits on MEM; otherwise on its latency
+		if (passesThroughEX(m, &m->ID_EX.inst)
+				|| m->exCycles >= exLatency(&m->ID_EX.inst))
+			return 0;
+		if (exLatency(&m->ID_EX.inst) - m->exCycles < skip)
+			skip = exLatency(&m->ID_EX.inst) - m->exCycles;
+	}
+	return skip == INT32_MAX ? 0 : skip;
+}
+
+/**
+ * Advance the clock over 'cycles' quiet cycles, accounting for them
+ * exactly as the same number of calls to the stage functions would.
+ */
+void skipCycles(machine *m, int32_t cycles) {
+	m->cpiStack[cpiPart(m)] += cycles;
+
+	//stalls go in the order the stages run, back to front, for the trace
+	if (m->EX_MEM.readyToWork && m->EX_MEM.valid)
+		countStall(m, STAGE_MEM, CAUSE_MEMORY, cycles);
+	if (m->ID_EX.readyToWork && m->ID_EX.valid) {
+		//EX counts down its latency, then waits for EX_MEM to empty
+		int32_t busy = passesThroughEX(m, &m->ID_EX.inst) ?
+				0 : exLatency(&m->ID_EX.inst) - m->exCycles;
+		if (busy > cycles)
+			busy = cycles;
+		if (busy > 0)
+			countStall(m, STAGE_EX, CAUSE_EXECUTE, busy);
+		if (busy < cycles && !isBubble(&m->ID_EX.inst)) {
+			//starts once the latency is done, not at this cycle
+			m->stalls[STAGE_EX][CAUSE_FULL] += cycles - busy;
+			TRACE_STALL(m, m->clocks + busy, STAGE_EX, CAUSE_FULL,
+					cycles - busy);
+		}
+	}
+	if (m->IF_ID.valid && m->IF_ID.readyToWork)
+		countStall(m, STAGE_ID, CAUSE_FULL, cycles);
+	if (m->branchWaiting)
+		countStall(m, STAGE_IF, CAUSE_BRANCH, cycles);
+	else
+		countStall(m, STAGE_IF, m->IF_ID.valid ? CAUSE_FULL : CAUSE_FETCH,
+				cycles);
+
+	if (!m->branchWaiting && !m->IF_ID.valid) {
+		m->fetchCycles += cycles;
+		m->usageIF += cycles;
+	}
+	if (m->ID_EX.readyToWork && m->ID_EX.valid
+			&& !passesThroughEX(m, &m->ID_EX.inst)) {
+		m->exCycles += cycles;
+		if (m->exCycles > exLatency(&m->ID_EX.inst))
+			m->exCycles = exLatency(&m->ID_EX.inst);
+		m->usageEX += cycles;
+	}
+	if (m->EX_MEM.readyToWork && m->EX_MEM.valid) {
+		m->memCycles += cycles;
+		m->usageMEM += cycles;
+	}
+	m->clocks += cycles;
+}
+
+/**
+ * Charge 'cycles' stalled cycles of 'stage' to 'cause'.
+ */
+void countStall(machine *m, int stage, int cause, int32_t cycles) {
+	m->stalls[stage][cause] += cycles;
+	TRACE_STALL(m, m->clocks, stage, cause, cycles);
+}
+
+/**
+ * The part of the CPI stack the coming cycle goes to, from what the oldest
+ * instruction in the scalar pipeline is doing.
+ */
+int cpiPart(machine *m) {
+	if (m->MEM_WB.valid && !isBubble(&m->MEM_WB.inst))
+		return CPI_BASE;
+	if (m->EX_MEM.valid && !isBubble(&m->EX_MEM.inst))
+		return isMemoryAccess(&m->EX_MEM.inst) ? CPI_MEMORY : CPI_DEPTH;
+	if (m->ID_EX.valid && !isBubble(&m->ID_EX.inst))
+		return m->branchWaiting && isControl(&m->ID_EX.inst) ?
+				CPI_BRANCH : CPI_EXECUTE;
+	if (m->IF_ID.valid)
+		return isHazard(m) != -1 ? CPI_HAZARD : CPI_DEPTH;
+	return CPI_FETCH;
+}
+
+/**
+ * Is this a bubble ID put in, rather than an instruction of the program?
+ */
+bool isBubble(instr *inst) {
+	return inst->op == BUBBLE;
+}
+
+/**
+ * Cycles EX spends on an instruction before handing it to MEM.
+ */
+int exLatency(instr *inst) {
+	return opTable[inst->op].latency;
+}
+
+/**
+ * Cycles IF takes to fetch the instruction at 'pc'.
+ */
+int32_t instrAccessTime(machine *m, int32_t pc) {
+	if (!m->cachesEnabled)
+		return 1;
+	return cacheAccess(&m->l1i, TEXT_SPACE + TEXT_BASE + 4 * (uint64_t) pc,
+			false);
+}
+
+/**
+ * Cycles MEM takes to load or store the word at word address 'addr'.
+ */
+int32_t dataAccessTime(machine *m, uint32_t addr, bool write) {
+	if (!m->cachesEnabled)
+		return LW_CLOCK_WAIT + 1;
+	return cacheAccess(&m->l1d, (uint64_t) addr << 2, write);
+}
+
+/**
+ * Bubbles, and branches and jumps already resolved in ID, have no work in
+ * EX and move on as soon as EX_MEM is free; a jal still has its link to
+ * compute.
+ */
+bool passesThroughEX(machine *m, instr *inst) {
+	return isBType(inst) || (m->branchPredictor != NULL
+			&& isControl(inst) && !writesRegister(inst));
+}
+
 /**
  * Check for hazards:
  * pipeline data hazards or structure hazards, etc.
  *
  * No hazards possible on register 0.
  */
-int isHazard() {
-	instr inst = IF_ID.inst;
-	//branch/control hazard
-	if (IF_ID.inst.type != B) {
-		if (ID_EX.readyToWork && inst.rs == ID_EX.inst.rd
-				&& ID_EX.inst.op != SW)
-			if (inst.rs != 0)
-				return inst.rs;
-
-		if (EX_MEM.readyToWork && inst.rs == EX_MEM.inst.rd
-				&& EX_MEM.inst.op != SW)
-			if (inst.rs != 0)
-				return inst.rs;
-
-		if (MEM_WB.readyToWork && inst.rs == MEM_WB.inst.rd
-				&& MEM_WB.inst.op != SW)
-			if (inst.rs != 0)
-				return inst.rs;
-
-		if (inst.type == R || inst.op == BEQ) {
-			//Need to check that rs and rt aren't targets of future ops
-			if (ID_EX.readyToWork && inst.rt == ID_EX.inst.rd
-					&& ID_EX.inst.op != SW)
-				if (inst.rt != 0)
-					return inst.rt;
-
-			if (EX_MEM.readyToWork && inst.rt == EX_MEM.inst.rd
-					&& EX_MEM.inst.op != SW)
-				if (inst.rt != 0)
-					return inst.rt;
-
-			if (MEM_WB.readyToWork && inst.rt == MEM_WB.inst.rd
-					&& MEM_WB.inst.op != SW)
-				if (inst.rt != 0)
-					return inst.rt;
-		} //end medium inner if
-	} //end big if
+int isHazard(machine *m) {
+	if (m->forwarding) { //only unfinished results still have to be waited on
+		int reg = isLoadUseHazard(m);
+		if (reg == -1 && m->branchPredictor != NULL
+				&& isControl(&m->IF_ID.inst))
+			reg = isBranchHazard(m);
+		return reg;
+	}
+
+	const instr *inst = &m->IF_ID.inst;
+	int8_t sources[2] = { inst->rs, inst->rt };
+	uint8_t reads[2] = { READS_RS, READS_RT };
+	int k;
+	//wait on every source an older instruction still has to write back
+	for (k = 0; k < 2; k++) {
+		int8_t reg = sources[k];
+		if (!(opTable[inst->op].roles & reads[k]) || reg == 0)
+			continue;
+		if (m->ID_EX.readyToWork && writesRegister(&m->ID_EX.inst)
+				&& m->ID_EX.inst.rd == reg)
+			return reg;
+		if (m->EX_MEM.readyToWork && writesRegister(&m->EX_MEM.inst)
+				&& m->EX_MEM.inst.rd == reg)
+			return reg;
+		if (m->MEM_WB.readyToWork && writesRegister(&m->MEM_WB.inst)
+				&& m->MEM_WB.inst.rd == reg)
+			return reg;
+	}
 
 	return -1;
 } //end function hazard()
 
+/**
+ * With forwarding, the only hazard left is an instruction that needs the
+ * result of a load still ahead of it in EX: the loaded value does not
+ * exist until the load leaves MEM, so the dependent instruction is held in
+ * ID until then.
+ */
+int isLoadUseHazard(machine *m) {
+	const instr *inst = &m->IF_ID.inst;
+	if (!m->ID_EX.valid || !resultFromMemory(&m->ID_EX.inst)
+			|| !writesRegister(&m->ID_EX.inst))
+		return -1;
+	if ((opTable[inst->op].roles & READS_RS) && inst->rs == m->ID_EX.inst.rd)
+		return inst->rs;
+	if ((opTable[inst->op].roles & READS_RT) && inst->rt == m->ID_EX.inst.rd)
+		return inst->rt;
+	return -1;
+}
+
+/**
+ * A branch resolved in ID compares its registers there, one stage earlier
+ * than EX, so with forwarding it also has to wait for an ALU result still
+ * being computed in EX, or for a load that has not left MEM yet.
+ */
+int isBranchHazard(machine *m) {
+	const instr *inst = &m->IF_ID.inst;
+	bool readsRs = opTable[inst->op].roles & READS_RS;
+	bool readsRt = opTable[inst->op].roles & READS_RT;
+	if (m->ID_EX.valid && writesRegister(&m->ID_EX.inst)) {
+		if (readsRs && inst->rs == m->ID_EX.inst.rd)
+			return inst->rs;
+		if (readsRt && inst->rt == m->ID_EX.inst.rd)
+			return inst->rt;
+	}
+	if (m->EX_MEM.valid && resultFromMemory(&m->EX_MEM.inst)
+			&& writesRegister(&m->EX_MEM.inst)) {
+		if (readsRs && inst->rs == m->EX_MEM.inst.rd)
+			return inst->rs;
+		if (readsRt && inst->rt == m->EX_MEM.inst.rd)
+			return inst->rt;
+	}
+	return -1;
+}
+
+/**
+ * Branch comparison moved into ID: compare the registers now (or take the
+ * jump), check the outcome against what IF predicted and redirect the
+ * fetch when it was wrong.
+ */
+void resolveBranch(machine *m) {
+	instr *inst = &m->IF_ID.inst;
+	int32_t nextPc = controlTarget(inst, m->IF_ID.pc,
+			forwardOperand(m, inst->rs), forwardOperand(m, inst->rt));
+
+	if (nextPc >= m->prog->count || nextPc < 0) {
+		printf("\n>>>ERROR!\n******Branched beyond program boundaries,"
+				" pc: * %d * and instructions: * %d *\n\tFrom: pipeline.h"
+				" @ line %d\n", nextPc, m->prog->count, __LINE__);
+		exit(1);
+	}
+	if (resolvePrediction(m->branchPredictor, &m->bp, m->IF_ID.pc, inst,
+			m->IF_ID.predictedPc, nextPc)) {
+		m->pc = nextPc;
+		m->squashFetch = true;
+	}
+}
+
+/**
+ * Does this instruction write its result to register 'rd' in WB?
+ */
+bool writesRegister(instr *inst) {
+	return (opTable[inst->op].roles & WRITES_RD) && inst->rd != 0;
+}
+
+/**
+ * The forwarding unit: the muxes in front of EX. Returns the newest value
+ * of register 'reg', taken from the EX_MEM or MEM_WB latch when an
+ * instruction there is about to write it, or from the register file.
+ * A load (or sc) in EX_MEM has not been to memory yet, so it is never
+ * forwarded from; isLoadUseHazard() keeps that case from reaching here.
+ */
+int32_t forwardOperand(machine *m, int8_t reg) {
+	if (m->forwarding && reg != 0) {
+		if (m->EX_MEM.valid && m->EX_MEM.inst.rd == reg
+				&& !resultFromMemory(&m->EX_MEM.inst)
+				&& writesRegister(&m->EX_MEM.inst))
+			return m->EX_MEM.data;
+		if (m->MEM_WB.valid && m->MEM_WB.inst.rd == reg
+				&& writesRegister(&m->MEM_WB.inst))
+			return m->MEM_WB.data;
+	}
+	return m->regs[reg];
+}
+
 #endif /* PIPELINE_H_ */
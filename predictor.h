@@ -0,0 +1,227 @@
+/*
+ * predictor.h
+ *
+ *  Created on: Oct 18, 2026
+ *
+ *  Branch prediction for the IF stage. When a predictor is selected,
+ *  branches are resolved early in ID instead of EX, and IF keeps fetching
+ *  down the predicted path instead of freezing on 'branchWaiting'. A
+ *  mispredicted branch squashes the fetch slot of the cycle it is resolved
+ *  in and redirects the program counter.
+ *
+ *  Each predictor supplies a predict and an update function through the
+ *  'predictors' table:
+ *    nottaken: static, always falls through
+ *    1bit:     one bit per entry, remembers the last outcome
+ *    2bit:     two bit saturating counters
+ *    btb:      branch target buffer with 2 bit counters; only branches that
+ *              hit in the buffer can be predicted taken
+ *  The direction predictors take the target from the decoded instruction.
+ *  Returns from 'jr' are predicted by the return address stack, which
+ *  'jal' pushes onto.
+ *
+ *  REFERENCES: see projmain.c header comment.
+ */
+
+#ifndef PREDICTOR_H_
+#define PREDICTOR_H_
+
+#include "instruction.h"
+
+/******************************************************************************
+ * Constants/Definitions
+ */
+#define BP_TABLE_SIZE 512 //entries in the 1bit/2bit pattern tables
+#define BTB_SIZE 64
+#define RAS_SIZE 16
+
+/******************************************************************************
+ * Global Vars and Structs
+ */
+typedef struct btb_entry_tag {
+	bool valid;
+	int32_t pc;
+	int32_t target;
+	uint8_t counter;
+} btb_entry;
+
+//what a predictor learns while a program runs, one per machine
+typedef struct bp_state_tag {
+	uint8_t patternTable[BP_TABLE_SIZE];
+	btb_entry btb[BTB_SIZE];
+	int32_t returnStack[RAS_SIZE];
+	int32_t rasTop; //number of entries pushed, wraps around when full
+
+	//counters for the prediction accuracy statistics
+	int32_t branches;
+	int32_t hits;
+	int32_t misses;
+	int32_t rasHits;
+	int32_t rasMisses;
+} bp_state;
+
+typedef struct predictor_tag {
+	const char *name;
+	bool (*predictTaken)(bp_state *bp, int32_t pc, int32_t *target);
+	void (*update)(bp_state *bp, int32_t pc, bool taken, int32_t target);
+} predictor;
+
+/******************************************************************************
+ * Function Prototypes
+ */
+bool notTakenPredict(bp_state*, int32_t, int32_t*);
+void notTakenUpdate(bp_state*, int32_t, bool, int32_t);
+bool oneBitPredict(bp_state*, int32_t, int32_t*);
+void oneBitUpdate(bp_state*, int32_t, bool, int32_t);
+bool twoBitPredict(bp_state*, int32_t, int32_t*);
+void twoBitUpdate(bp_state*, int32_t, bool, int32_t);
+bool btbPredict(bp_state*, int32_t, int32_t*);
+void btbUpdate(bp_state*, int32_t, bool, int32_t);
+const predictor* findPredictor(char*);
+int32_t predictNextPc(const predictor*, bp_state*, int32_t, instr*);
+bool resolvePrediction(const predictor*, bp_state*, int32_t, instr*, int32_t,
+		int32_t);
+
+const predictor predictors[] = {
+		{ "nottaken", notTakenPredict, notTakenUpdate },
+		{ "1bit", oneBitPredict, oneBitUpdate },
+		{ "2bit", twoBitPredict, twoBitUpdate },
+		{ "btb", btbPredict, btbUpdate },
+		{ NULL, NULL, NULL } };
+
+/******************************************************************************
+ * Functions
+ */
+
+/**
+ * Static not-taken: always fetch the next sequential instruction.
+ */
+bool notTakenPredict(bp_state *bp, int32_t pc, int32_t *target) {
+	return false;
+}
+
+void notTakenUpdate(bp_state *bp, int32_t pc, bool taken, int32_t target) {
+}
+
+/**
+ * One bit predictor: predict whatever the branch did last time.
+ */
+bool oneBitPredict(bp_state *bp, int32_t pc, int32_t *target) {
+	return bp->patternTable[pc % BP_TABLE_SIZE];
+}
+
+void oneBitUpdate(bp_state *bp, int32_t pc, bool taken, int32_t target) {
+	bp->patternTable[pc % BP_TABLE_SIZE] = taken;
+}
+
+/**
+ * Two bit saturating counter: 0,1 predict not taken, 2,3 predict taken.
+ */
+bool twoBitPredict(bp_state *bp, int32_t pc, int32_t *target) {
+	return bp->patternTable[pc % BP_TABLE_SIZE] >= 2;
+}
+
+void twoBitUpdate(bp_state *bp, int32_t pc, bool taken, int32_t target) {
+	uint8_t *counter = &bp->patternTable[pc % BP_TABLE_SIZE];
+	if (taken && *counter < 3)
+		(*counter)++;
+	else if (!taken && *counter > 0)
+		(*counter)--;
+}
+
+/**
+ * Branch target buffer: direct mapped, tagged with the full pc. The target
+ * comes from the buffer, so a branch never seen taken falls through.
+ */
+bool btbPredict(bp_state *bp, int32_t pc, int32_t *target) {
+	btb_entry *entry = &bp->btb[pc % BTB_SIZE];
+	if (entry->valid && entry->pc == pc && entry->counter >= 2) {
+		*target = entry->target;
+		return true;
+	}
+	return false;
+}
+
+void btbUpdate(bp_state *bp, int32_t pc, bool taken, int32_t target) {
+	btb_entry *entry = &bp->btb[pc % BTB_SIZE];
+	if (entry->valid && entry->pc == pc) {
+		entry->target = target;
+		if (taken && entry->counter < 3)
+			entry->counter++;
+		else if (!taken && entry->counter > 0)
+			entry->counter--;
+	} else if (taken) { //allocate on the first taken execution
+		entry->valid = true;
+		entry->pc = pc;
+		entry->target = target;
+		entry->counter = 2;
+	}
+}
+
+/**
+ * Look up a predictor by its command line name, NULL if there is none.
+ */
+const predictor* findPredictor(char *name) {
+	int i;
+	for (i = 0; predictors[i].name != NULL; i++)
+		if (strcmp(predictors[i].name, name) == 0)
+			return &predictors[i];
+	return NULL;
+}
+
+/**
+ * Called by IF for the instruction it just fetched from 'pc': returns the
+ * pc to fetch from next.
+ */
+int32_t predictNextPc(const predictor *branchPredictor, bp_state *bp,
+		int32_t pc, instr *inst) {
+	int32_t target = pc + 1 + inst->i;
+
+	switch (inst->op) {
+	case BEQ:
+	case BNE:
+		if (branchPredictor->predictTaken(bp, pc, &target))
+			return target;
+		return pc + 1;
+	case J:
+		return inst->i;
+	case JAL:
+		bp->returnStack[bp->rasTop++ % RAS_SIZE] = pc + 1;
+		return inst->i;
+	case JR:
+		if (bp->rasTop > 0)
+			return bp->returnStack[--bp->rasTop % RAS_SIZE];
+		return pc + 1;
+	case HALT:
+		return pc; //keep fetching the halt until it drains the pipeline
+	default:
+		return pc + 1;
+	}
+}
+
+/**
+ * Called by ID once a control instruction fetched from 'pc' has its actual
+ * next pc. Trains the predictor, counts the outcome and tells whether the
+ * fetch that followed it has to be squashed.
+ */
+bool resolvePrediction(const predictor *branchPredictor, bp_state *bp,
+		int32_t pc, instr *inst, int32_t predictedPc, int32_t actualPc) {
+	bool hit = predictedPc == actualPc;
+
+	if (inst->op == JR) {
+		if (hit)
+			bp->rasHits++;
+		else
+			bp->rasMisses++;
+	} else if (inst->op == BEQ || inst->op == BNE) {
+		branchPredictor->update(bp, pc, actualPc != pc + 1, pc + 1 + inst->i);
+		bp->branches++;
+		if (hit)
+			bp->hits++;
+		else
+			bp->misses++;
+	}
+	return !hit;
+}
+
+#endif /* PREDICTOR_H_ */
@@ -26,41 +26,21 @@
  *
  *  TODO: Requirements for the project: xADD, xSUB, xAND, xOR, xLW, xSW
  *
- *  TODO: Add all instructions (like lui, sll, etc.)---
- *   go to the function @parseInstruction(0, 1) in the file instruction.h
- *   and add what's needed. Also go to instruction.h and alter the "isIType",
- *   "isRType", etc. functions to work with new operations.
- *   Then go to file pipeline.h and the EX() function to add the
- *    actual operations.
- *
- *  TODO: Finish the ouput file, which I've begun passing through to
- *  main-->parseASMFile-->parseInstruction
- *  add the binary machine codes for the instruction, likely to happen directly
- *  from the parseInstruction() function (hopefully that simple).
- *
- *  TODO: related to output file: make it an object.obj file just like a
- *  real assembler would do, then maybe have the program automatically
- *  pull the bits from that file to simulate the operations (rather than the
- *  direct/hardcoded way it's happening now) be mindful of the Pipeline!
- *
- *  TODO: also related to the output file: add a getBin() function to convert
- *  to binary, already have written a couple in other C files...
+ *  TODO: Add the remaining instructions (shifts by register, mfhi/mflo,
+ *   etc.)--- give each an entry in 'opTable' in instruction.h, and an ALU
+ *   handler there if it computes something new; the assembler and every
+ *   engine go by that table. jit.h still translates only the original
+ *   ADD..SW subset, so blocks end before anything else.
  *
  *  TODO: consolidate and minimize, while also seeing about modularizing a bit
  *  more via offloading instruction.h and pipeline.h functions and vars to
  *  a new header file or the existing fileparser.h--where appropriate ofc!
  *
- *  TODO: optimizing the pipeline with data forwarding (these are
- *  classically implemented with a pair of muxes in between the pipeline stages
- *  EX and MEM) and moving the branching execution to the ID as the text book
- *  on page 318-319 mentions.
- *
- *  TODO: investigate other pipeline optimizations that increase concurrency
- *  and threadedness.
- *
- *  TODO: optimize data structures and implement the hashfunction.h and
- *  hashmap.h files to hash our data for quick retrieval (already using binary
- *  search here, but it is temporarily disabled).
+ *  TODO: more concurrency within a single pipeline run. A thread per stage
+ *  does not give it: each stage sees what its successor did in the same
+ *  cycle (the latch it emptied, hazards, forwarding, a branch redirect),
+ *  so the stages could only take turns. Batch mode (-b) and lockstep runs
+ *  (-L) are what use several cores for now.
  *
  *  TODO: optimize ALL variables into the appropriate size and type, i.e. use
  *  uint8_t and int8_t or char where possible and mix in int16_t with int32_t.
@@ -68,135 +48,708 @@
 
 #include <stdio.h>
 #include <stdint.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <dirent.h>
+#include <pthread.h>
 
 #include "pipeline.h"
 #include "instruction.h"
 #include "fileparser.h"
+#include "functional.h"
+#include "superscalar.h"
+#include "ooo.h"
+#include "snapshot.h"
+#include "batch.h"
+#include "lanes.h"
 
 /******************************************************************************
  * Function Prototypes
  */
 void displayBits();
-void printMemory();
-void printStatistics();
-void printRegisters();
+void runTiming(machine*);
+void printMemory(machine*);
+void printStatistics(machine*);
+void printRegisters(machine*);
+void printCache(cache*);
+void printSlotUsage(machine*);
+void printOutOfOrder(machine*);
+void printCpiStack(machine*);
+void exportStatistics(machine*, const char*);
+void runLockstep(const program*, const char*);
 
 /******************************************************************************
  * Run from command line like so:
  *
- * > gcc projmain.c -o app
- * > app tester.asm output.txt
+ * > gcc projmain.c -o app -pthread
+ * > app [options] tester.asm output.obj
  *
- * Where 'output.txt' is any named txt file you want - created on demand.
+ * Where 'output.obj' is any named object file you want - created on demand.
+ * It holds the assembled machine code, and can be given back later as the
+ * input file to skip assembling the source again. A snapshot saved with -s
+ * can be given as the input file too, to carry on a run from the cycle it
+ * was saved at. Without any file names the program prompts for them, and
+ * can be repeated. Sources can name instructions and data with labels
+ * ("loop:") to use as beq targets, immediates and load/store offsets, and
+ * lay out initial memory in .data sections with .word and .space; see
+ * fileparser.h.
+ *
+ * Options:
+ *  -f  fast functional simulation: no pipeline timing, final registers and
+ *      memory only
+ *  -J  functional simulation that translates hot blocks of the program to
+ *      host code, for very long runs; x86-64 Linux only, see jit.h
+ *  -d  data forwarding from the EX_MEM and MEM_WB latches into EX
+ *  -t  clock the pipeline tick by tick, instead of skipping over cycles in
+ *      which every stage is only waiting (same results, just slower)
+ *  -p predictor
+ *      resolve branches in ID and keep fetching down the path guessed by
+ *      the branch predictor: nottaken, 1bit, 2bit or btb
+ *  -w width
+ *      in-order superscalar pipeline issuing up to 1, 2 or 4 instructions
+ *      per cycle, with per slot statistics; see superscalar.h
+ *  -o window
+ *      out-of-order core with a reorder buffer and reservation stations,
+ *      'issueWidth' wide: "on" for the default window or
+ *      "rob:alu:mul:mem" entries, e.g. "64:16:4:16"; see ooo.h
+ *  -c caches
+ *      time fetches and loads/stores through L1 instruction/data caches
+ *      and an L2 instead of a fixed memory latency: "on" for the default
+ *      sizes, or levels to change such as "l1d=16k:2:32:plru:wt:2,l2=1m"
+ *      (size:assoc:line:lru|plru|random:wb|wt:latency); see cache.h
+ *  -b results.txt
+ *      batch mode: simulate every program (.asm or .obj) and every program
+ *      in each directory given, in parallel, and write all their final
+ *      registers, memory and statistics to 'results.txt'; see batch.h
+ *  -j threads
+ *      worker threads for batch mode, all online cores by default
+ *  -s file:cycle
+ *      save a snapshot of the whole machine to 'file' when the clock
+ *      reaches 'cycle', then finish the run as usual. A restored run keeps
+ *      the engine (-w, -o), predictor and caches it was saved with; -d and
+ *      -c given with it switch forwarding or (cold) caches on from that
+ *      cycle on; see snapshot.h
+ *  -x stats.json|stats.csv
+ *      also write the statistics of a pipeline run (CPI stack, stall cycles
+ *      by stage and cause, retired instructions by opcode, utilization) to
+ *      a JSON file, or a CSV one for any other extension
+ *  -T trace.bin
+ *      record every retired instruction and every pipeline stall to
+ *      'trace.bin', for tracedump.c to print; only in a simulator built
+ *      with -DTRACE, see trace.h
+ *  -g  run under the interactive debugger: stop before the first fetch,
+ *      then step, continue, run until an instruction, set breakpoints
+ *      (optionally on a register condition) and watchpoints on memory
+ *      words, and look at registers and memory from its prompt; 'help'
+ *      lists the commands. Only in a simulator built with -DDEBUGGER, see
+ *      debugger.h
+ *  -L states.txt
+ *      functional simulation of one machine per line of 'states.txt' at
+ *      once, all running the program in lockstep, each from the registers
+ *      and memory words its line sets ("$a0=5 $t1=0x10 [64]=-1"); prints
+ *      every machine's instructions retired and final non-zero registers;
+ *      see lanes.h
  */
-int main(void) {
+int main(int argc, char *argv[]) {
 
 	char inFile[100];
-	char outFile[100];
+	char outFile[100] = "a.obj";
 	char continuity = 'r';
+	bool functional = false;
+	bool translate = false;
+	bool forwarding = false;
+	bool eventDriven = true;
+	const predictor *branchPredictor = NULL;
+	cache_config cacheConfig[CACHE_LEVELS];
+	bool caches = false;
+	int issueWidth = 0;
+	ooo_config oooConfig;
+	bool outOfOrder = false;
+	char *resultFile = NULL;
+	char *snapFile = NULL;
+	char *traceFile = NULL;
+	char *statsFile = NULL;
+	char *laneFile = NULL;
+	bool debugging = false;
+	int32_t snapClock = 0;
+	bool restored;
+	int threads = sysconf(_SC_NPROCESSORS_ONLN);
+	program prog = { 0 };
+	machine m;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "fJdtp:w:o:c:b:j:s:x:T:gL:")) != -1) {
+		switch (opt) {
+		case 'f':
+			functional = true;
+			break;
+		case 'J':
+			functional = true;
+			translate = true;
+			break;
+		case 'd':
+			forwarding = true;
+			break;
+		case 't':
+			eventDriven = false;
+			break;
+		case 'p':
+			branchPredictor = findPredictor(optarg);
+			if (branchPredictor == NULL) {
+				printf("Unknown branch predictor '%s'.\n", optarg);
+				return 1;
+			}
+			break;
+		case 'w':
+			issueWidth = atoi(optarg);
+			if (issueWidth != 1 && issueWidth != 2 && issueWidth != 4) {
+				printf("Issue width must be 1, 2 or 4.\n");
+				return 1;
+			}
+			break;
+		case 'o':
+			if (!parseOooConfig(optarg, &oooConfig)) {
+				printf("Invalid out-of-order window '%s'.\n", optarg);
+				return 1;
+			}
+			outOfOrder = true;
+			break;
+		case 'c':
+			if (!parseCacheConfig(optarg, cacheConfig)) {
+				printf("Invalid cache configuration '%s'.\n", optarg);
+				return 1;
+			}
+			caches = true;
+			break;
+		case 'b':
+			resultFile = optarg;
+			break;
+		case 'j':
+			threads = atoi(optarg);
+			break;
+		case 's':
+			snapFile = optarg;
+			char *cycle = strrchr(optarg, ':');
+			if (cycle == NULL || cycle == optarg
+					|| (snapClock = atoi(cycle + 1)) < 1) {
+				printf("Snapshot must be given as file:cycle.\n");
+				return 1;
+			}
+			*cycle = '\0';
+			break;
+		case 'x':
+			statsFile = optarg;
+			break;
+		case 'T':
+#ifdef TRACE
+			traceFile = optarg;
+			break;
+#else
+			printf("Tracing needs a simulator built with -DTRACE.\n");
+			return 1;
+#endif
+		case 'g':
+#ifdef DEBUGGER
+			debugging = true;
+			break;
+#else
+			printf("Debugging needs a simulator built with -DDEBUGGER.\n");
+			return 1;
+#endif
+		case 'L':
+			functional = true;
+			laneFile = optarg;
+			break;
+		default:
+			printf("usage: %s [-f|-J] [-d] [-t] [-p predictor] [-w width]"
+					" [-o window] [-c caches] [-s file:cycle] [-x stats]"
+					" [-T trace] [-g] [-L states.txt]"
+					" [file.asm|file.obj|snapshot [out.obj]]\n", argv[0]);
+			printf("       %s [-f|-J] [-d] [-t] [-p predictor] [-w width]"
+					" [-o window] [-c caches] -b results.txt [-j threads]"
+					" file|dir...\n", argv[0]);
+			return 1;
+		}
+	}
+
+	if (snapFile != NULL && (functional || resultFile != NULL)) {
+		printf("Snapshots need a single pipeline run, not -f or -b.\n");
+		return 1;
+	}
+	if (traceFile != NULL && (functional || resultFile != NULL)) {
+		printf("Traces need a single pipeline run, not -f or -b.\n");
+		return 1;
+	}
+	if (debugging && (functional || resultFile != NULL)) {
+		printf("The debugger needs a single pipeline run, not -f, -L or"
+				" -b.\n");
+		return 1;
+	}
+	if (laneFile != NULL && (translate || resultFile != NULL)) {
+		printf("Lockstep runs are interpreted one program at a time, not -J"
+				" or -b.\n");
+		return 1;
+	}
+	if (resultFile != NULL) {
+		static batch b;
+		b.workers = threads < 1 ? 1 : threads > MAX_WORKERS ? MAX_WORKERS : threads;
+		b.functional = functional;
+		b.translate = translate;
+		b.forwarding = forwarding;
+		b.eventDriven = eventDriven;
+		b.branchPredictor = branchPredictor;
+		b.cacheConfig = caches ? cacheConfig : NULL;
+		b.issueWidth = issueWidth;
+		b.oooConfig = outOfOrder ? &oooConfig : NULL;
+		for (; optind < argc; optind++)
+			addBatchInput(&b, argv[optind]);
+		runBatch(&b, resultFile);
+		return 0;
+	}
 
 	while (continuity == 'r') {
 
 		printf("\n--------------------------------\n");
 		printf("   Welcome to MIPS Assembler!");
 		printf("\n--------------------------------\n\n");
-		printf("Load File: ");
-		scanf("%s", inFile);
+		if (optind < argc) { //file names given on the command line
+			snprintf(inFile, sizeof(inFile), "%s", argv[optind]);
+			if (optind + 1 < argc)
+				snprintf(outFile, sizeof(outFile), "%s", argv[optind + 1]);
+		} else {
+			printf("Load File: ");
+			scanf("%s", inFile);
+		}
 
-		printf("Out File: ");
-		scanf("%s", outFile);
-		printf("\n");
-		parseASMFile(inFile, outFile);
-
-        //Once we've read everything in, reset the program_counter
-		pc = 0;
-        //Then start iterating over the pipelined stages in reverse
-		while (!allWorkCompleted) {
-			WB();MEM();EX();ID();IF();
-			clocks++;
+		restored = isSnapshotFile(inFile);
+		if (restored && functional) {
+			printf("Snapshots need the pipeline, not -f.\n");
+			return 1;
+		} else if (restored) { //a machine part way through a run
+			loadSnapshot(&prog, &m, inFile);
+			printf("\nRestored %d instructions at clock %d from snapshot"
+					" '%s'.\n", prog.count, m.clocks, inFile);
+		} else if (isObjectFile(inFile)) { //already assembled, map it in
+			printf("\n");
+			loadObjectFile(&prog, inFile);
+			printf("Loaded %d instructions from object file '%s'.\n",
+					prog.count, inFile);
+		} else {
+			if (optind >= argc) {
+				printf("Out File: ");
+				scanf("%s", outFile);
+				printf("\n");
+			}
+			parseASMFile(&prog, inFile, outFile);
+		}
+
+		if (laneFile != NULL) { //many machines instead of one
+			runLockstep(&prog, laneFile);
+			freeProgram(&prog);
+			if (optind < argc)
+				break;
+			printf("\nEnter r to repeat, q to quit: \n");
+			scanf(" %c", &continuity);
+			continue;
 		}
-		printStatistics();
-		printMemory();
-		printRegisters();
 
+		if (!restored) {
+			initMachine(&m, &prog);
+			m.forwarding = forwarding;
+			m.branchPredictor = branchPredictor;
+			m.issueWidth = issueWidth;
+			m.jitThreshold = translate ? JIT_THRESHOLD : 0;
+			if (outOfOrder)
+				enableOutOfOrder(&m, &oooConfig);
+		} else {
+			m.forwarding |= forwarding;
+		}
+		m.eventDriven = eventDriven;
+		m.stopClock = 0;
+		if (caches && !m.cachesEnabled)
+			enableCaches(&m, cacheConfig);
+#ifdef TRACE
+		if (traceFile != NULL)
+			m.trace = openTrace(traceFile);
+#endif
+#ifdef DEBUGGER
+		if (debugging)
+			m.debug = attachDebugger(&prog);
+#endif
+		if (functional) {
+			runFunctional(&m);
+			printf("\n\t~~~~~~~ Functional Simulation Statistics ~~~~~~~\n");
+			printf("\tInstructions: %10lld retired\n",
+					(long long) m.retiredInstructions);
+			if (translate)
+				printf("\tTranslated: %12d blocks\n", m.jitBlocks);
+			printf("\n");
+		} else {
+			if (snapFile != NULL && m.clocks < snapClock) {
+				m.stopClock = snapClock;
+				runTiming(&m);
+				m.stopClock = 0;
+				if (!m.allWorkCompleted) {
+					saveSnapshot(&m, snapFile);
+					printf("Saved clock %d to snapshot '%s'.\n", m.clocks,
+							snapFile);
+				}
+			}
+			runTiming(&m);
+			printStatistics(&m);
+			if (statsFile != NULL)
+				exportStatistics(&m, statsFile);
+		}
+		printMemory(&m);
+		printRegisters(&m);
+		freeMachine(&m);
+		freeProgram(&prog);
+
+		if (optind < argc)
+			break; //non-interactive, run once
 		printf("\nEnter r to repeat, q to quit: \n");
 		scanf(" %c", &continuity);
 	}
 	return 0;
 }
 
+/*
+ * Clock the machine on whichever engine it was set up for, until the halt
+ * retires or the clock reaches 'stopClock'.
+ */
+void runTiming(machine *m) {
+	if (m->core != NULL)
+		runOutOfOrder(m);
+	else if (m->issueWidth > 0)
+		runSuperscalar(m);
+	else
+		runPipeline(m);
+}
+
+/*
+ * Run 'prog' on every machine 'stateFile' sets up, in lockstep, and print
+ * what each one ended with.
+ */
+void runLockstep(const program *prog, const char *stateFile) {
+	lanes *l = loadLanes(prog, stateFile);
+	int64_t total = 0;
+	int k, reg;
+
+	runLanes(l);
+	for (k = 0; k < l->count; k++)
+		total += l->retired[k];
+	printf("\n\t~~~~~~~ Lockstep Simulation Statistics ~~~~~~~\n");
+	printf("\tMachines: %14d (%d per vector)\n", l->count, LANE_WIDTH);
+	printf("\tInstructions: %10lld retired\n", (long long) total);
+	printf("\tSteps: %17lld\n\n", (long long) l->steps);
+	printf("machine    retired  registers\n");
+	for (k = 0; k < l->count; k++) {
+		printf("%7d %10lld ", k, (long long) l->retired[k]);
+		for (reg = 1; reg < 32; reg++)
+			if (laneRegister(l, reg, k) != 0)
+				printf(" $%d=%d", reg, laneRegister(l, reg, k));
+		printf("\n");
+	}
+	freeLanes(l);
+}
+
 /*
  * Outputs the pipeline usage in percentage, per each stage.
  */
-void printStatistics() {
+void printStatistics(machine *m) {
 	printf("\n\t~~~~~~~ Pipeline Stage Utilization Statistics ~~~~~~~\n");
-	printf("\tIF: %19.2f%%\n", 1.0 * usageIF / clocks * 100);
-	printf("\tID: %19.2f%%\n", 1.0 * usageID / clocks * 100);
-	printf("\tEX: %19.2f%%\n", 1.0 * usageEX / clocks * 100);
-	printf("\tMEM: %18.2f%%\n", 1.0 * usageMEM / clocks * 100);
-	printf("\tWB: %19.2f%%\n", 1.0 * usageWB / clocks * 100);
-	printf("\tExecutionTime: %9d clocks\n\n", clocks);
+	printf("\tIF: %19.2f%%\n", 1.0 * m->usageIF / m->clocks * 100);
+	printf("\tID: %19.2f%%\n", 1.0 * m->usageID / m->clocks * 100);
+	printf("\tEX: %19.2f%%\n", 1.0 * m->usageEX / m->clocks * 100);
+	printf("\tMEM: %18.2f%%\n", 1.0 * m->usageMEM / m->clocks * 100);
+	printf("\tWB: %19.2f%%\n", 1.0 * m->usageWB / m->clocks * 100);
+	printf("\tExecutionTime: %9d clocks\n\n", m->clocks);
+	if (m->branchPredictor != NULL) {
+		printf("\t~~~~~~~ Branch Prediction (%s) ~~~~~~~\n",
+				m->branchPredictor->name);
+		printf("\tBranches: %14d\n", m->bp.branches);
+		printf("\tHits: %18d\n", m->bp.hits);
+		printf("\tMisses: %16d\n", m->bp.misses);
+		printf("\tAccuracy: %13.2f%%\n",
+				m->bp.branches ? 100.0 * m->bp.hits / m->bp.branches : 0.0);
+		printf("\tReturn stack: %6d hits %d misses\n", m->bp.rasHits, m->bp.rasMisses);
+		printf("\tSquashed fetches: %6d\n\n", m->squashedFetches);
+	}
+	printCpiStack(m);
+	if (m->core != NULL)
+		printOutOfOrder(m);
+	else if (m->issueWidth > 0)
+		printSlotUsage(m);
+	if (m->cachesEnabled) {
+		printf("\t~~~~~~~ Cache Statistics ~~~~~~~\n");
+		printf("\tlevel   accesses       hits     misses  evictions writebacks"
+				"  hit rate\n");
+		printCache(&m->l1i);
+		printCache(&m->l1d);
+		printCache(&m->l2);
+		printf("\n");
+	}
+}
+
+/*
+ * Where the cycles went: the CPI stack, the cycles each stage stalled by
+ * cause (the in-order pipelines; the out-of-order core has its own) and
+ * the instructions retired by opcode.
+ */
+void printCpiStack(machine *m) {
+	int64_t retired = m->retiredInstructions > 0 ? m->retiredInstructions : 1;
+	const char *stages[STAGES] = { "IF", "ID", "EX", "MEM", "WB" };
+	int p, s, c, op;
+
+	printf("\t~~~~~~~ CPI Stack ~~~~~~~\n");
+	printf("\tRetired: %15lld instructions\n",
+			(long long) m->retiredInstructions);
+	printf("\tCPI: %19.3f\n", 1.0 * m->clocks / retired);
+	printf("\tpart        cycles    share      cpi\n");
+	for (p = 0; p < CPI_PARTS; p++)
+		printf("\t%-7s %10d %7.2f%% %8.3f\n", cpiNames[p], m->cpiStack[p],
+				100.0 * m->cpiStack[p] / m->clocks,
+				1.0 * m->cpiStack[p] / retired);
+	printf("\n");
+
+	if (m->core == NULL) {
+		printf("\t~~~~~~~ Stall Cycles by Cause ~~~~~~~\n\tstage");
+		for (c = 0; c < CAUSES; c++)
+			printf(" %8s", causeNames[c]);
+		for (s = 0; s < STAGE_WB; s++) { //WB never stalls
+			printf("\n\t%-5s", stages[s]);
+			for (c = 0; c < CAUSES; c++)
+				printf(" %8d", m->stalls[s][c]);
+		}
+		printf("\n\n");
+	}
+
+	printf("\t~~~~~~~ Retired by Opcode ~~~~~~~\n");
+	for (op = 0; op < OPCODES; op++)
+		if (m->retiredOps[op] > 0)
+			printf("\t%-8s %14lld\n", opcodeName(op),
+					(long long) m->retiredOps[op]);
+	printf("\n");
+}
+
+/*
+ * Write the statistics of a pipeline run to 'statsFile' for dashboards and
+ * scripts: JSON when the name ends in .json, otherwise CSV rows of
+ * 'section,name,value'.
+ */
+void exportStatistics(machine *m, const char *statsFile) {
+	const char *stages[STAGES] = { "IF", "ID", "EX", "MEM", "WB" };
+	int32_t usage[STAGES] = { m->usageIF, m->usageID, m->usageEX, m->usageMEM,
+			m->usageWB };
+	size_t length = strlen(statsFile);
+	bool json = length >= 5 && strcmp(statsFile + length - 5, ".json") == 0;
+	const char *separator;
+	int p, s, c, op;
+
+	FILE *out = fopen(statsFile, "w");
+	if (out == NULL) {
+		printf("Statistics file '%s' could not be created.\n", statsFile);
+		exit(1);
+	}
+
+	if (!json) {
+		fprintf(out, "section,name,value\n");
+		fprintf(out, "summary,clocks,%d\n", m->clocks);
+		fprintf(out, "summary,retired,%lld\n",
+				(long long) m->retiredInstructions);
+		for (p = 0; p < CPI_PARTS; p++)
+			fprintf(out, "cpi,%s,%d\n", cpiNames[p], m->cpiStack[p]);
+		for (s = 0; s < STAGES; s++)
+			for (c = 0; c < CAUSES; c++)
+				fprintf(out, "stall,%s.%s,%d\n", stages[s], causeNames[c],
+						m->stalls[s][c]);
+		for (op = 0; op < OPCODES; op++)
+			if (m->retiredOps[op] > 0)
+				fprintf(out, "opcode,%s,%lld\n", opcodeName(op),
+						(long long) m->retiredOps[op]);
+		for (s = 0; s < STAGES; s++)
+			fprintf(out, "usage,%s,%d\n", stages[s], usage[s]);
+		fclose(out);
+		return;
+	}
+
+	fprintf(out, "{\n  \"clocks\": %d,\n  \"retired\": %lld,\n", m->clocks,
+			(long long) m->retiredInstructions);
+	fprintf(out, "  \"cpiStack\": {");
+	for (p = 0; p < CPI_PARTS; p++)
+		fprintf(out, "%s \"%s\": %d", p ? "," : "", cpiNames[p],
+				m->cpiStack[p]);
+	fprintf(out, " },\n  \"stalls\": {");
+	for (s = 0; s < STAGES; s++) {
+		fprintf(out, "%s\n    \"%s\": {", s ? "," : "", stages[s]);
+		for (c = 0; c < CAUSES; c++)
+			fprintf(out, "%s \"%s\": %d", c ? "," : "", causeNames[c],
+					m->stalls[s][c]);
+		fprintf(out, " }");
+	}
+	fprintf(out, "\n  },\n  \"retiredByOpcode\": {");
+	separator = "";
+	for (op = 0; op < OPCODES; op++) {
+		if (m->retiredOps[op] == 0)
+			continue;
+		fprintf(out, "%s \"%s\": %lld", separator, opcodeName(op),
+				(long long) m->retiredOps[op]);
+		separator = ",";
+	}
+	fprintf(out, " },\n  \"usage\": {");
+	for (s = 0; s < STAGES; s++)
+		fprintf(out, "%s \"%s\": %d", s ? "," : "", stages[s], usage[s]);
+	fprintf(out, " }\n}\n");
+	fclose(out);
+}
+
+/*
+ * Superscalar mode: how busy each slot of each stage was, and why issue
+ * groups came out narrower than the machine.
+ */
+void printSlotUsage(machine *m) {
+	const char *stages[STAGES] = { "IF", "ID", "EX", "MEM", "WB" };
+	int s, n;
+
+	printf("\t~~~~~~~ Superscalar Slot Utilization (%d wide) ~~~~~~~\n",
+			m->issueWidth);
+	printf("\tslot  ");
+	for (n = 0; n < m->issueWidth; n++)
+		printf("%9d", n);
+	printf("\n");
+	for (s = 0; s < STAGES; s++) {
+		printf("\t%-4s  ", stages[s]);
+		for (n = 0; n < m->issueWidth; n++)
+			printf("%8.2f%%", 100.0 * m->slotUsage[s][n] / m->clocks);
+		printf("\n");
+	}
+	printf("\tRetired: %15lld instructions\n",
+			(long long) m->retiredInstructions);
+	printf("\tIPC: %19.3f\n", 1.0 * m->retiredInstructions / m->clocks);
+	printf("\tIssued per cycle: ");
+	for (n = 0; n <= m->issueWidth; n++)
+		printf(" %d: %d", n, m->issueCounts[n]);
+	printf("\n\tGroups split: %10d dependency %d memory port\n\n",
+			m->splitDependency, m->splitMemoryPort);
+}
+
+/*
+ * Out-of-order mode: throughput, how full the window ran and what held
+ * dispatch and commit back.
+ */
+void printOutOfOrder(machine *m) {
+	ooo_core *c = m->core;
+	int u;
+
+	printf("\t~~~~~~~ Out-of-Order Core (%d wide, ROB %d, stations",
+			m->issueWidth, c->config.robSize);
+	for (u = 0; u < UNIT_CLASSES; u++)
+		printf(" %s %d", unitNames[u], c->config.stations[u]);
+	printf(") ~~~~~~~\n");
+	printf("\tRetired: %15lld instructions\n",
+			(long long) m->retiredInstructions);
+	printf("\tIPC: %19.3f\n", 1.0 * m->retiredInstructions / m->clocks);
+	printf("\tROB occupancy: %9.2f average, %d max\n",
+			1.0 * c->occupancy / m->clocks, c->occupancyMax);
+	printf("\tDispatch stalls: %7d fetch empty, %d ROB full\n",
+			c->dispatchStalls[STALL_FETCH], c->dispatchStalls[STALL_ROB]);
+	printf("\tStations full: %9d %s", c->dispatchStalls[0], unitNames[0]);
+	for (u = 1; u < UNIT_CLASSES; u++)
+		printf(", %d %s", c->dispatchStalls[u], unitNames[u]);
+	printf("\n\tCommit stalls: %9d alu, %d mul, %d load, %d store,"
+			" %d empty ROB\n", c->commitStalls[WAIT_ALU],
+			c->commitStalls[WAIT_MUL], c->commitStalls[WAIT_LOAD],
+			c->commitStalls[WAIT_STORE], c->commitStalls[WAIT_EMPTY]);
+	printf("\tBranch flushes: %8d\n\n", c->flushes);
+}
+
+/*
+ * One line of the cache statistics table.
+ */
+void printCache(cache *c) {
+	int64_t accesses = c->reads + c->writes;
+	printf("\t%-5s %10lld %10lld %10lld %10lld %10lld %8.2f%%\n",
+			c->config.name, (long long) accesses, (long long) c->hits,
+			(long long) c->misses, (long long) c->evictions,
+			(long long) c->writebacks,
+			accesses ? 100.0 * c->hits / accesses : 0.0);
 }
 
 /*
  * Output the contents of our virtual machine's memory space.
- * Only addresses with contents other then NULL/0 will be shown.
+ * Only addresses with contents other then NULL/0 will be shown, and only
+ * pages that were ever written to are looked at.
  */
-void printMemory() {
+void printMemory(machine *m) {
 	printf("\n----------- Memory Contents ------------\n");
 	printf(" address\tvalueHex\tvalueDec\n");
 	printf("________________________________________\n");
-	int i;
-	for (i = 0; i < 512; i++) {
-		if (RAM[i] != 0x0)
-			printf(" 0x%04x->\t0x%08x\t%8d\n", i, RAM[i], RAM[i]);
+	uint32_t d, t, i;
+	for (d = 0; d < DIRECTORY_ENTRIES; d++) {
+		if (m->memory.pageDirectory[d] == NULL)
+			continue;
+		for (t = 0; t < TABLE_ENTRIES; t++) {
+			mem_page *page = m->memory.pageDirectory[d]->pages[t];
+			if (page == NULL)
+				continue;
+			uint32_t base = (d << TABLE_BITS | t) << PAGE_BITS;
+			for (i = 0; i < PAGE_WORDS; i++) {
+				if (page->words[i] != 0x0)
+					printf(" 0x%04x->\t0x%08x\t%8d\n", base + i,
+							page->words[i], page->words[i]);
+			}
+		}
 	}
 }
 
 /*
  * Final Output of Register labels and there contents
  */
-void printRegisters() {
+void printRegisters(machine *m) {
 	printf("\n----------- Register Contents ------------\n");
 	printf("index   name     valueHex          valueDec\n");
 	printf("___________________________________________\n");
-	printf(" 0	zero\t0x%08x%16d\n", regs[0], regs[0]);	//this is aligned
-	printf(" 1	$at	0x%08x%16d\n", regs[1], regs[1]);
-	printf(" 2	$v0	0x%08x%16d\n", regs[2], regs[2]);
-	printf(" 3	$v1	0x%08x%16d\n", regs[3], regs[3]);
-	printf(" 4	$a0	0x%08x%16d\n", regs[4], regs[4]);
-	printf(" 5	$a1	0x%08x%16d\n", regs[5], regs[5]);
-	printf(" 6	$a2	0x%08x%16d\n", regs[6], regs[6]);
-	printf(" 7	$a3	0x%08x%16d\n", regs[7], regs[7]);
-	printf(" 8	$t0	0x%08x%16d\n", regs[8], regs[8]);
-	printf(" 9	$t1	0x%08x%16d\n", regs[9], regs[9]);
-	printf(" 10	$t2	0x%08x%16d\n", regs[10], regs[10]);
-	printf(" 11	$t3	0x%08x%16d\n", regs[11], regs[11]);
-	printf(" 12	$t4	0x%08x%16d\n", regs[12], regs[12]);
-	printf(" 13	$t5	0x%08x%16d\n", regs[13], regs[13]);
-	printf(" 14	$t6	0x%08x%16d\n", regs[14], regs[14]);
-	printf(" 15	$t7	0x%08x%16d\n", regs[15], regs[15]);
-	printf(" 16	$s0	0x%08x%16d\n", regs[16], regs[16]);
-	printf(" 17	$s1	0x%08x%16d\n", regs[17], regs[17]);
-	printf(" 18	$s2	0x%08x%16d\n", regs[18], regs[18]);
-	printf(" 19	$s3	0x%08x%16d\n", regs[19], regs[19]);
-	printf(" 20	$s4	0x%08x%16d\n", regs[20], regs[20]);
-	printf(" 21	$s5	0x%08x%16d\n", regs[21], regs[21]);
-	printf(" 22	$s6	0x%08x%16d\n", regs[22], regs[22]);
-	printf(" 23	$s7	0x%08x%16d\n", regs[23], regs[23]);
-	printf(" 24	$t8	0x%08x%16d\n", regs[24], regs[24]);
-	printf(" 25	$t9	0x%08x%16d\n", regs[25], regs[25]);
-	printf(" 26	$k0	0x%08x%16d\n", regs[26], regs[26]);
-	printf(" 27	$k1	0x%08x%16d\n", regs[27], regs[27]);
-	printf(" 28	$gp	0x%08x%16d\n", regs[28], regs[28]);
-	printf(" 29	$sp	0x%08x%16d\n", regs[29], regs[29]);
-	printf(" 30   $s8/$fp\t0x%08x%16d\n", regs[30], regs[30]);//this is aligned
-	printf(" 31	$ra	0x%08x%16d\n", regs[31], regs[31]);
+	printf(" 0	zero\t0x%08x%16d\n", m->regs[0], m->regs[0]);	//this is aligned
+	printf(" 1	$at	0x%08x%16d\n", m->regs[1], m->regs[1]);
+	printf(" 2	$v0	0x%08x%16d\n", m->regs[2], m->regs[2]);
+	printf(" 3	$v1	0x%08x%16d\n", m->regs[3], m->regs[3]);
+	printf(" 4	$a0	0x%08x%16d\n", m->regs[4], m->regs[4]);
+	printf(" 5	$a1	0x%08x%16d\n", m->regs[5], m->regs[5]);
+	printf(" 6	$a2	0x%08x%16d\n", m->regs[6], m->regs[6]);
+	printf(" 7	$a3	0x%08x%16d\n", m->regs[7], m->regs[7]);
+	printf(" 8	$t0	0x%08x%16d\n", m->regs[8], m->regs[8]);
+	printf(" 9	$t1	0x%08x%16d\n", m->regs[9], m->regs[9]);
+	printf(" 10	$t2	0x%08x%16d\n", m->regs[10], m->regs[10]);
+	printf(" 11	$t3	0x%08x%16d\n", m->regs[11], m->regs[11]);
+	printf(" 12	$t4	0x%08x%16d\n", m->regs[12], m->regs[12]);
+	printf(" 13	$t5	0x%08x%16d\n", m->regs[13], m->regs[13]);
+	printf(" 14	$t6	0x%08x%16d\n", m->regs[14], m->regs[14]);
+	printf(" 15	$t7	0x%08x%16d\n", m->regs[15], m->regs[15]);
+	printf(" 16	$s0	0x%08x%16d\n", m->regs[16], m->regs[16]);
+	printf(" 17	$s1	0x%08x%16d\n", m->regs[17], m->regs[17]);
+	printf(" 18	$s2	0x%08x%16d\n", m->regs[18], m->regs[18]);
+	printf(" 19	$s3	0x%08x%16d\n", m->regs[19], m->regs[19]);
+	printf(" 20	$s4	0x%08x%16d\n", m->regs[20], m->regs[20]);
+	printf(" 21	$s5	0x%08x%16d\n", m->regs[21], m->regs[21]);
+	printf(" 22	$s6	0x%08x%16d\n", m->regs[22], m->regs[22]);
+	printf(" 23	$s7	0x%08x%16d\n", m->regs[23], m->regs[23]);
+	printf(" 24	$t8	0x%08x%16d\n", m->regs[24], m->regs[24]);
+	printf(" 25	$t9	0x%08x%16d\n", m->regs[25], m->regs[25]);
+	printf(" 26	$k0	0x%08x%16d\n", m->regs[26], m->regs[26]);
+	printf(" 27	$k1	0x%08x%16d\n", m->regs[27], m->regs[27]);
+	printf(" 28	$gp	0x%08x%16d\n", m->regs[28], m->regs[28]);
+	printf(" 29	$sp	0x%08x%16d\n", m->regs[29], m->regs[29]);
+	printf(" 30   $s8/$fp\t0x%08x%16d\n", m->regs[30], m->regs[30]);//this is aligned
+	printf(" 31	$ra	0x%08x%16d\n", m->regs[31], m->regs[31]);
 	printf("___________________________________________\n");
-	printf(" PC%8d\n", pc);
+	printf(" PC%8d\n", m->pc);
 }
 
 /**
@@ -0,0 +1,131 @@
+/*
+ * ram.h
+ *
+ *  Created on: Oct 18, 2026
+ *
+ *  The main RAM memory, aka 'data memory': a sparse 32-bit address space
+ *  of 32-bit words. Word addresses are split into a page directory index,
+ *  a page table index and the word within a 4 KiB page. Tables and pages
+ *  are only allocated the first time something is written to them; reading
+ *  untouched memory gives 0 without allocating, so a program only costs
+ *  what it actually uses.
+ *
+ *  The last page used is remembered, so consecutive accesses to the same
+ *  page (the common case in MEM) skip the table walk.
+ *
+ *  REFERENCES: see projmain.c header comment.
+ */
+
+#ifndef RAM_H_
+#define RAM_H_
+
+/******************************************************************************
+ * Constants/Definitions
+ */
+#define PAGE_BITS 10 //1024 words = 4 KiB per page
+#define PAGE_WORDS (1 << PAGE_BITS)
+#define TABLE_BITS 11
+#define TABLE_ENTRIES (1 << TABLE_BITS)
+#define DIRECTORY_BITS (32 - PAGE_BITS - TABLE_BITS)
+#define DIRECTORY_ENTRIES (1 << DIRECTORY_BITS)
+
+/******************************************************************************
+ * Global Vars and Structs
+ */
+typedef struct mem_page_tag {
+	int32_t words[PAGE_WORDS];
+} mem_page;
+
+typedef struct page_table_tag {
+	mem_page *pages[TABLE_ENTRIES];
+} page_table;
+
+//one address space; all zero is a valid, empty one
+typedef struct ram_tag {
+	page_table *pageDirectory[DIRECTORY_ENTRIES];
+	int32_t pagesAllocated;
+
+	//last page lookup cache, only valid while 'lastPage' is set
+	uint32_t lastPageNumber;
+	mem_page *lastPage;
+} ram;
+
+/******************************************************************************
+ * Function Prototypes
+ */
+mem_page* findPage(ram*, uint32_t, bool);
+int32_t memRead(ram*, uint32_t);
+void memWrite(ram*, uint32_t, int32_t);
+void freeMemory(ram*);
+
+/******************************************************************************
+ * Functions
+ */
+
+/**
+ * Walk the tables to the page holding word address 'addr'. When 'allocate'
+ * is false a missing page gives NULL, otherwise it is created zeroed.
+ */
+mem_page* findPage(ram *mem, uint32_t addr, bool allocate) {
+	uint32_t pageNumber = addr >> PAGE_BITS;
+	if (mem->lastPage != NULL && pageNumber == mem->lastPageNumber)
+		return mem->lastPage;
+
+	page_table **table = &mem->pageDirectory[pageNumber >> TABLE_BITS];
+	if (*table == NULL) {
+		if (!allocate)
+			return NULL;
+		if ((*table = calloc(1, sizeof(page_table))) == NULL)
+			goto outOfMemory;
+	}
+	mem_page **page = &(*table)->pages[pageNumber & (TABLE_ENTRIES - 1)];
+	if (*page == NULL) {
+		if (!allocate)
+			return NULL;
+		if ((*page = calloc(1, sizeof(mem_page))) == NULL)
+			goto outOfMemory;
+		mem->pagesAllocated++;
+	}
+	mem->lastPageNumber = pageNumber;
+	mem->lastPage = *page;
+	return mem->lastPage;
+
+	outOfMemory:
+	printf("\n>>>ERROR!\n******Out of host memory for address 0x%08x,"
+			"\n\tFrom: ram.h @ line %d\n", addr, __LINE__);
+	exit(1);
+}
+
+/**
+ * Load the word at word address 'addr'.
+ */
+int32_t memRead(ram *mem, uint32_t addr) {
+	mem_page *page = findPage(mem, addr, false);
+	return page == NULL ? 0 : page->words[addr & (PAGE_WORDS - 1)];
+}
+
+/**
+ * Store 'value' at word address 'addr'.
+ */
+void memWrite(ram *mem, uint32_t addr, int32_t value) {
+	findPage(mem, addr, true)->words[addr & (PAGE_WORDS - 1)] = value;
+}
+
+/**
+ * Give every page back, leaving an empty address space.
+ */
+void freeMemory(ram *mem) {
+	int d, t;
+	for (d = 0; d < DIRECTORY_ENTRIES; d++) {
+		if (mem->pageDirectory[d] == NULL)
+			continue;
+		for (t = 0; t < TABLE_ENTRIES; t++)
+			free(mem->pageDirectory[d]->pages[t]);
+		free(mem->pageDirectory[d]);
+		mem->pageDirectory[d] = NULL;
+	}
+	mem->pagesAllocated = 0;
+	mem->lastPage = NULL;
+}
+
+#endif /* RAM_H_ */
@@ -0,0 +1,325 @@
+/*
+ * snapshot.h
+ *
+ *  Created on: Oct 18, 2026
+ *
+ *  Checkpoint and restore of a whole simulation: the program, registers,
+ *  pc, every latch and stage counter, the statistics, the predictor tables,
+ *  the touched RAM pages and, when enabled, the cache tags and the
+ *  out-of-order window. A run can be stopped at any cycle, saved, and later
+ *  carried on from that cycle as many times as wanted, so a long warm up
+ *  only has to be simulated once.
+ *
+ *  The machine record is written as the host lays it out, so a snapshot is
+ *  only good for the build of the simulator that wrote it; the header
+ *  records the sizes that have to match and loading refuses anything else.
+ *
+ *  REFERENCES: see projmain.c header comment.
+ */
+
+#ifndef SNAPSHOT_H_
+#define SNAPSHOT_H_
+
+/******************************************************************************
+ * Constants/Definitions
+ */
+#define SNAP_MAGIC "MSNP" //first 4 bytes of every snapshot file
+#define SNAP_VERSION 2 //2: 64-bit cache tags
+#define SNAP_ALIGN(x) (((x) + 7) & ~(size_t) 7) //sections start 8 aligned
+
+/******************************************************************************
+ * Global Vars and Structs
+ */
+
+/*
+ * Snapshot file layout (host byte order, every section 8 byte aligned):
+ *   snap_header
+ *   machine record: the machine struct without the page directory of its
+ *                   RAM, which is rebuilt from the pages below
+ *   text section:   textCount machine code words, as in an object file
+ *   pages:          pageCount snap_page, only the pages ever written
+ *   caches:         with the caches on, for each of l1i, l1d and l2 its
+ *                   lines, then its PLRU trees
+ *   core:           coreBytes of the out-of-order core block, if any
+ */
+typedef struct snap_header_tag {
+	char magic[4];
+	uint16_t version;
+	uint16_t headerSize; //bytes, so newer headers can grow
+	uint32_t machineSize; //sizeof(machine) of the build that wrote it
+	uint32_t textCount;
+	int32_t haltIndex;
+	int32_t entry;
+	uint32_t pageCount;
+	uint32_t coreBytes; //0 for the in-order pipelines
+	int32_t predictor; //index in predictors[], -1 for none
+} snap_header;
+
+typedef struct snap_page_tag {
+	uint32_t pageNumber;
+	int32_t words[PAGE_WORDS];
+} snap_page;
+
+/******************************************************************************
+ * Function Prototypes
+ */
+void saveSnapshot(machine*, char*);
+void loadSnapshot(program*, machine*, char*);
+bool isSnapshotFile(char*);
+cache* snapshotCache(machine*, int);
+void writeSection(FILE*, const void*, size_t);
+const uint8_t* readSection(const uint8_t**, const uint8_t*, size_t, char*);
+
+/******************************************************************************
+ * Functions
+ */
+
+/**
+ * The cache of 'level', in the order the snapshot stores them.
+ */
+cache* snapshotCache(machine *m, int level) {
+	cache *levels[CACHE_LEVELS] = { &m->l1i, &m->l1d, &m->l2 };
+	return levels[level];
+}
+
+/**
+ * Write 'bytes' from 'data', padded up to the next section boundary.
+ */
+void writeSection(FILE *fptr, const void *data, size_t bytes) {
+	static const uint8_t padding[8] = { 0 };
+	if (fwrite(data, 1, bytes, fptr) != bytes
+			|| fwrite(padding, 1, SNAP_ALIGN(bytes) - bytes, fptr)
+					!= SNAP_ALIGN(bytes) - bytes) {
+		printf("\n>>>ERROR!\n******Could not write the snapshot,"
+				"\n\tFrom: snapshot.h @ line %d\n", __LINE__);
+		exit(1);
+	}
+}
+
+/**
+ * Step 'cursor' over the next section of 'bytes', making sure the file
+ * really holds it. Returns where the section starts.
+ */
+const uint8_t* readSection(const uint8_t **cursor, const uint8_t *end,
+		size_t bytes, char *snapFile) {
+	const uint8_t *section = *cursor;
+	if ((size_t) (end - section) < SNAP_ALIGN(bytes)) {
+		printf("\n>>>ERROR!\n******Truncated snapshot file: * %s *"
+				"\n\tFrom: snapshot.h @ line %d\n", snapFile, __LINE__);
+		exit(1);
+	}
+	*cursor += SNAP_ALIGN(bytes);
+	return section;
+}
+
+/**
+ * Write the whole state of 'm' to 'snapFile', so that loadSnapshot() can
+ * carry the run on from the current cycle.
+ */
+void saveSnapshot(machine *m, char *snapFile) {
+	const size_t before = offsetof(machine, memory);
+	const size_t after = before + sizeof(ram);
+	const program *prog = m->prog;
+	snap_header header = { SNAP_MAGIC, SNAP_VERSION, sizeof(snap_header),
+			sizeof(machine), prog->count, prog->haltIndex, prog->entry };
+	snap_page page;
+	uint32_t *text;
+	int32_t i;
+	int level, d, t;
+
+	FILE *fptr = fopen(snapFile, "wb");
+	if (fptr == NULL) {
+		printf("Snapshot file '%s' could not be created.", snapFile);
+		exit(1);
+	}
+
+	for (d = 0; d < DIRECTORY_ENTRIES; d++)
+		for (t = 0; m->memory.pageDirectory[d] != NULL && t < TABLE_ENTRIES;
+				t++)
+			if (m->memory.pageDirectory[d]->pages[t] != NULL)
+				header.pageCount++;
+	if (m->core != NULL)
+		header.coreBytes = coreSize(&m->core->config);
+	header.predictor = m->branchPredictor == NULL ?
+			-1 : m->branchPredictor - predictors;
+	writeSection(fptr, &header, sizeof(header));
+
+	//the page directory is all pointers, leave it out
+	fwrite(m, 1, before, fptr);
+	writeSection(fptr, (uint8_t*) m + after, sizeof(machine) - after);
+
+	if ((text = malloc(prog->count * sizeof(uint32_t) + 1)) == NULL) {
+		printf("\n>>>ERROR!\n******Out of host memory for the text section,"
+				"\n\tFrom: snapshot.h @ line %d\n", __LINE__);
+		exit(1);
+	}
+	for (i = 0; i < prog->count; i++)
+		text[i] = encodeInstruction(&prog->instructions[i]);
+	writeSection(fptr, text, prog->count * sizeof(uint32_t));
+	free(text);
+
+	for (d = 0; d < DIRECTORY_ENTRIES; d++) {
+		for (t = 0; m->memory.pageDirectory[d] != NULL && t < TABLE_ENTRIES;
+				t++) {
+			mem_page *p = m->memory.pageDirectory[d]->pages[t];
+			if (p == NULL)
+				continue;
+			page.pageNumber = (uint32_t) d << TABLE_BITS | t;
+			memcpy(page.words, p->words, sizeof(page.words));
+			writeSection(fptr, &page, sizeof(page));
+		}
+	}
+
+	for (level = 0; m->cachesEnabled && level < CACHE_LEVELS; level++) {
+		cache *c = snapshotCache(m, level);
+		writeSection(fptr, c->lines,
+				c->sets * c->config.assoc * sizeof(cache_line));
+		writeSection(fptr, c->plruBits, c->sets * sizeof(uint64_t));
+	}
+	if (m->core != NULL)
+		writeSection(fptr, m->core, header.coreBytes);
+
+	if (fclose(fptr) != 0) {
+		printf("\n>>>ERROR!\n******Could not write the snapshot: * %s *"
+				"\n\tFrom: snapshot.h @ line %d\n", snapFile, __LINE__);
+		exit(1);
+	}
+}
+
+/**
+ * Does 'snapFile' start like a snapshot?
+ */
+bool isSnapshotFile(char *snapFile) {
+	char magic[4];
+	bool isSnap = false;
+
+	FILE *fptr = fopen(snapFile, "rb");
+	if (fptr == NULL)
+		return false;
+	if (fread(magic, 1, 4, fptr) == 4 && memcmp(magic, SNAP_MAGIC, 4) == 0)
+		isSnap = true;
+	fclose(fptr);
+	return isSnap;
+}
+
+/**
+ * Map a snapshot written by saveSnapshot() and rebuild both the program it
+ * was running into 'prog' and the machine into 'm', which must not be in
+ * use. Every pointer in the machine record is stale, so each is set again
+ * here: the program, the predictor, RAM, the caches and the core.
+ */
+void loadSnapshot(program *prog, machine *m, char *snapFile) {
+	const size_t before = offsetof(machine, memory);
+	const size_t after = before + sizeof(ram);
+	const uint8_t *section;
+	struct stat st;
+	uint32_t i;
+	int level;
+
+	int fd = open(snapFile, O_RDONLY);
+	if (fd < 0 || fstat(fd, &st) < 0) {
+		printf("Snapshot file '%s' could not be opened.", snapFile);
+		exit(1);
+	}
+	if ((size_t) st.st_size < sizeof(snap_header)) {
+		printf("\n>>>ERROR!\n******Truncated snapshot file: * %s *"
+				"\n\tFrom: snapshot.h @ line %d\n", snapFile, __LINE__);
+		exit(1);
+	}
+	uint8_t *base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (base == MAP_FAILED) {
+		printf("Snapshot file '%s' could not be mapped.", snapFile);
+		exit(1);
+	}
+	close(fd);
+
+	const snap_header *header = (const snap_header*) base;
+	const uint8_t *cursor = base, *end = base + st.st_size;
+	if (memcmp(header->magic, SNAP_MAGIC, 4) != 0
+			|| header->version != SNAP_VERSION
+			|| header->headerSize < sizeof(snap_header)
+			|| header->machineSize != sizeof(machine)
+			|| header->textCount > INT32_MAX / sizeof(instr)
+			|| header->predictor >= (int32_t) (sizeof(predictors)
+					/ sizeof(predictor)) - 1
+			|| (header->coreBytes > 0 && header->coreBytes < sizeof(ooo_core))) {
+		printf("\n>>>ERROR!\n******Invalid snapshot file, or one written by"
+				" another build: * %s *\n\tFrom: snapshot.h @ line %d\n",
+				snapFile, __LINE__);
+		exit(1);
+	}
+	readSection(&cursor, end, header->headerSize, snapFile);
+
+	//the machine record, with an empty address space where RAM goes
+	section = readSection(&cursor, end, before + sizeof(machine) - after,
+			snapFile);
+	memset(m, 0, sizeof(machine));
+	memcpy(m, section, before);
+	memcpy((uint8_t*) m + after, section + before, sizeof(machine) - after);
+	m->prog = prog;
+	m->branchPredictor = header->predictor < 0 ?
+			NULL : &predictors[header->predictor];
+	m->core = NULL;
+#ifdef TRACE
+	m->trace = NULL;
+#endif
+#ifdef DEBUGGER
+	m->debug = NULL;
+#endif
+
+	const uint32_t *text = (const uint32_t*) readSection(&cursor, end,
+			header->textCount * sizeof(uint32_t), snapFile);
+	reserveInstructions(prog, header->textCount);
+	for (i = 0; i < header->textCount; i++)
+		prog->instructions[i] = decodeInstruction(text[i]);
+	prog->count = header->textCount;
+	prog->haltIndex = header->haltIndex;
+	prog->entry = header->entry;
+
+	for (i = 0; i < header->pageCount; i++) {
+		const snap_page *page = (const snap_page*) readSection(&cursor, end,
+				sizeof(snap_page), snapFile);
+		mem_page *p = findPage(&m->memory, page->pageNumber << PAGE_BITS,
+				true);
+		memcpy(p->words, page->words, sizeof(p->words));
+	}
+
+	//rebuild each level from its saved geometry, then put the tags back
+	for (level = 0; m->cachesEnabled && level < CACHE_LEVELS; level++) {
+		cache *c = snapshotCache(m, level);
+		cache saved = *c;
+		saved.config.name = defaultCacheConfig[level].name;
+		initCache(c, &saved.config, level < CACHE_LEVELS - 1 ? &m->l2 : NULL);
+		saved.lines = c->lines;
+		saved.plruBits = c->plruBits;
+		saved.next = c->next;
+		*c = saved;
+		section = readSection(&cursor, end,
+				c->sets * c->config.assoc * sizeof(cache_line), snapFile);
+		memcpy(c->lines, section, c->sets * c->config.assoc
+				* sizeof(cache_line));
+		section = readSection(&cursor, end, c->sets * sizeof(uint64_t),
+				snapFile);
+		memcpy(c->plruBits, section, c->sets * sizeof(uint64_t));
+	}
+
+	if (header->coreBytes > 0) {
+		section = readSection(&cursor, end, header->coreBytes, snapFile);
+		if ((m->core = malloc(header->coreBytes)) == NULL) {
+			printf("\n>>>ERROR!\n******Out of host memory for the out-of-order"
+					" core,\n\tFrom: snapshot.h @ line %d\n", __LINE__);
+			exit(1);
+		}
+		memcpy(m->core, section, header->coreBytes);
+		if (coreSize(&m->core->config) != header->coreBytes) {
+			printf("\n>>>ERROR!\n******Invalid snapshot file: * %s *"
+					"\n\tFrom: snapshot.h @ line %d\n", snapFile, __LINE__);
+			exit(1);
+		}
+		placeCoreArrays(m->core);
+	}
+
+	munmap(base, st.st_size);
+}
+
+#endif /* SNAPSHOT_H_ */
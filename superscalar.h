@@ -0,0 +1,512 @@
+/*
+ * superscalar.h
+ *
+ *  Created on: Oct 18, 2026
+ *
+ *  In-order superscalar mode: the same five stages as pipeline.h, but each
+ *  stage holds an issue group of up to 'issueWidth' (1, 2 or 4)
+ *  instructions that move on together. IF fetches up to a group's worth of
+ *  instructions per cycle into a fetch buffer; ID issues from its front, in
+ *  program order, as many as the pairing rules allow:
+ *    - no instruction may read or write a register written by an earlier
+ *      one of the same group (there is no forwarding inside a group)
+ *    - only one load or store per group, as there is a single memory port
+ *    - a branch, jump or the halt is the last instruction of its group
+ *  and only once no older group still owes a source register (with -d,
+ *  results waiting in EX_MEM/MEM_WB are forwarded, except a load's).
+ *
+ *  EX takes as long as the slowest instruction of the group, MEM as long
+ *  as the group's load or store, or a single cycle without one. Branches
+ *  stop fetching until EX resolves them, or with a predictor are resolved
+ *  at issue like in the scalar pipeline, squashing the wrong path.
+ *
+ *  The clock ticks every cycle; per slot utilization shows how much of
+ *  the width a program keeps busy.
+ *
+ *  REFERENCES: see projmain.c header comment.
+ */
+
+#ifndef SUPERSCALAR_H_
+#define SUPERSCALAR_H_
+
+#include "pipeline.h"
+
+/******************************************************************************
+ * Global Vars and Structs
+ */
+
+/******************************************************************************
+ * Function Prototypes
+ */
+void runSuperscalar(machine*);
+void groupIF(machine*);
+void groupID(machine*);
+void groupEX(machine*);
+void groupMEM(machine*);
+void groupWB(machine*);
+int groupCpiPart(machine*);
+bool readsRegister(instr*, int8_t);
+bool pairsWithGroup(issue_group*, instr*);
+bool sourcesReady(machine*, instr*);
+bool pendingWrite(issue_group*, int8_t, bool);
+int32_t groupOperand(machine*, int8_t);
+void executeSlot(machine*, issue_group*, int);
+void checkRunOff(machine*, int32_t, instr*);
+
+/******************************************************************************
+ * Functions
+ */
+
+/**
+ * Clock the superscalar pipeline until the halt has been written back,
+ * or the clock reaches 'stopClock'.
+ * Like runPipeline(), the stages go in reverse so each one sees what its
+ * successor left behind in the same cycle.
+ */
+void runSuperscalar(machine *m) {
+	while (!m->allWorkCompleted && !clockStopped(m)) {
+		m->cpiStack[groupCpiPart(m)]++;
+		groupWB(m);groupMEM(m);groupEX(m);groupID(m);groupIF(m);
+		m->clocks++;
+	}
+}
+
+/**
+ * Fetch up to 'issueWidth' instructions into the fetch buffer, stopping
+ * after a branch, jump or the halt. Taking a branch ends the block too, so a
+ * block is always sequential.
+ */
+void groupIF(machine *m) {
+	int32_t pc = m->pc;
+	int n, fetched = 0;
+
+	if (m->squashFetch) { //the wrong path fetch of this cycle is thrown away
+		m->squashFetch = false;
+		m->squashedFetches++;
+		m->fetchLatency = 0;
+		m->fetchCycles = 0;
+		return;
+	}
+	if (m->haltFetched)
+		return;
+	if (m->branchPredictor != NULL && (pc < 0 || pc >= m->prog->count)) {
+		//only a guess leads here; wait for the branch to redirect fetch,
+		//checkRunOff() catches a program that really runs off its end
+		countStall(m, STAGE_IF, CAUSE_BRANCH, 1);
+		return;
+	}
+	if (m->branchWaiting
+			|| m->fetchCount > 2 * MAX_ISSUE_WIDTH - m->issueWidth) {
+		countStall(m, STAGE_IF, m->branchWaiting ? CAUSE_BRANCH : CAUSE_FULL,
+				1);
+		return;
+	}
+
+	//the block is ready once its slowest instruction is
+	if (m->fetchLatency == 0) {
+		for (n = 0; n < m->issueWidth && pc >= 0 && pc < m->prog->count;
+				n++) {
+			int32_t latency = instrAccessTime(m, pc);
+			if (latency > m->fetchLatency)
+				m->fetchLatency = latency;
+			if (isControl(&m->prog->instructions[pc])
+					|| isHalt(&m->prog->instructions[pc]))
+				break;
+			pc++;
+		}
+		pc = m->pc;
+	}
+	if (m->fetchCycles < m->fetchLatency - 1) { //instruction cache miss
+		countStall(m, STAGE_IF, CAUSE_FETCH, 1);
+		m->fetchCycles++;
+		m->usageIF++;
+		m->slotUsage[STAGE_IF][0]++;
+		return;
+	}
+	m->fetchLatency = 0;
+	m->fetchCycles = 0;
+
+	while (fetched < m->issueWidth) {
+		if (m->branchPredictor != NULL && (pc < 0 || pc >= m->prog->count))
+			break; //the rest of the guess, next cycle
+		if (pc < 0 || pc >= m->prog->count) {
+			printf("\n>>>ERROR!\n******Fetched beyond program boundaries,"
+					" pc: * %d * and instructions: * %d *\n\tFrom: superscalar.h"
+					" @ line %d\n", pc, m->prog->count, __LINE__);
+			exit(1);
+		}
+		DEBUG_FETCH(m, pc);
+		latch *slot = &m->fetchBuffer[m->fetchCount++];
+		slot->inst = m->prog->instructions[pc];
+		slot->pc = pc;
+		if (m->branchPredictor != NULL)
+			pc = predictNextPc(m->branchPredictor, &m->bp, pc, &slot->inst);
+		else
+			pc++;
+		slot->predictedPc = pc;
+		m->slotUsage[STAGE_IF][fetched++]++;
+
+		if (isHalt(&slot->inst)) {
+			m->haltFetched = true;
+			pc = slot->pc; //like the scalar pipeline, stay on the halt
+			break;
+		}
+		if (isControl(&slot->inst)) {
+			if (m->branchPredictor == NULL)
+				m->branchWaiting = true; //until EX knows where to go
+			break;
+		}
+	}
+	m->pc = pc;
+	m->usageIF++;
+}
+
+/**
+ * Issue as much of the front of the fetch buffer as the pairing rules and
+ * the older groups' results allow into one group for EX.
+ */
+void groupID(machine *m) {
+	issue_group *group = &m->issued;
+	int n;
+
+	if (group->count > 0) { //EX has not taken the last group yet
+		m->issueCounts[0]++;
+		if (m->fetchCount > 0)
+			countStall(m, STAGE_ID, CAUSE_FULL, 1);
+		return;
+	}
+	while (group->count < m->issueWidth && group->count < m->fetchCount) {
+		latch *slot = &m->fetchBuffer[group->count];
+		if (!pairsWithGroup(group, &slot->inst)) {
+			if (isMemoryAccess(&slot->inst))
+				m->splitMemoryPort++;
+			else
+				m->splitDependency++;
+			break;
+		}
+		if (!sourcesReady(m, &slot->inst))
+			break;
+
+		n = group->count++;
+		group->inst[n] = slot->inst;
+		group->pc[n] = slot->pc;
+		group->cycles = 0;
+		group->latency = 0;
+		m->slotUsage[STAGE_ID][n]++;
+
+		if (isControl(&slot->inst)) {
+			if (m->branchPredictor != NULL) { //resolve it right here
+				instr *inst = &slot->inst;
+				int32_t nextPc = controlTarget(inst, slot->pc,
+						groupOperand(m, inst->rs), groupOperand(m, inst->rt));
+				if (nextPc >= m->prog->count || nextPc < 0) {
+					printf("\n>>>ERROR!\n******Branched beyond program"
+							" boundaries, pc: * %d * and instructions: * %d *"
+							"\n\tFrom: superscalar.h @ line %d\n", nextPc,
+							m->prog->count, __LINE__);
+					exit(1);
+				}
+				if (resolvePrediction(m->branchPredictor, &m->bp, slot->pc,
+						inst, slot->predictedPc, nextPc)) {
+					m->fetchCount = group->count; //drop the wrong path
+					m->haltFetched = false;
+					m->pc = nextPc;
+					m->squashFetch = true;
+				}
+			}
+			break;
+		}
+		if (isHalt(&slot->inst))
+			break;
+	}
+
+	m->issueCounts[group->count]++;
+	if (group->count == 0) {
+		if (m->fetchCount > 0) //the oldest waits for an operand
+			countStall(m, STAGE_ID, CAUSE_HAZARD, 1);
+		return;
+	}
+	m->usageID++;
+	m->fetchCount -= group->count;
+	memmove(m->fetchBuffer, m->fetchBuffer + group->count,
+			m->fetchCount * sizeof(latch));
+}
+
+/**
+ * Run the group for its slowest instruction's latency, then compute every
+ * result and address at once and hand the group to MEM.
+ */
+void groupEX(machine *m) {
+	issue_group *group = &m->issued;
+	int n;
+
+	if (group->count == 0)
+		return;
+	if (group->latency == 0) {
+		group->latency = 1;
+		for (n = 0; n < group->count; n++)
+			if (!passesThroughEX(m, &group->inst[n])
+					&& exLatency(&group->inst[n]) > group->latency)
+				group->latency = exLatency(&group->inst[n]);
+	}
+	if (group->cycles < group->latency) {
+		group->cycles++;
+		m->usageEX++;
+		for (n = 0; n < group->count; n++)
+			m->slotUsage[STAGE_EX][n]++;
+	}
+	if (group->cycles < group->latency || m->executed.count > 0) {
+		countStall(m, STAGE_EX, group->cycles < group->latency ?
+				CAUSE_EXECUTE : CAUSE_FULL, 1);
+		return;
+	}
+
+	for (n = 0; n < group->count; n++)
+		executeSlot(m, group, n);
+	m->executed = *group;
+	m->executed.cycles = 0;
+	m->executed.latency = 0;
+	group->count = 0;
+}
+
+/**
+ * Hold the group for its load or store, which happens as it leaves.
+ */
+void groupMEM(machine *m) {
+	issue_group *group = &m->executed;
+	int n, access = -1;
+
+	if (group->count == 0)
+		return;
+	for (n = 0; n < group->count; n++)
+		if (isMemoryAccess(&group->inst[n]))
+			access = n;
+	if (group->latency == 0)
+		group->latency = access < 0 ? 1 :
+				dataAccessTime(m, group->addr[access],
+						opTable[group->inst[access].op].kind == DOES_STORE);
+	if (group->cycles < group->latency) {
+		group->cycles++;
+		m->usageMEM++;
+		for (n = 0; n < group->count; n++)
+			m->slotUsage[STAGE_MEM][n]++;
+	}
+	if (group->cycles < group->latency || m->accessed.count > 0) {
+		countStall(m, STAGE_MEM, group->cycles < group->latency ?
+				CAUSE_MEMORY : CAUSE_FULL, 1);
+		return;
+	}
+
+	if (access >= 0) {
+		instr *inst = &group->inst[access];
+		uint32_t addr = group->addr[access];
+		if (opTable[inst->op].kind == DOES_LOAD) {
+			group->data[access] = loadValue(inst, memRead(&m->memory, addr));
+			DEBUG_ACCESS(m, group->pc[access], addr, false);
+		} else {
+			int32_t word = opTable[inst->op].size < 4 ?
+					memRead(&m->memory, addr) : 0;
+			memWrite(&m->memory, addr,
+					storeValue(inst, word, group->data[access]));
+			if (writesRegister(inst))
+				group->data[access] = 1; //sc succeeded
+			DEBUG_ACCESS(m, group->pc[access], addr, true);
+		}
+	}
+	m->accessed = *group;
+	group->count = 0;
+}
+
+/**
+ * Write every result of the group to the register file.
+ */
+void groupWB(machine *m) {
+	issue_group *group = &m->accessed;
+	int n;
+
+	if (group->count == 0)
+		return;
+	for (n = 0; n < group->count; n++) {
+		bool written = writesRegister(&group->inst[n]);
+		TRACE_RETIRE(m, group->pc[n], group->inst[n].op,
+				written ? group->inst[n].rd : 0, group->data[n],
+				group->addr[n]);
+		if (isHalt(&group->inst[n])) {
+			m->allWorkCompleted = true; //halt execution, end program
+			continue;
+		}
+		checkRunOff(m, group->pc[n], &group->inst[n]);
+		if (written)
+			m->regs[group->inst[n].rd] = group->data[n];
+		m->retiredOps[group->inst[n].op]++;
+		m->slotUsage[STAGE_WB][n]++;
+		m->retiredInstructions++;
+	}
+	m->usageWB++;
+	group->count = 0;
+}
+
+/**
+ * The part of the CPI stack the coming cycle goes to, from what the oldest
+ * group in flight is doing; see cpiPart().
+ */
+int groupCpiPart(machine *m) {
+	int n;
+
+	if (m->accessed.count > 0)
+		return CPI_BASE;
+	if (m->executed.count > 0) {
+		for (n = 0; n < m->executed.count; n++)
+			if (isMemoryAccess(&m->executed.inst[n]))
+				return CPI_MEMORY;
+		return CPI_DEPTH;
+	}
+	if (m->issued.count > 0)
+		return m->branchWaiting
+				&& isControl(&m->issued.inst[m->issued.count - 1]) ?
+				CPI_BRANCH : CPI_EXECUTE;
+	if (m->fetchCount > 0)
+		return sourcesReady(m, &m->fetchBuffer[0].inst) ?
+				CPI_DEPTH : CPI_HAZARD;
+	return CPI_FETCH;
+}
+
+/**
+ * Does this instruction read register 'reg'?
+ */
+bool readsRegister(instr *inst, int8_t reg) {
+	uint8_t roles = opTable[inst->op].roles;
+	if (reg == 0)
+		return false;
+	return ((roles & READS_RS) && inst->rs == reg)
+			|| ((roles & READS_RT) && inst->rt == reg);
+}
+
+/**
+ * The pairing rules: may 'inst' join the group being issued?
+ */
+bool pairsWithGroup(issue_group *group, instr *inst) {
+	int n;
+	for (n = 0; n < group->count; n++) {
+		instr *older = &group->inst[n];
+		if (isMemoryAccess(older) && isMemoryAccess(inst))
+			return false; //one memory port
+		if (writesRegister(older) && (readsRegister(inst, older->rd)
+				|| (writesRegister(inst) && inst->rd == older->rd)))
+			return false;
+	}
+	return true;
+}
+
+/**
+ * Are the registers 'inst' reads final, or at least forwardable, in every
+ * group issued before it?
+ */
+bool sourcesReady(machine *m, instr *inst) {
+	int8_t sources[2] = { inst->rs, inst->rt };
+	int i;
+	for (i = 0; i < 2; i++) {
+		if (!readsRegister(inst, sources[i]))
+			continue;
+		if (pendingWrite(&m->issued, sources[i], false)
+				|| pendingWrite(&m->executed, sources[i], m->forwarding)
+				|| (!m->forwarding
+						&& pendingWrite(&m->accessed, sources[i], false)))
+			return false;
+	}
+	return true;
+}
+
+/**
+ * Does an instruction of 'group' still have to write 'reg'? With
+ * 'computed', results the group already holds do not count, only loads.
+ */
+bool pendingWrite(issue_group *group, int8_t reg, bool computed) {
+	int n;
+	for (n = 0; n < group->count; n++)
+		if (writesRegister(&group->inst[n]) && group->inst[n].rd == reg
+				&& (!computed || resultFromMemory(&group->inst[n])))
+			return true;
+	return false;
+}
+
+/**
+ * The newest value of register 'reg': from the youngest group past EX that
+ * writes it, otherwise from the register file.
+ */
+int32_t groupOperand(machine *m, int8_t reg) {
+	issue_group *groups[] = { &m->executed, &m->accessed };
+	int g, n;
+	if (reg == 0)
+		return 0;
+	for (g = 0; g < 2; g++)
+		for (n = groups[g]->count - 1; n >= 0; n--)
+			if (writesRegister(&groups[g]->inst[n])
+					&& groups[g]->inst[n].rd == reg
+					&& (g == 1 || !resultFromMemory(&groups[g]->inst[n])))
+				return groups[g]->data[n];
+	return m->regs[reg];
+}
+
+/**
+ * The ALU work of slot 'n': results, load/store addresses, and the
+ * outcome of a branch left to EX.
+ */
+void executeSlot(machine *m, issue_group *group, int n) {
+	instr *inst = &group->inst[n];
+	int32_t rsVal, rtVal;
+
+	if (isHalt(inst))
+		return;
+	rsVal = groupOperand(m, inst->rs);
+	rtVal = groupOperand(m, inst->rt);
+	const op_info *info = &opTable[inst->op];
+	switch (info->kind) {
+	case DOES_ALU:
+		group->data[n] = info->execute(rsVal, rtVal, inst->i);
+		break;
+	case DOES_LOAD:
+	case DOES_STORE:
+		if (!isAligned(inst)) {
+			printf("\n>>>ERROR!\n******Memory Misaligned/Access,"
+					"\n\tFrom: superscalar.h @ line %d\n", __LINE__);
+			exit(1);
+		}
+		group->addr[n] = wordAddress(inst, rsVal);
+		group->data[n] = rtVal;
+		break;
+	case DOES_BRANCH:
+	case DOES_JUMP:
+		if (info->roles & WRITES_RD) //jal links the next pc
+			group->data[n] = group->pc[n] + 1;
+		if (m->branchPredictor != NULL)
+			break; //already resolved at issue
+		m->pc = controlTarget(inst, group->pc[n], rsVal, rtVal);
+		if (m->pc >= m->prog->count || m->pc < 0) {
+			printf("\n>>>ERROR!\n******Branched beyond program boundaries,"
+					" pc: * %d * and instructions: * %d *\n\tFrom:"
+					" superscalar.h @ line %d\n", m->pc,
+					m->prog->count, __LINE__);
+			exit(1);
+		}
+		m->branchWaiting = false;
+		break;
+	default: //a bubble does nothing
+		break;
+	}
+}
+
+/**
+ * Stop once the last instruction of the program retires without being the
+ * halt or a jump away: nothing follows it. With a predictor, fetch only
+ * waits at a pc past the end, since a guess can lead there too.
+ */
+void checkRunOff(machine *m, int32_t pc, instr *inst) {
+	if (pc == m->prog->count - 1 && !isControl(inst) && !isHalt(inst)) {
+		printf("\n>>>ERROR!\n******Ran past the end of the program, pc: * %d *"
+				"\n\tFrom: superscalar.h @ line %d\n", pc + 1, __LINE__);
+		exit(1);
+	}
+}
+
+#endif /* SUPERSCALAR_H_ */
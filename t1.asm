@@ -3,7 +3,7 @@
 #Brandon Chambers
 #Thomas Xu
 #
-#comments work on their own line, not extra blank lines or endofline comments
+#comments work on their own line or at the end of a line, blank lines are skipped
 addi $s0, $s0, 20
 addi $s1, $s1, 30
 add $t3, $s1, $s0
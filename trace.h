@@ -0,0 +1,287 @@
+/*
+ * trace.h
+ *
+ *  Created on: Oct 18, 2026
+ *
+ *  Binary execution trace of a timing run, for when printf is far too slow:
+ *  one record for every instruction that retires (pc, opcode, the register
+ *  it wrote and its value, the address of a load or store) and one for
+ *  every run of cycles an in-order pipeline stage stalled, with its cause
+ *  (see countStall() in pipeline.h). Records are fixed size and delta
+ *  encoded against the one before, and the stage functions only append
+ *  them to a ring buffer; a writer thread drains the ring to disk a chunk
+ *  at a time, in large sequential writes. tracedump.c reads the file back.
+ *
+ *  Tracing is compiled in with -DTRACE. Without it the hooks expand to
+ *  nothing and the machine does not even carry the tracer pointer.
+ *
+ *  REFERENCES: see projmain.c header comment.
+ */
+
+#ifndef TRACE_H_
+#define TRACE_H_
+
+/******************************************************************************
+ * Constants/Definitions
+ */
+#define TRACE_MAGIC "MTRC" //first 4 bytes of every trace file
+#define TRACE_VERSION 1
+#define TRACE_CHUNK 4096 //records handed to the writer at a time, 64 KiB
+#define TRACE_RING (16 * TRACE_CHUNK)
+
+//record kinds
+#define RECORD_RETIRE 0
+#define RECORD_STALL 1
+#define RECORD_SYNC 2 //the pc of the next retire is too far for a delta
+
+/******************************************************************************
+ * Global Vars and Structs
+ */
+
+/*
+ * Trace file layout (host byte order): a trace_header, then records until
+ * the end of the file. Each record's clock is the one before's plus
+ * 'clockDelta', starting from 0; the pc of a retire is the pc of the last
+ * retire (or sync) plus 'pcDelta', starting from 0.
+ */
+typedef struct trace_header_tag {
+	char magic[4];
+	uint16_t version;
+	uint16_t headerSize; //bytes, so newer headers can grow
+	uint32_t recordSize;
+} trace_header;
+
+typedef struct trace_record_tag {
+	uint8_t kind;
+	uint8_t op; //retire: opcode; stall: the stage
+	uint8_t reg; //retire: register written, 0 for none; stall: its CAUSE_
+	int8_t pcDelta; //retire only
+	int32_t clockDelta; //stall: to the first cycle of the stall
+	//retire: value written, loaded or stored; stall: cycles; sync: the pc
+	int32_t value;
+	uint32_t addr; //retire: word address of a load or store
+} trace_record;
+
+#ifdef TRACE
+typedef struct tracer_tag {
+	trace_record *ring;
+	uint64_t tail; //records appended, only the simulator moves it
+	uint64_t published; //records the writer may take
+	uint64_t written; //records on disk
+	bool closing;
+	int fd;
+	pthread_t writer;
+	pthread_mutex_t lock;
+	pthread_cond_t ready; //the writer waits here for chunks
+	pthread_cond_t drained; //the simulator waits here for room
+
+	//the base of the next delta
+	int32_t lastClock;
+	int32_t lastPc;
+	//each stage's stall run, not yet appended while it may grow
+	trace_record stall[STAGES];
+	int32_t stallStart[STAGES];
+} tracer;
+
+//hooks for the stage functions, nothing unless compiled with -DTRACE
+#define TRACE_RETIRE(m, pc, op, reg, value, addr) do { \
+	if ((m)->trace != NULL) \
+		traceRetire((m)->trace, (m)->clocks, pc, op, reg, value, addr); \
+} while (0)
+#define TRACE_STALL(m, clock, stage, reason, cycles) do { \
+	if ((m)->trace != NULL) \
+		traceStall((m)->trace, clock, stage, reason, cycles); \
+} while (0)
+#else
+#define TRACE_RETIRE(m, pc, op, reg, value, addr)
+#define TRACE_STALL(m, clock, stage, reason, cycles)
+#endif
+
+/******************************************************************************
+ * Function Prototypes
+ */
+#ifdef TRACE
+tracer* openTrace(const char*);
+void closeTrace(tracer*);
+void traceRetire(tracer*, int32_t, int32_t, int, int, int32_t, uint32_t);
+void traceStall(tracer*, int32_t, int, int, int32_t);
+void appendRecord(tracer*, trace_record*);
+void endStall(tracer*, int);
+void publishRecords(tracer*);
+void* runTraceWriter(void*);
+
+/******************************************************************************
+ * Functions
+ */
+
+/**
+ * Create 'traceFile' and start the thread that writes it.
+ */
+tracer* openTrace(const char *traceFile) {
+	trace_header header = { TRACE_MAGIC, TRACE_VERSION, sizeof(trace_header),
+			sizeof(trace_record) };
+	tracer *t = calloc(1, sizeof(tracer));
+
+	if (t == NULL || (t->ring = malloc(TRACE_RING * sizeof(trace_record)))
+			== NULL) {
+		printf("\n>>>ERROR!\n******Out of host memory for the trace buffer,"
+				"\n\tFrom: trace.h @ line %d\n", __LINE__);
+		exit(1);
+	}
+	t->fd = open(traceFile, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (t->fd < 0 || write(t->fd, &header, sizeof(header))
+			!= sizeof(header)) {
+		printf("Trace file '%s' could not be created.", traceFile);
+		exit(1);
+	}
+	pthread_mutex_init(&t->lock, NULL);
+	pthread_cond_init(&t->ready, NULL);
+	pthread_cond_init(&t->drained, NULL);
+	pthread_create(&t->writer, NULL, runTraceWriter, t);
+	return t;
+}
+
+/**
+ * Append the stalls still open, wait for the writer to put everything on
+ * disk, and free the tracer.
+ */
+void closeTrace(tracer *t) {
+	int stage;
+	for (stage = 0; stage < STAGES; stage++)
+		endStall(t, stage);
+
+	pthread_mutex_lock(&t->lock);
+	t->published = t->tail;
+	t->closing = true;
+	pthread_cond_signal(&t->ready);
+	pthread_mutex_unlock(&t->lock);
+	pthread_join(t->writer, NULL);
+
+	close(t->fd);
+	pthread_mutex_destroy(&t->lock);
+	pthread_cond_destroy(&t->ready);
+	pthread_cond_destroy(&t->drained);
+	free(t->ring);
+	free(t);
+}
+
+/**
+ * Record that the instruction at 'pc' retired at 'clock', writing 'value'
+ * to register 'reg' (0 for none); 'addr' is the word a load or store used.
+ */
+void traceRetire(tracer *t, int32_t clock, int32_t pc, int op, int reg,
+		int32_t value, uint32_t addr) {
+	trace_record r = { RECORD_RETIRE, op, reg, 0, clock - t->lastClock, value,
+			addr };
+
+	if (pc - t->lastPc < INT8_MIN || pc - t->lastPc > INT8_MAX) {
+		trace_record sync = { RECORD_SYNC, 0, 0, 0, r.clockDelta, pc, 0 };
+		appendRecord(t, &sync);
+		r.clockDelta = 0;
+	} else {
+		r.pcDelta = pc - t->lastPc;
+	}
+	t->lastClock = clock;
+	t->lastPc = pc;
+	appendRecord(t, &r);
+}
+
+/**
+ * Record that 'stage' stalled for 'reason' over the 'cycles' cycles from
+ * 'clock' on. Back to back stalls of a stage for the same reason become
+ * a single record, appended once something else happens to the stage.
+ */
+void traceStall(tracer *t, int32_t clock, int stage, int reason,
+		int32_t cycles) {
+	trace_record *run = &t->stall[stage];
+	if (run->value > 0 && run->reg == reason
+			&& t->stallStart[stage] + run->value == clock) {
+		run->value += cycles;
+		return;
+	}
+	endStall(t, stage);
+	run->kind = RECORD_STALL;
+	run->op = stage;
+	run->reg = reason;
+	run->value = cycles;
+	t->stallStart[stage] = clock;
+}
+
+/**
+ * Append the open stall run of 'stage', if there is one.
+ */
+void endStall(tracer *t, int stage) {
+	trace_record *run = &t->stall[stage];
+	if (run->value == 0)
+		return;
+	//runs end out of order, so the delta may well be negative
+	run->clockDelta = t->stallStart[stage] - t->lastClock;
+	t->lastClock = t->stallStart[stage];
+	appendRecord(t, run);
+	run->value = 0;
+}
+
+/**
+ * Put 'r' in the ring, handing the writer a chunk each time one fills.
+ */
+void appendRecord(tracer *t, trace_record *r) {
+	t->ring[t->tail & (TRACE_RING - 1)] = *r;
+	if ((++t->tail & (TRACE_CHUNK - 1)) == 0)
+		publishRecords(t);
+}
+
+/**
+ * Let the writer have everything appended so far, and wait while the ring
+ * has no room left for another chunk.
+ */
+void publishRecords(tracer *t) {
+	pthread_mutex_lock(&t->lock);
+	t->published = t->tail;
+	pthread_cond_signal(&t->ready);
+	while (t->tail - t->written > TRACE_RING - TRACE_CHUNK)
+		pthread_cond_wait(&t->drained, &t->lock);
+	pthread_mutex_unlock(&t->lock);
+}
+
+/**
+ * The writer thread: copy published records from the ring to the file
+ * until the tracer closes.
+ */
+void* runTraceWriter(void *arg) {
+	tracer *t = arg;
+	uint64_t start, end;
+
+	pthread_mutex_lock(&t->lock);
+	for (;;) {
+		while (t->published == t->written && !t->closing)
+			pthread_cond_wait(&t->ready, &t->lock);
+		if (t->published == t->written)
+			break; //closing, and all written
+		start = t->written;
+		end = t->published;
+		pthread_mutex_unlock(&t->lock);
+
+		while (start < end) { //at most two pieces, around the end of the ring
+			uint64_t slot = start & (TRACE_RING - 1);
+			uint64_t count = end - start;
+			if (count > TRACE_RING - slot)
+				count = TRACE_RING - slot;
+			size_t bytes = count * sizeof(trace_record);
+			if (write(t->fd, &t->ring[slot], bytes) != (ssize_t) bytes) {
+				printf("\n>>>ERROR!\n******Could not write the trace,"
+						"\n\tFrom: trace.h @ line %d\n", __LINE__);
+				exit(1);
+			}
+			start += count;
+		}
+
+		pthread_mutex_lock(&t->lock);
+		t->written = end;
+		pthread_cond_signal(&t->drained);
+	}
+	pthread_mutex_unlock(&t->lock);
+	return NULL;
+}
+#endif /* TRACE */
+
+#endif /* TRACE_H_ */
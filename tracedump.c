@@ -0,0 +1,148 @@
+/*
+ * tracedump.c
+ *
+ *  Created on: Oct 18, 2026
+ *
+ *  Reader for the trace files a simulator built with -DTRACE writes with
+ *  -T (see trace.h): prints every record with its clock and pc decoded, or
+ *  with -s only the totals, instructions by opcode and stall cycles by
+ *  stage and reason.
+ *
+ *  REFERENCES: see projmain.c header comment.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <pthread.h>
+
+#include "pipeline.h" //for the opcodes, and trace.h
+
+/******************************************************************************
+ * Global Vars and Structs
+ */
+const char *stageNames[STAGES] = { "IF", "ID", "EX", "MEM", "WB" };
+
+/******************************************************************************
+ * Function Prototypes
+ */
+void printRecord(int32_t, int32_t, const trace_record*);
+void printSummary(int64_t*, int64_t[][CAUSES], int32_t);
+
+/******************************************************************************
+ * Run from command line like so:
+ *
+ * > gcc tracedump.c -o tracedump
+ * > tracedump [-s] trace.bin
+ */
+int main(int argc, char *argv[]) {
+	bool summary = argc == 3 && strcmp(argv[1], "-s") == 0;
+	int64_t retired[OPCODES] = { 0 };
+	int64_t stalls[STAGES][CAUSES] = { { 0 } };
+	int32_t clock = 0, pc = 0, lastClock = 0;
+	struct stat st;
+
+	if (argc != 2 && !summary) {
+		printf("usage: %s [-s] trace.bin\n", argv[0]);
+		return 1;
+	}
+	char *traceFile = argv[argc - 1];
+	int fd = open(traceFile, O_RDONLY);
+	if (fd < 0 || fstat(fd, &st) < 0) {
+		printf("Trace file '%s' could not be opened.\n", traceFile);
+		return 1;
+	}
+	uint8_t *base = st.st_size == 0 ? NULL :
+			mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	trace_header *header = (trace_header*) base;
+	if (base == MAP_FAILED || (size_t) st.st_size < sizeof(trace_header)
+			|| memcmp(header->magic, TRACE_MAGIC, 4) != 0
+			|| header->version != TRACE_VERSION
+			|| header->headerSize > st.st_size
+			|| header->recordSize != sizeof(trace_record)) {
+		printf("\n>>>ERROR!\n******Invalid trace file: * %s *"
+				"\n\tFrom: tracedump.c @ line %d\n", traceFile, __LINE__);
+		return 1;
+	}
+
+	const trace_record *r = (const trace_record*) (base + header->headerSize);
+	const trace_record *end = r
+			+ (st.st_size - header->headerSize) / sizeof(trace_record);
+	for (; r < end; r++) {
+		clock += r->clockDelta;
+		if (r->kind == RECORD_SYNC) {
+			pc = r->value;
+			continue;
+		}
+		if (r->kind == RECORD_RETIRE) {
+			pc += r->pcDelta;
+			if (r->op < OPCODES)
+				retired[r->op]++;
+			if (clock > lastClock)
+				lastClock = clock;
+		} else if (r->op < STAGES && r->reg < CAUSES) {
+			stalls[r->op][r->reg] += r->value;
+		}
+		if (!summary)
+			printRecord(clock, pc, r);
+	}
+	if (summary)
+		printSummary(retired, stalls, lastClock);
+
+	munmap(base, st.st_size);
+	return 0;
+}
+
+/**
+ * One line per record: the clock, then what retired or stalled.
+ */
+void printRecord(int32_t clock, int32_t pc, const trace_record *r) {
+	if (r->kind == RECORD_STALL) {
+		printf("%10d  stall  %-3s %-7s %d cycles\n", clock,
+				r->op < STAGES ? stageNames[r->op] : "?",
+				r->reg < CAUSES ? causeNames[r->reg] : "?",
+				r->value);
+		return;
+	}
+	printf("%10d  %6d  %-6s", clock, pc,
+			opcodeName(r->op));
+	if (r->op == LW)
+		printf("  $%d = mem[0x%08x] = %d", r->reg, r->addr, r->value);
+	else if (r->op == SW)
+		printf("  mem[0x%08x] = %d", r->addr, r->value);
+	else if (r->reg != 0)
+		printf("  $%d = %d", r->reg, r->value);
+	printf("\n");
+}
+
+/**
+ * The totals of a whole trace.
+ */
+void printSummary(int64_t *retired, int64_t stalls[][CAUSES],
+		int32_t lastClock) {
+	int64_t total = 0;
+	int op, stage, reason;
+
+	for (op = 0; op < OPCODES; op++)
+		total += retired[op];
+	printf("Retired: %lld instructions, the last at clock %d\n",
+			(long long) total, lastClock);
+	for (op = 0; op < OPCODES; op++)
+		if (retired[op] > 0)
+			printf("  %-8s %12lld\n", opcodeName(op), (long long) retired[op]);
+	printf("Stall cycles:\n");
+	for (stage = 0; stage < STAGES; stage++)
+		for (reason = 0; reason < CAUSES; reason++)
+			if (stalls[stage][reason] > 0)
+				printf("  %-3s %-8s %12lld\n", stageNames[stage],
+						causeNames[reason],
+						(long long) stalls[stage][reason]);
+}